@@ -2,6 +2,14 @@
 #include "ActionsController.h"
 
 #include "Game.h"
+#include "Profiler.h"
+
+
+namespace
+{
+  const std::string TracePath = "Data/Profile/trace.json";
+
+} // anonym NS
 
 
 ActionsController::ActionsController(Game& i_game)
@@ -46,6 +54,29 @@ void ActionsController::createActions()
       }),
     Dx::ActionType::OnPress);
 
+  set(
+    Dx::KeyboardKey::R,
+    Dx::Action([&]() {
+      d_game.setOceanMeshType(d_game.getOceanMeshType() == OceanMeshType::Clipmap ?
+        OceanMeshType::Roam : OceanMeshType::Clipmap);
+      }),
+    Dx::ActionType::OnPress);
+
+  set(
+    Dx::KeyboardKey::P,
+    Dx::Action([&]() {
+      auto& profiler = Profiler::get();
+      profiler.setEnabled(!profiler.isEnabled());
+      }),
+    Dx::ActionType::OnPress);
+
+  set(
+    Dx::KeyboardKey::T,
+    Dx::Action([&]() {
+      Profiler::get().writeChromeTrace(TracePath);
+      }),
+    Dx::ActionType::OnPress);
+
   set(
     Dx::KeyboardKey::Escape,
     Dx::Action([&]() {
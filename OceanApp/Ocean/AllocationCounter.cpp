@@ -0,0 +1,127 @@
+#include "stdafx.h"
+#include "AllocationCounter.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+
+#ifdef OCEAN_COUNT_ALLOCATIONS
+
+// Replaces the global allocation functions for the whole executable. The nothrow and the
+// array forms fall back to these ones, so they are counted too
+
+namespace
+{
+  thread_local std::uint64_t t_allocationsCount = 0;
+
+  void* allocate(const std::size_t i_size)
+  {
+    ++t_allocationsCount;
+    if (void* ptr = std::malloc(i_size ? i_size : 1))
+      return ptr;
+    throw std::bad_alloc();
+  }
+
+  void* allocateAligned(const std::size_t i_size, const std::align_val_t i_alignment)
+  {
+    ++t_allocationsCount;
+    const auto alignment = (std::size_t)i_alignment;
+#ifdef _MSC_VER
+    void* ptr = _aligned_malloc(i_size ? i_size : 1, alignment);
+#else
+    // The size has to be a multiple of the alignment
+    void* ptr = std::aligned_alloc(alignment, std::max<std::size_t>((i_size + alignment - 1) / alignment, 1) * alignment);
+#endif
+    if (ptr)
+      return ptr;
+    throw std::bad_alloc();
+  }
+
+  void freeAligned(void* i_ptr)
+  {
+#ifdef _MSC_VER
+    _aligned_free(i_ptr);
+#else
+    std::free(i_ptr);
+#endif
+  }
+
+} // anonym NS
+
+
+std::uint64_t getThreadAllocationsCount()
+{
+  return t_allocationsCount;
+}
+
+
+void* operator new(const std::size_t i_size)
+{
+  return allocate(i_size);
+}
+
+void* operator new[](const std::size_t i_size)
+{
+  return allocate(i_size);
+}
+
+void* operator new(const std::size_t i_size, const std::align_val_t i_alignment)
+{
+  return allocateAligned(i_size, i_alignment);
+}
+
+void* operator new[](const std::size_t i_size, const std::align_val_t i_alignment)
+{
+  return allocateAligned(i_size, i_alignment);
+}
+
+
+void operator delete(void* i_ptr) noexcept
+{
+  std::free(i_ptr);
+}
+
+void operator delete[](void* i_ptr) noexcept
+{
+  std::free(i_ptr);
+}
+
+void operator delete(void* i_ptr, std::size_t) noexcept
+{
+  std::free(i_ptr);
+}
+
+void operator delete[](void* i_ptr, std::size_t) noexcept
+{
+  std::free(i_ptr);
+}
+
+void operator delete(void* i_ptr, const std::align_val_t) noexcept
+{
+  freeAligned(i_ptr);
+}
+
+void operator delete[](void* i_ptr, const std::align_val_t) noexcept
+{
+  freeAligned(i_ptr);
+}
+
+void operator delete(void* i_ptr, std::size_t, const std::align_val_t) noexcept
+{
+  freeAligned(i_ptr);
+}
+
+void operator delete[](void* i_ptr, std::size_t, const std::align_val_t) noexcept
+{
+  freeAligned(i_ptr);
+}
+
+#else
+
+std::uint64_t getThreadAllocationsCount()
+{
+  return 0;
+}
+
+#endif
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstdint>
+
+
+// Heap allocations made through the global operator new by the calling thread so far.
+// Taken before and after a per-frame path, it shows whether the path allocates.
+// Counting replaces the global allocation functions, so it's only compiled in the builds
+// defining OCEAN_COUNT_ALLOCATIONS: OceanBench and the debug builds of the game. It's 0 otherwise
+std::uint64_t getThreadAllocationsCount();
@@ -0,0 +1,62 @@
+#include "stdafx.h"
+#include "AssetStreamer.h"
+
+
+AssetStreamer::AssetStreamer()
+  : d_start(std::chrono::steady_clock::now())
+{
+}
+
+
+int AssetStreamer::getPendingCount() const
+{
+  return d_pendingCount;
+}
+
+int AssetStreamer::getTimingsCount() const
+{
+  std::lock_guard lock(d_mutex);
+  return (int)d_timings.size();
+}
+
+std::vector<AssetStreamer::Timing> AssetStreamer::getTimings() const
+{
+  std::lock_guard lock(d_mutex);
+  return d_timings;
+}
+
+std::vector<AssetStreamer::Timing> AssetStreamer::getSlowestTimings(const int i_count) const
+{
+  auto timings = getTimings();
+  std::stable_sort(timings.begin(), timings.end(), [](const Timing& i_left, const Timing& i_right) {
+    return i_left.durationMs > i_right.durationMs;
+    });
+
+  if ((int)timings.size() > i_count)
+    timings.resize(i_count);
+  return timings;
+}
+
+double AssetStreamer::getTotalMs() const
+{
+  std::lock_guard lock(d_mutex);
+
+  double totalMs = 0;
+  for (const auto& timing : d_timings)
+    totalMs = std::max(totalMs, timing.startMs + timing.durationMs);
+  return totalMs;
+}
+
+
+double AssetStreamer::getElapsedMs() const
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - d_start).count();
+}
+
+void AssetStreamer::addTiming(std::string i_name, const double i_startMs, const bool i_async)
+{
+  const double durationMs = getElapsedMs() - i_startMs;
+
+  std::lock_guard lock(d_mutex);
+  d_timings.push_back({ std::move(i_name), i_startMs, durationMs, i_async });
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "Profiler.h"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+// Loads assets off the main thread, every request is handed back as a future. Loading time
+// of each asset is recorded, together with the steps the caller still does synchronously,
+// to see where the startup time goes
+class AssetStreamer
+{
+public:
+  struct Timing
+  {
+    std::string name;
+    // From the streamer's creation
+    double startMs = 0;
+    double durationMs = 0;
+    bool async = false;
+  };
+
+  AssetStreamer();
+
+  // i_load runs on a thread of its own. It must not touch the render device: the result is
+  // to be uploaded by the main thread once the future is ready
+  template <typename T>
+  std::shared_future<T> request(std::string i_name, std::function<T()> i_load);
+
+  // Runs i_func right away, on the calling thread
+  template <typename F>
+  auto measure(const std::string& i_name, F&& i_func);
+
+  int getPendingCount() const;
+  int getTimingsCount() const;
+  std::vector<Timing> getTimings() const;
+  // Sorted by duration, the slowest first
+  std::vector<Timing> getSlowestTimings(int i_count) const;
+  // Until the end of the last finished step
+  double getTotalMs() const;
+
+private:
+  std::chrono::steady_clock::time_point d_start;
+  std::atomic<int> d_pendingCount = 0;
+
+  mutable std::mutex d_mutex;
+  std::vector<Timing> d_timings;
+
+  double getElapsedMs() const;
+  void addTiming(std::string i_name, double i_startMs, bool i_async);
+};
+
+
+template <typename T>
+std::shared_future<T> AssetStreamer::request(std::string i_name, std::function<T()> i_load)
+{
+  ++d_pendingCount;
+  return std::async(std::launch::async, [this, name = std::move(i_name), load = std::move(i_load)]() {
+    // No longer pending even if the load throws, the exception is handed over by the future
+    struct PendingGuard
+    {
+      std::atomic<int>& pendingCount;
+      ~PendingGuard() { --pendingCount; }
+    } pendingGuard{ d_pendingCount };
+
+    const double startMs = getElapsedMs();
+    PROFILE_SCOPE(name);
+    T result = load();
+    addTiming(name, startMs, true);
+    return result;
+    }).share();
+}
+
+template <typename F>
+auto AssetStreamer::measure(const std::string& i_name, F&& i_func)
+{
+  const double startMs = getElapsedMs();
+  PROFILE_SCOPE(i_name);
+  if constexpr (std::is_void_v<decltype(i_func())>)
+  {
+    i_func();
+    addTiming(i_name, startMs, false);
+  }
+  else
+  {
+    auto result = i_func();
+    addTiming(i_name, startMs, false);
+    return result;
+  }
+}
@@ -0,0 +1,63 @@
+#include "stdafx.h"
+#include "BoundingBox.h"
+
+#include <LaggyDx/IShape3d.h>
+
+
+Sdk::Vector3F BoundingBox::getCenter() const
+{
+  return { (min.x + max.x) / 2, (min.y + max.y) / 2, (min.z + max.z) / 2 };
+}
+
+Sdk::Vector3F BoundingBox::getExtents() const
+{
+  return { (max.x - min.x) / 2, (max.y - min.y) / 2, (max.z - min.z) / 2 };
+}
+
+
+void BoundingBox::expand(const Sdk::Vector3F& i_point)
+{
+  min = { std::min(min.x, i_point.x), std::min(min.y, i_point.y), std::min(min.z, i_point.z) };
+  max = { std::max(max.x, i_point.x), std::max(max.y, i_point.y), std::max(max.z, i_point.z) };
+}
+
+void BoundingBox::expand(const BoundingBox& i_box)
+{
+  expand(i_box.min);
+  expand(i_box.max);
+}
+
+BoundingBox BoundingBox::getInflated(const Sdk::Vector3F& i_margins) const
+{
+  return { min - i_margins, max + i_margins };
+}
+
+
+BoundingBox getShapeBounds(const Dx::IShape3d& i_shape)
+{
+  const auto& verts = i_shape.getVerts();
+  if (verts.empty())
+    return {};
+
+  BoundingBox bounds{ verts.front().position, verts.front().position };
+  for (const auto& vertex : verts)
+    bounds.expand(vertex.position);
+  return bounds;
+}
+
+BoundingBox transformBounds(const BoundingBox& i_local,
+  const Sdk::Vector3F& i_position, const Sdk::Vector3F& i_rotation, const Sdk::Vector3F& i_scale)
+{
+  const Sdk::Vector3F min = { i_local.min.x * i_scale.x, i_local.min.y * i_scale.y, i_local.min.z * i_scale.z };
+  const Sdk::Vector3F max = { i_local.max.x * i_scale.x, i_local.max.y * i_scale.y, i_local.max.z * i_scale.z };
+  BoundingBox scaled{ min, min };
+  scaled.expand(max);
+
+  if (i_rotation.x == 0 && i_rotation.y == 0 && i_rotation.z == 0)
+    return { scaled.min + i_position, scaled.max + i_position };
+
+  // The rotation is about the object's origin, so the sphere is centered there
+  const float radius = scaled.getCenter().length() + scaled.getExtents().length();
+  const Sdk::Vector3F margins = { radius, radius, radius };
+  return { i_position - margins, i_position + margins };
+}
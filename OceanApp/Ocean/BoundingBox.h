@@ -0,0 +1,28 @@
+#pragma once
+
+#include <LaggyDx/LaggyDxFwd.h>
+
+#include <LaggySdk/Vector.h>
+
+
+struct BoundingBox
+{
+  Sdk::Vector3F min;
+  Sdk::Vector3F max;
+
+  Sdk::Vector3F getCenter() const;
+  Sdk::Vector3F getExtents() const;
+
+  void expand(const Sdk::Vector3F& i_point);
+  void expand(const BoundingBox& i_box);
+  // Same box grown by the margins on both sides
+  BoundingBox getInflated(const Sdk::Vector3F& i_margins) const;
+};
+
+
+// Bounds of the shape's vertices in its local space
+BoundingBox getShapeBounds(const Dx::IShape3d& i_shape);
+// World bounds of an object with the given local bounds. Rotated objects get the box of
+// the bounding sphere, which fits any rotation order
+BoundingBox transformBounds(const BoundingBox& i_local,
+  const Sdk::Vector3F& i_position, const Sdk::Vector3F& i_rotation, const Sdk::Vector3F& i_scale);
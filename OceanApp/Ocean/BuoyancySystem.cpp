@@ -0,0 +1,241 @@
+#include "stdafx.h"
+#include "BuoyancySystem.h"
+
+#include "FftOcean.h"
+#include "GerstnerWaves.h"
+
+#include <chrono>
+
+
+namespace
+{
+  constexpr float Gravity = 9.8f;
+  constexpr float WaterDensity = 1025;
+
+  // Fraction of the velocity lost per second when fully submerged
+  constexpr float LinearDrag = 2.0f;
+  constexpr float AngularDrag = 2.0f;
+
+  // Don't try to catch up after long hitches, drop the time instead
+  constexpr int MaxStepsPerUpdate = 8;
+
+
+  // Roll, then pitch, then yaw, the same as the objects' rotation
+  struct Rotation
+  {
+    float sinPitch, cosPitch;
+    float sinYaw, cosYaw;
+    float sinRoll, cosRoll;
+
+    Rotation(const float i_pitch, const float i_yaw, const float i_roll)
+      : sinPitch(std::sin(i_pitch)), cosPitch(std::cos(i_pitch))
+      , sinYaw(std::sin(i_yaw)), cosYaw(std::cos(i_yaw))
+      , sinRoll(std::sin(i_roll)), cosRoll(std::cos(i_roll))
+    {
+    }
+
+    void apply(float& io_x, float& io_y, float& io_z) const
+    {
+      const float x = io_x * cosRoll - io_y * sinRoll;
+      const float y1 = io_x * sinRoll + io_y * cosRoll;
+
+      const float y = y1 * cosPitch - io_z * sinPitch;
+      const float z = y1 * sinPitch + io_z * cosPitch;
+
+      io_x = x * cosYaw + z * sinYaw;
+      io_y = y;
+      io_z = -x * sinYaw + z * cosYaw;
+    }
+  };
+
+} // anonym NS
+
+
+int BuoyancySystem::addBody(const float i_mass, const float i_volume, const Sdk::Vector3F& i_position,
+  const std::vector<Sdk::Vector3F>& i_samples, const float i_sampleRadius)
+{
+  CONTRACT_EXPECT(i_mass > 0);
+  CONTRACT_EXPECT(i_volume > 0);
+  CONTRACT_EXPECT(!i_samples.empty());
+  CONTRACT_EXPECT(i_sampleRadius > 0);
+
+  // Inertia of the samples as point masses, plus the samples' own size
+  float inertia = 0;
+  for (const auto& sample : i_samples)
+    inertia += sample.x * sample.x + sample.y * sample.y + sample.z * sample.z + i_sampleRadius * i_sampleRadius;
+  inertia *= i_mass / i_samples.size();
+
+  d_positionX.push_back(i_position.x);
+  d_positionY.push_back(i_position.y);
+  d_positionZ.push_back(i_position.z);
+  d_velocityX.push_back(0);
+  d_velocityY.push_back(0);
+  d_velocityZ.push_back(0);
+  d_pitch.push_back(0);
+  d_yaw.push_back(0);
+  d_roll.push_back(0);
+  d_pitchSpeed.push_back(0);
+  d_rollSpeed.push_back(0);
+  d_invMass.push_back(1 / i_mass);
+  d_invInertia.push_back(1 / inertia);
+
+  d_samplesBegin.push_back((int)d_localX.size());
+  for (const auto& sample : i_samples)
+  {
+    d_localX.push_back(sample.x);
+    d_localY.push_back(sample.y);
+    d_localZ.push_back(sample.z);
+    d_sampleVolume.push_back(i_volume / i_samples.size());
+    d_sampleRadius.push_back(i_sampleRadius);
+  }
+  d_samplesEnd.push_back((int)d_localX.size());
+
+  const int samplesCount = (int)d_localX.size();
+  for (auto* scratch : { &d_worldX, &d_worldY, &d_worldZ, &d_waterX, &d_waterY, &d_waterZ,
+    &d_normalX, &d_normalY, &d_normalZ })
+  {
+    scratch->resize(samplesCount);
+  }
+
+  return (int)d_positionX.size() - 1;
+}
+
+
+int BuoyancySystem::getBodiesCount() const
+{
+  return (int)d_positionX.size();
+}
+
+Sdk::Vector3F BuoyancySystem::getPosition(const int i_body) const
+{
+  return { d_positionX.at(i_body), d_positionY.at(i_body), d_positionZ.at(i_body) };
+}
+
+Sdk::Vector3F BuoyancySystem::getRotation(const int i_body) const
+{
+  return { d_pitch.at(i_body), d_yaw.at(i_body), d_roll.at(i_body) };
+}
+
+
+int BuoyancySystem::getLastStepsCount() const
+{
+  return d_lastStepsCount;
+}
+
+double BuoyancySystem::getLastStepMs() const
+{
+  return d_lastStepMs;
+}
+
+
+void BuoyancySystem::update(const GerstnerWaves& i_waves)
+{
+  // The waves are stepped along with the bodies, so a copy is needed
+  auto waves = i_waves;
+
+  runSteps(i_waves.getGlobalTime(), [&](const double i_time) {
+    waves.setGlobalTime(i_time);
+
+    // The height of the displaced surface over the undisplaced point. The horizontal displacement
+    // is ignored, that is good enough for the steepness the waves have
+    const int samplesCount = (int)d_localX.size();
+    waves.evaluate(samplesCount, d_worldX.data(), d_worldZ.data(),
+      d_waterX.data(), d_waterY.data(), d_waterZ.data(), d_normalX.data(), d_normalY.data(), d_normalZ.data());
+    });
+}
+
+void BuoyancySystem::update(const FftOcean& i_ocean, const double i_time)
+{
+  runSteps(i_time, [&](double) {
+    // Horizontal displacement is ignored the same way as for the waves
+    for (int sample = 0; sample < (int)d_localX.size(); ++sample)
+      d_waterY[sample] = i_ocean.getHeight(d_worldX[sample], d_worldZ[sample]);
+    });
+}
+
+
+void BuoyancySystem::runSteps(const double i_targetTime, const std::function<void(double)>& i_sampleWater)
+{
+  if (d_time < 0)
+    d_time = i_targetTime;
+  else if (i_targetTime - d_time > MaxStepsPerUpdate * FixedDt)
+    d_time = i_targetTime - MaxStepsPerUpdate * FixedDt;
+
+  const auto start = std::chrono::steady_clock::now();
+  d_lastStepsCount = 0;
+  while (d_time + FixedDt <= i_targetTime)
+  {
+    d_time += FixedDt;
+    step(d_time, i_sampleWater);
+    ++d_lastStepsCount;
+  }
+  const auto end = std::chrono::steady_clock::now();
+
+  if (d_lastStepsCount > 0)
+    d_lastStepMs = std::chrono::duration<double, std::milli>(end - start).count() / d_lastStepsCount;
+}
+
+
+void BuoyancySystem::step(const double i_time, const std::function<void(double)>& i_sampleWater)
+{
+  const float dt = (float)FixedDt;
+  const int bodiesCount = getBodiesCount();
+
+  for (int body = 0; body < bodiesCount; ++body)
+  {
+    const Rotation rotation(d_pitch[body], d_yaw[body], d_roll[body]);
+    for (int sample = d_samplesBegin[body]; sample < d_samplesEnd[body]; ++sample)
+    {
+      float x = d_localX[sample];
+      float y = d_localY[sample];
+      float z = d_localZ[sample];
+      rotation.apply(x, y, z);
+
+      d_worldX[sample] = d_positionX[body] + x;
+      d_worldY[sample] = d_positionY[body] + y;
+      d_worldZ[sample] = d_positionZ[body] + z;
+    }
+  }
+
+  i_sampleWater(i_time);
+
+  for (int body = 0; body < bodiesCount; ++body)
+  {
+    float force = 0;
+    float pitchTorque = 0;
+    float rollTorque = 0;
+    float submerged = 0;
+
+    for (int sample = d_samplesBegin[body]; sample < d_samplesEnd[body]; ++sample)
+    {
+      const float radius = d_sampleRadius[sample];
+      const float depth = d_waterY[sample] - (d_worldY[sample] - radius);
+      const float fraction = std::clamp(depth / (2 * radius), 0.0f, 1.0f);
+
+      const float sampleForce = WaterDensity * Gravity * d_sampleVolume[sample] * fraction;
+      force += sampleForce;
+      pitchTorque -= (d_worldZ[sample] - d_positionZ[body]) * sampleForce;
+      rollTorque += (d_worldX[sample] - d_positionX[body]) * sampleForce;
+      submerged += fraction;
+    }
+    submerged /= d_samplesEnd[body] - d_samplesBegin[body];
+
+    d_velocityY[body] += (force * d_invMass[body] - Gravity) * dt;
+    d_pitchSpeed[body] += pitchTorque * d_invInertia[body] * dt;
+    d_rollSpeed[body] += rollTorque * d_invInertia[body] * dt;
+
+    const float linearDamping = std::max(0.0f, 1 - LinearDrag * submerged * dt);
+    const float angularDamping = std::max(0.0f, 1 - AngularDrag * submerged * dt);
+    d_velocityX[body] *= linearDamping;
+    d_velocityY[body] *= linearDamping;
+    d_velocityZ[body] *= linearDamping;
+    d_pitchSpeed[body] *= angularDamping;
+    d_rollSpeed[body] *= angularDamping;
+
+    d_positionX[body] += d_velocityX[body] * dt;
+    d_positionY[body] += d_velocityY[body] * dt;
+    d_positionZ[body] += d_velocityZ[body] * dt;
+    d_pitch[body] += d_pitchSpeed[body] * dt;
+    d_roll[body] += d_rollSpeed[body] * dt;
+  }
+}
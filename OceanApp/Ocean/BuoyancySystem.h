@@ -0,0 +1,68 @@
+#pragma once
+
+#include <LaggySdk/Vector.h>
+
+#include <functional>
+#include <vector>
+
+
+class FftOcean;
+class GerstnerWaves;
+
+
+// Floating rigid bodies. Every body is a set of spherical hull samples, each one pushed up by
+// the water it displaces. Bodies and samples are stored as structures of arrays and the water
+// is sampled for all of them in one batch, so thousands of bodies can be stepped at once.
+// Steps are fixed and follow the waves' time, so the result doesn't depend on the frame rate
+class BuoyancySystem
+{
+public:
+  static constexpr double FixedDt = 1.0 / 60.0;
+
+  // i_samples are in the body's local space, their total volume is i_volume.
+  // Returns the body index
+  int addBody(float i_mass, float i_volume, const Sdk::Vector3F& i_position,
+    const std::vector<Sdk::Vector3F>& i_samples, float i_sampleRadius);
+
+  int getBodiesCount() const;
+  Sdk::Vector3F getPosition(int i_body) const;
+  // Pitch, yaw and roll, the same as in IObject3::setRotation
+  Sdk::Vector3F getRotation(int i_body) const;
+
+  // Runs all the fixed steps up to the waves' current time
+  void update(const GerstnerWaves& i_waves);
+  // The same on the FFT ocean as it is at i_time: it can't be stepped along with the bodies,
+  // so all the steps of an update float on the same surface
+  void update(const FftOcean& i_ocean, double i_time);
+
+  int getLastStepsCount() const;
+  // Average time of a single step during the last update
+  double getLastStepMs() const;
+
+private:
+  // Bodies
+  std::vector<float> d_positionX, d_positionY, d_positionZ;
+  std::vector<float> d_velocityX, d_velocityY, d_velocityZ;
+  std::vector<float> d_pitch, d_yaw, d_roll;
+  std::vector<float> d_pitchSpeed, d_rollSpeed;
+  std::vector<float> d_invMass, d_invInertia;
+  std::vector<int> d_samplesBegin, d_samplesEnd;
+
+  // Samples
+  std::vector<float> d_localX, d_localY, d_localZ;
+  std::vector<float> d_sampleVolume;
+  std::vector<float> d_sampleRadius;
+
+  // Per step scratch, one value per sample
+  std::vector<float> d_worldX, d_worldY, d_worldZ;
+  std::vector<float> d_waterX, d_waterY, d_waterZ;
+  std::vector<float> d_normalX, d_normalY, d_normalZ;
+
+  double d_time = -1;
+  int d_lastStepsCount = 0;
+  double d_lastStepMs = 0;
+
+  // i_sampleWater fills d_waterY for d_worldX and d_worldZ at the given time
+  void runSteps(double i_targetTime, const std::function<void(double)>& i_sampleWater);
+  void step(double i_time, const std::function<void(double)>& i_sampleWater);
+};
@@ -0,0 +1,159 @@
+#include "stdafx.h"
+#include "CompactVertices.h"
+
+#include <LaggyDx/IShape3d.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+
+namespace
+{
+  constexpr float QuantizedMax = 65535.0f;
+
+  // Texture coordinates further than this from the fitted ones, a texel of a 4K texture,
+  // and heights further than this from the flat grid's, in meters, don't fit
+  constexpr float MaxUvError = 1.0f / 4096;
+  constexpr float MaxHeightError = 0.001f;
+
+  float getScale(const float i_min, const float i_max)
+  {
+    return i_max > i_min ? (i_max - i_min) / QuantizedMax : 0.0f;
+  }
+
+  std::uint16_t quantize(const float i_value, const float i_origin, const float i_scale)
+  {
+    if (i_scale == 0)
+      return 0;
+    return (std::uint16_t)std::clamp(std::round((i_value - i_origin) / i_scale), 0.0f, QuantizedMax);
+  }
+
+  // Fits u = offset + x * scale along one axis, from the extreme vertices. Returns false
+  // if any vertex is off the fit
+  bool fitUv(const std::vector<Dx::VertexPosNormText>& i_verts, const bool i_v, float& o_offset, float& o_scale)
+  {
+    const auto getPosition = [&](const Dx::VertexPosNormText& i_vertex) {
+      return i_v ? i_vertex.position.z : i_vertex.position.x;
+    };
+    const auto getUv = [&](const Dx::VertexPosNormText& i_vertex) {
+      return i_v ? i_vertex.texture.y : i_vertex.texture.x;
+    };
+
+    const auto [first, last] = std::minmax_element(i_verts.begin(), i_verts.end(),
+      [&](const auto& i_left, const auto& i_right) { return getPosition(i_left) < getPosition(i_right); });
+
+    const float extent = getPosition(*last) - getPosition(*first);
+    o_scale = extent > 0 ? (getUv(*last) - getUv(*first)) / extent : 0.0f;
+    o_offset = getUv(*first) - getPosition(*first) * o_scale;
+
+    return std::all_of(i_verts.begin(), i_verts.end(), [&](const auto& i_vertex) {
+      return std::abs(o_offset + getPosition(i_vertex) * o_scale - getUv(i_vertex)) <= MaxUvError;
+      });
+  }
+
+  CompactMesh createFullMesh(const Dx::IShape3d& i_shape)
+  {
+    const auto& verts = i_shape.getVerts();
+
+    CompactMesh mesh;
+    mesh.inds = i_shape.getInds();
+    mesh.vertexData.resize(verts.size() * sizeof(Dx::VertexPosNormText));
+    if (!verts.empty())
+      std::memcpy(mesh.vertexData.data(), verts.data(), mesh.vertexData.size());
+    return mesh;
+  }
+
+} // anonym NS
+
+
+int CompactMesh::getVertsCount() const
+{
+  return (int)(vertexData.size() / getVertexSize(format));
+}
+
+std::size_t CompactMesh::getVertexBytes() const
+{
+  return vertexData.size();
+}
+
+
+int getVertexSize(const VertexFormat i_format)
+{
+  switch (i_format)
+  {
+  case VertexFormat::OceanGrid:
+    return sizeof(VertexOceanGrid);
+  default:
+    return sizeof(Dx::VertexPosNormText);
+  }
+}
+
+
+CompactMesh createCompactMesh(const Dx::IShape3d& i_shape, const VertexFormat i_format)
+{
+  const auto& verts = i_shape.getVerts();
+  if (i_format == VertexFormat::Full || verts.empty())
+    return createFullMesh(i_shape);
+
+  Sdk::Vector3F min = verts.front().position;
+  Sdk::Vector3F max = verts.front().position;
+  for (const auto& vertex : verts)
+  {
+    min = { std::min(min.x, vertex.position.x), std::min(min.y, vertex.position.y), std::min(min.z, vertex.position.z) };
+    max = { std::max(max.x, vertex.position.x), std::max(max.y, vertex.position.y), std::max(max.z, vertex.position.z) };
+  }
+
+  CompactMesh mesh;
+  mesh.format = i_format;
+  mesh.origin = min;
+  mesh.scale = { getScale(min.x, max.x), 0, getScale(min.z, max.z) };
+  if (!fitUv(verts, false, mesh.uvOffset.x, mesh.uvScale.x) ||
+    !fitUv(verts, true, mesh.uvOffset.y, mesh.uvScale.y) ||
+    max.y - min.y > MaxHeightError)
+  {
+    return createFullMesh(i_shape);
+  }
+
+  // The height is dropped, the grid lies at the origin's
+  mesh.inds = i_shape.getInds();
+  mesh.vertexData.resize(verts.size() * sizeof(VertexOceanGrid));
+  auto* compactVerts = (VertexOceanGrid*)mesh.vertexData.data();
+  for (int i = 0; i < (int)verts.size(); ++i)
+  {
+    compactVerts[i].x = quantize(verts[i].position.x, mesh.origin.x, mesh.scale.x);
+    compactVerts[i].z = quantize(verts[i].position.z, mesh.origin.z, mesh.scale.z);
+  }
+
+  return mesh;
+}
+
+std::vector<Dx::VertexPosNormText> decodeCompactMesh(const CompactMesh& i_mesh)
+{
+  const int vertsCount = i_mesh.getVertsCount();
+  std::vector<Dx::VertexPosNormText> verts(vertsCount);
+
+  if (i_mesh.format == VertexFormat::Full)
+  {
+    std::memcpy(verts.data(), i_mesh.vertexData.data(), i_mesh.vertexData.size());
+    return verts;
+  }
+
+  for (int i = 0; i < vertsCount; ++i)
+  {
+    VertexOceanGrid compactVertex;
+    std::memcpy(&compactVertex, i_mesh.vertexData.data() + i * sizeof(VertexOceanGrid), sizeof(VertexOceanGrid));
+
+    auto& vertex = verts[i];
+    vertex.position = {
+      i_mesh.origin.x + compactVertex.x * i_mesh.scale.x,
+      i_mesh.origin.y,
+      i_mesh.origin.z + compactVertex.z * i_mesh.scale.z };
+    vertex.normal = { 0, 1, 0 };
+    vertex.texture = {
+      i_mesh.uvOffset.x + vertex.position.x * i_mesh.uvScale.x,
+      i_mesh.uvOffset.y + vertex.position.z * i_mesh.uvScale.y };
+  }
+
+  return verts;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <LaggyDx/LaggyDxFwd.h>
+#include <LaggyDx/VertexTypes.h>
+
+#include <LaggySdk/Vector.h>
+
+#include <cstdint>
+#include <vector>
+
+
+enum class VertexFormat
+{
+  // Dx::VertexPosNormText, 32 bytes
+  Full,
+  // Flat grid, height and normal come from the waves in the shader. 4 bytes
+  OceanGrid,
+};
+
+struct VertexOceanGrid
+{
+  std::uint16_t x = 0;
+  std::uint16_t z = 0;
+};
+
+static_assert(sizeof(VertexOceanGrid) == 4);
+
+
+// Vertices of a shape in one of the formats. Positions are quantized over the shape's bounds,
+// position = origin + quantized * scale. Texture coordinates are not stored, they are an affine
+// function of x and z in the generated meshes: uv = uvOffset + { x, z } * uvScale.
+// No shader reads the compact formats yet, they are what the uploads would take
+struct CompactMesh
+{
+  VertexFormat format = VertexFormat::Full;
+
+  Sdk::Vector3F origin;
+  Sdk::Vector3F scale;
+  Sdk::Vector2F uvOffset;
+  Sdk::Vector2F uvScale;
+
+  std::vector<std::uint8_t> vertexData;
+  std::vector<int> inds;
+
+  int getVertsCount() const;
+  std::size_t getVertexBytes() const;
+};
+
+int getVertexSize(VertexFormat i_format);
+
+// Falls back to the full format if the shape can't be stored in the requested one: its
+// texture coordinates are not an affine function of x and z, or it's not flat for the ocean grid
+CompactMesh createCompactMesh(const Dx::IShape3d& i_shape, VertexFormat i_format);
+// Reference of what the vertex shader would do. Ocean grid normals are up
+std::vector<Dx::VertexPosNormText> decodeCompactMesh(const CompactMesh& i_mesh);
@@ -0,0 +1,666 @@
+#include "stdafx.h"
+#include "DynamicRoam.h"
+
+#include <LaggyDx/Shape3d.h>
+
+#include <bit>
+
+
+namespace
+{
+  constexpr std::uint8_t Active = 1 << 0;
+  constexpr std::uint8_t InSplitQueue = 1 << 1;
+  constexpr std::uint8_t InMergeQueue = 1 << 2;
+
+  bool isSame(const Sdk::Vector3F& i_left, const Sdk::Vector3F& i_right)
+  {
+    return i_left.x == i_right.x && i_left.y == i_right.y && i_left.z == i_right.z;
+  }
+
+} // anonym NS
+
+
+DynamicRoam::DynamicRoam(const float i_size, const int i_maxDepth, RoamPriority i_priority)
+  : d_size(i_size)
+  , d_maxDepth(i_maxDepth)
+  , d_priority(std::move(i_priority))
+{
+  CONTRACT_EXPECT(i_size > 0);
+  CONTRACT_EXPECT(i_maxDepth > 0);
+  CONTRACT_EXPECT(d_priority);
+
+  d_levelsCount = (d_maxDepth + 1) / 2;
+  d_gridSize = (1 << d_levelsCount) + 1;
+
+  const size_t verticesCount = (size_t)d_gridSize * d_gridSize;
+  d_flags.assign(verticesCount, 0);
+  d_priorities.assign(verticesCount, 0.0f);
+  d_queuedPositions.assign(verticesCount, -1);
+
+  d_vertexSlots.assign(verticesCount, -1);
+
+  const int last = d_gridSize - 1;
+  for (const int corner : { getIndex(0, 0), getIndex(last, 0), getIndex(0, last), getIndex(last, last) })
+    d_flags[corner] |= Active;
+  d_trisCount = 2;
+
+  // Same as the roots of createShape()
+  addTri(getIndex(0, last), getIndex(last, last), getIndex(0, 0));
+  addTri(getIndex(last, 0), getIndex(0, 0), getIndex(last, last));
+
+  updateSplitCandidate(getIndex(last / 2, last / 2));
+}
+
+
+void DynamicRoam::setMaxTrisCount(const int i_count)
+{
+  d_maxTrisCount = i_count;
+}
+
+void DynamicRoam::setOperationsBudget(const int i_count)
+{
+  CONTRACT_EXPECT(i_count >= getMinOperationsBudget(d_maxDepth));
+  d_operationsBudget = i_count;
+}
+
+int DynamicRoam::getMinOperationsBudget(const int i_maxDepth)
+{
+  // Covers the longest chain of forced splits, which grows by at most 7 vertices per level
+  // of depth (107 vertices for the depth 20, from a mesh of the two root triangles)
+  return 7 * i_maxDepth;
+}
+
+void DynamicRoam::setRefreshBudget(const int i_count)
+{
+  d_refreshBudget = i_count;
+}
+
+
+void DynamicRoam::reset(const Sdk::Vector3F& i_viewPosition)
+{
+  d_viewPosition = i_viewPosition;
+  d_pendingRefreshesCount = (int)d_queued.size();
+  refreshPriorities(std::numeric_limits<int>::max());
+
+  int operationsLeft = std::numeric_limits<int>::max();
+  while (step(operationsLeft));
+}
+
+bool DynamicRoam::update(const Sdk::Vector3F& i_viewPosition)
+{
+  d_lastSplitsCount = 0;
+  d_lastMergesCount = 0;
+  d_lastRefreshesCount = 0;
+
+  // Priorities depend on the view position only, so nothing has to be re-evaluated
+  // while the view stays in place
+  if (!isSame(i_viewPosition, d_viewPosition))
+  {
+    d_viewPosition = i_viewPosition;
+    d_pendingRefreshesCount = (int)d_queued.size();
+  }
+
+  refreshPriorities(d_refreshBudget);
+
+  int operationsLeft = d_operationsBudget;
+  while (step(operationsLeft));
+
+  return d_lastSplitsCount > 0 || d_lastMergesCount > 0;
+}
+
+
+int DynamicRoam::getTrisCount() const
+{
+  return d_trisCount;
+}
+
+int DynamicRoam::getLastSplitsCount() const
+{
+  return d_lastSplitsCount;
+}
+
+int DynamicRoam::getLastMergesCount() const
+{
+  return d_lastMergesCount;
+}
+
+int DynamicRoam::getLastRefreshesCount() const
+{
+  return d_lastRefreshesCount;
+}
+
+
+bool DynamicRoam::step(int& io_operationsLeft)
+{
+  if (io_operationsLeft <= 0)
+    return false;
+
+  const bool canMerge = !d_mergeQueue.empty();
+  const bool canSplit = !d_splitQueue.empty();
+  const auto [worstMergePriority, worstMerge] = canMerge ? *d_mergeQueue.begin() : std::pair<float, int>{ 0.0f, -1 };
+  const auto [bestSplitPriority, bestSplit] = canSplit ? *d_splitQueue.rbegin() : std::pair<float, int>{ 0.0f, -1 };
+
+  if (canMerge && (d_trisCount > d_maxTrisCount || worstMergePriority < 0))
+  {
+    merge(worstMerge);
+    --io_operationsLeft;
+    return true;
+  }
+
+  if (!canSplit || bestSplitPriority <= 0)
+    return false;
+
+  d_splits.clear();
+  collectSplits(bestSplit, d_splits);
+  // Waits for the next update rather than leaving a part of the forced splits done
+  if ((int)d_splits.size() > io_operationsLeft)
+    return false;
+
+  if (trySplit(bestSplit, io_operationsLeft))
+    return true;
+
+  // Over the triangles limit - trade the least important diamond for the most important one
+  if (!canMerge || bestSplitPriority <= worstMergePriority || io_operationsLeft < (int)d_splits.size() + 1)
+    return false;
+
+  merge(worstMerge);
+  --io_operationsLeft;
+
+  if (d_splitQueue.empty() || d_splitQueue.rbegin()->first <= worstMergePriority)
+    return false;
+
+  return trySplit(d_splitQueue.rbegin()->second, io_operationsLeft);
+}
+
+bool DynamicRoam::trySplit(const int i_vertex, int& io_operationsLeft)
+{
+  d_splits.clear();
+  collectSplits(i_vertex, d_splits);
+
+  int addedTrisCount = 0;
+  for (const int vertex : d_splits)
+    addedTrisCount += getParents(vertex).count;
+
+  if ((int)d_splits.size() > io_operationsLeft || d_trisCount + addedTrisCount > d_maxTrisCount)
+    return false;
+
+  for (const int vertex : d_splits)
+    split(vertex);
+  io_operationsLeft -= (int)d_splits.size();
+  return true;
+}
+
+void DynamicRoam::refreshPriorities(const int i_budget)
+{
+  const int count = std::min(i_budget, d_pendingRefreshesCount);
+  for (int i = 0; i < count && !d_queued.empty(); ++i)
+  {
+    d_refreshCursor %= (int)d_queued.size();
+    const int vertex = d_queued[d_refreshCursor++];
+
+    const float priority = evaluatePriority(vertex);
+    if (priority == d_priorities[vertex])
+      continue;
+
+    auto& queue = (d_flags[vertex] & InSplitQueue) ? d_splitQueue : d_mergeQueue;
+    queue.erase({ d_priorities[vertex], vertex });
+    d_priorities[vertex] = priority;
+    queue.insert({ priority, vertex });
+  }
+
+  d_pendingRefreshesCount -= count;
+  d_lastRefreshesCount += count;
+}
+
+
+void DynamicRoam::collectSplits(const int i_vertex, std::vector<int>& io_splits) const
+{
+  for (const int parent : getParents(i_vertex))
+  {
+    if (!isActive(parent) && std::find(io_splits.begin(), io_splits.end(), parent) == io_splits.end())
+      collectSplits(parent, io_splits);
+  }
+  io_splits.push_back(i_vertex);
+}
+
+
+void DynamicRoam::split(const int i_vertex)
+{
+  // Both triangles of the diamond have to exist, see collectSplits()
+  const auto parents = getParents(i_vertex);
+  CONTRACT_EXPECT(std::all_of(parents.begin(), parents.end(), [&](const int i_parent) {
+    return isActive(i_parent);
+    }));
+
+  for (const int parent : parents)
+  {
+    const auto [left, right] = getOrderedHypotenuse(i_vertex, parent);
+    removeTri(parent, left);
+    addTri(i_vertex, right, parent);
+    addTri(i_vertex, parent, left);
+  }
+
+  d_flags[i_vertex] |= Active;
+  d_trisCount += parents.count;
+  ++d_lastSplitsCount;
+
+  updateSplitCandidate(i_vertex);
+  updateMergeCandidate(i_vertex);
+  for (const int parent : parents)
+    updateMergeCandidate(parent);
+  for (const int child : getChildren(i_vertex))
+    updateSplitCandidate(child);
+}
+
+void DynamicRoam::merge(const int i_vertex)
+{
+  const auto parents = getParents(i_vertex);
+
+  for (const int parent : parents)
+  {
+    const auto [left, right] = getOrderedHypotenuse(i_vertex, parent);
+    removeTri(i_vertex, right);
+    removeTri(i_vertex, parent);
+    addTri(parent, left, right);
+  }
+
+  d_flags[i_vertex] &= ~Active;
+  d_trisCount -= parents.count;
+  ++d_lastMergesCount;
+
+  updateMergeCandidate(i_vertex);
+  updateSplitCandidate(i_vertex);
+  for (const int parent : parents)
+    updateMergeCandidate(parent);
+  for (const int child : getChildren(i_vertex))
+    updateSplitCandidate(child);
+}
+
+
+void DynamicRoam::addTri(const int i_apex, const int i_left, const int i_right)
+{
+  int slot = 0;
+  if (d_freeTriSlots.empty())
+  {
+    slot = (int)d_shape.getInds().size() / 3;
+    d_shape.getInds().resize(d_shape.getInds().size() + 3);
+  }
+  else
+  {
+    slot = d_freeTriSlots.back();
+    d_freeTriSlots.pop_back();
+  }
+
+  auto* inds = d_shape.getInds().data() + (size_t)slot * 3;
+  inds[0] = addVertexRef(i_apex);
+  inds[1] = addVertexRef(i_left);
+  inds[2] = addVertexRef(i_right);
+
+  d_triSlots[(std::int64_t)i_apex * d_vertexSlots.size() + i_left] = slot;
+}
+
+void DynamicRoam::removeTri(const int i_apex, const int i_left)
+{
+  const auto it = d_triSlots.find((std::int64_t)i_apex * d_vertexSlots.size() + i_left);
+  CONTRACT_EXPECT(it != d_triSlots.end());
+  const int slot = it->second;
+  d_triSlots.erase(it);
+
+  auto* inds = d_shape.getInds().data() + (size_t)slot * 3;
+  for (int i = 0; i < 3; ++i)
+  {
+    removeVertexRef(inds[i]);
+    inds[i] = 0;
+  }
+  d_freeTriSlots.push_back(slot);
+}
+
+int DynamicRoam::addVertexRef(const int i_vertex)
+{
+  int& slot = d_vertexSlots[i_vertex];
+  if (slot < 0)
+  {
+    auto& verts = d_shape.getVerts();
+    if (d_freeVertexSlots.empty())
+    {
+      slot = (int)verts.size();
+      verts.emplace_back();
+      d_slotVertices.push_back(0);
+      d_slotRefsCount.push_back(0);
+    }
+    else
+    {
+      slot = d_freeVertexSlots.back();
+      d_freeVertexSlots.pop_back();
+    }
+
+    auto& vertex = verts[slot];
+    vertex.position = getPosition(i_vertex);
+    vertex.normal = { 0, 1, 0 };
+    vertex.texture = {
+      (float)(i_vertex % d_gridSize) / (d_gridSize - 1),
+      (float)(i_vertex / d_gridSize) / (d_gridSize - 1) };
+    d_slotVertices[slot] = i_vertex;
+  }
+
+  ++d_slotRefsCount[slot];
+  return slot;
+}
+
+void DynamicRoam::removeVertexRef(const int i_slot)
+{
+  if (--d_slotRefsCount[i_slot] > 0)
+    return;
+
+  d_vertexSlots[d_slotVertices[i_slot]] = -1;
+  d_freeVertexSlots.push_back(i_slot);
+}
+
+
+void DynamicRoam::updateSplitCandidate(const int i_vertex)
+{
+  bool isCandidate = !isActive(i_vertex) && !isCorner(i_vertex) && getDepth(i_vertex) < d_maxDepth;
+  if (isCandidate)
+  {
+    const auto parents = getParents(i_vertex);
+    isCandidate = std::any_of(parents.begin(), parents.end(), [&](const int i_parent) {
+      return isActive(i_parent);
+      });
+  }
+
+  auto& flags = d_flags[i_vertex];
+  if (isCandidate && !(flags & InSplitQueue))
+  {
+    d_priorities[i_vertex] = evaluatePriority(i_vertex);
+    d_splitQueue.insert({ d_priorities[i_vertex], i_vertex });
+    flags |= InSplitQueue;
+  }
+  else if (!isCandidate && (flags & InSplitQueue))
+  {
+    d_splitQueue.erase({ d_priorities[i_vertex], i_vertex });
+    flags &= ~InSplitQueue;
+  }
+
+  updateQueued(i_vertex);
+}
+
+void DynamicRoam::updateMergeCandidate(const int i_vertex)
+{
+  bool isCandidate = isActive(i_vertex) && !isCorner(i_vertex);
+  if (isCandidate)
+  {
+    const auto children = getChildren(i_vertex);
+    isCandidate = std::none_of(children.begin(), children.end(), [&](const int i_child) {
+      return isActive(i_child);
+      });
+  }
+
+  auto& flags = d_flags[i_vertex];
+  if (isCandidate && !(flags & InMergeQueue))
+  {
+    d_priorities[i_vertex] = evaluatePriority(i_vertex);
+    d_mergeQueue.insert({ d_priorities[i_vertex], i_vertex });
+    flags |= InMergeQueue;
+  }
+  else if (!isCandidate && (flags & InMergeQueue))
+  {
+    d_mergeQueue.erase({ d_priorities[i_vertex], i_vertex });
+    flags &= ~InMergeQueue;
+  }
+
+  updateQueued(i_vertex);
+}
+
+void DynamicRoam::updateQueued(const int i_vertex)
+{
+  const bool isQueued = d_flags[i_vertex] & (InSplitQueue | InMergeQueue);
+  auto& position = d_queuedPositions[i_vertex];
+
+  if (isQueued && position < 0)
+  {
+    position = (int)d_queued.size();
+    d_queued.push_back(i_vertex);
+  }
+  else if (!isQueued && position >= 0)
+  {
+    const int lastVertex = d_queued.back();
+    d_queued[position] = lastVertex;
+    d_queuedPositions[lastVertex] = position;
+    d_queued.pop_back();
+    position = -1;
+  }
+}
+
+
+float DynamicRoam::evaluatePriority(const int i_vertex) const
+{
+  const auto [left, right] = getHypotenuse(i_vertex);
+
+  RoamTri tri;
+  tri.depth = getDepth(i_vertex);
+  tri.left = getPosition(left);
+  tri.right = getPosition(right);
+
+  float priority = std::numeric_limits<float>::lowest();
+  for (const int parent : getParents(i_vertex))
+  {
+    tri.apex = getPosition(parent);
+    priority = std::max(priority, d_priority(tri, d_viewPosition));
+  }
+
+  return priority;
+}
+
+
+bool DynamicRoam::isActive(const int i_vertex) const
+{
+  return d_flags[i_vertex] & Active;
+}
+
+bool DynamicRoam::isCorner(const int i_vertex) const
+{
+  const int bits = (i_vertex % d_gridSize) | (i_vertex / d_gridSize);
+  return bits == 0 || std::countr_zero((unsigned)bits) >= d_levelsCount;
+}
+
+int DynamicRoam::getDepth(const int i_vertex) const
+{
+  const int x = i_vertex % d_gridSize;
+  const int z = i_vertex / d_gridSize;
+  const int level = std::countr_zero((unsigned)(x | z));
+  const bool isDiagonal = ((x >> level) & 1) && ((z >> level) & 1);
+
+  return 2 * (d_levelsCount - 1 - level) + (isDiagonal ? 0 : 1);
+}
+
+DynamicRoam::Links DynamicRoam::getParents(const int i_vertex) const
+{
+  const int x = i_vertex % d_gridSize;
+  const int z = i_vertex / d_gridSize;
+  const int level = std::countr_zero((unsigned)(x | z));
+  const int step = 1 << level;
+  const int last = d_gridSize - 1;
+
+  Links parents;
+  auto add = [&](const int i_x, const int i_z) {
+    if (i_x >= 0 && i_x <= last && i_z >= 0 && i_z <= last)
+      parents.add(getIndex(i_x, i_z));
+  };
+
+  const bool oddX = (x >> level) & 1;
+  const bool oddZ = (z >> level) & 1;
+  if (oddX && oddZ)
+  {
+    // Center of a square, the parents are at the ends of the diagonal that is not the hypotenuse
+    const int squareX = (x - step) / (2 * step);
+    const int squareZ = (z - step) / (2 * step);
+    if ((squareX + squareZ) % 2 == 0)
+    {
+      add(x + step, z - step);
+      add(x - step, z + step);
+    }
+    else
+    {
+      add(x - step, z - step);
+      add(x + step, z + step);
+    }
+  }
+  else if (oddX)
+  {
+    add(x, z - step);
+    add(x, z + step);
+  }
+  else
+  {
+    add(x - step, z);
+    add(x + step, z);
+  }
+
+  return parents;
+}
+
+DynamicRoam::Links DynamicRoam::getChildren(const int i_vertex) const
+{
+  const int x = i_vertex % d_gridSize;
+  const int z = i_vertex / d_gridSize;
+  const int level = std::countr_zero((unsigned)(x | z));
+  const bool isDiagonal = ((x >> level) & 1) && ((z >> level) & 1);
+
+  Links children;
+  if (!isDiagonal && level == 0)
+    return children;
+
+  // Children split the legs of the diamond, i.e. the edges between the parents and the hypotenuse ends
+  const auto [left, right] = getHypotenuse(i_vertex);
+  for (const int parent : getParents(i_vertex))
+  {
+    for (const int end : { left, right })
+    {
+      children.add(getIndex(
+        (parent % d_gridSize + end % d_gridSize) / 2,
+        (parent / d_gridSize + end / d_gridSize) / 2));
+    }
+  }
+
+  return children;
+}
+
+std::pair<int, int> DynamicRoam::getHypotenuse(const int i_vertex) const
+{
+  const int x = i_vertex % d_gridSize;
+  const int z = i_vertex / d_gridSize;
+  const int level = std::countr_zero((unsigned)(x | z));
+  const int step = 1 << level;
+
+  const bool oddX = (x >> level) & 1;
+  const bool oddZ = (z >> level) & 1;
+  if (oddX && oddZ)
+  {
+    const int squareX = (x - step) / (2 * step);
+    const int squareZ = (z - step) / (2 * step);
+    if ((squareX + squareZ) % 2 == 0)
+      return { getIndex(x - step, z - step), getIndex(x + step, z + step) };
+    return { getIndex(x + step, z - step), getIndex(x - step, z + step) };
+  }
+  if (oddX)
+    return { getIndex(x - step, z), getIndex(x + step, z) };
+  return { getIndex(x, z - step), getIndex(x, z + step) };
+}
+
+
+std::pair<int, int> DynamicRoam::getOrderedHypotenuse(const int i_vertex, const int i_apex) const
+{
+  const auto [left, right] = getHypotenuse(i_vertex);
+
+  // Same winding as the roots of createShape()
+  const int apexX = i_apex % d_gridSize;
+  const int apexZ = i_apex / d_gridSize;
+  const int cross =
+    (left / d_gridSize - apexZ) * (right % d_gridSize - apexX) -
+    (left % d_gridSize - apexX) * (right / d_gridSize - apexZ);
+
+  if (cross > 0)
+    return { left, right };
+  return { right, left };
+}
+
+
+int DynamicRoam::getIndex(const int i_x, const int i_z) const
+{
+  return i_x + i_z * d_gridSize;
+}
+
+Sdk::Vector3F DynamicRoam::getPosition(const int i_vertex) const
+{
+  const float cellSize = d_size / (d_gridSize - 1);
+  return { (i_vertex % d_gridSize) * cellSize, 0, (i_vertex / d_gridSize) * cellSize };
+}
+
+
+const Dx::IShape3d& DynamicRoam::getShape() const
+{
+  return d_shape;
+}
+
+std::shared_ptr<Dx::IShape3d> DynamicRoam::createShape() const
+{
+  struct Node
+  {
+    int apex = 0;
+    int left = 0;
+    int right = 0;
+    int depth = 0;
+  };
+
+  auto shape = std::make_shared<Dx::Shape3d>();
+  auto& verts = shape->getVerts();
+  auto& inds = shape->getInds();
+  inds.reserve((size_t)d_trisCount * 3);
+
+  std::unordered_map<int, int> vertexIndices;
+  vertexIndices.reserve(d_trisCount);
+
+  auto getVertexIndex = [&](const int i_gridIndex) {
+    const auto [it, inserted] = vertexIndices.insert({ i_gridIndex, (int)verts.size() });
+    if (inserted)
+    {
+      Dx::VertexPosNormText vertex;
+      vertex.position = getPosition(i_gridIndex);
+      vertex.normal = { 0, 1, 0 };
+      vertex.texture = {
+        (float)(i_gridIndex % d_gridSize) / (d_gridSize - 1),
+        (float)(i_gridIndex / d_gridSize) / (d_gridSize - 1) };
+      verts.push_back(vertex);
+    }
+    return it->second;
+  };
+
+  // Same traversal and winding as in ParallelRoam
+  const int last = d_gridSize - 1;
+  std::vector<Node> nodes{
+    { getIndex(0, last), getIndex(last, last), getIndex(0, 0), 0 },
+    { getIndex(last, 0), getIndex(0, 0), getIndex(last, last), 0 } };
+
+  while (!nodes.empty())
+  {
+    const auto node = nodes.back();
+    nodes.pop_back();
+
+    const int middle = getIndex(
+      (node.left % d_gridSize + node.right % d_gridSize) / 2,
+      (node.left / d_gridSize + node.right / d_gridSize) / 2);
+
+    if (node.depth < d_maxDepth && isActive(middle))
+    {
+      nodes.push_back({ middle, node.right, node.apex, node.depth + 1 });
+      nodes.push_back({ middle, node.apex, node.left, node.depth + 1 });
+      continue;
+    }
+
+    inds.push_back(getVertexIndex(node.apex));
+    inds.push_back(getVertexIndex(node.left));
+    inds.push_back(getVertexIndex(node.right));
+  }
+
+  return shape;
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "ParallelRoam.h"
+
+#include <LaggyDx/Shape3d.h>
+
+#include <array>
+#include <set>
+#include <unordered_map>
+
+
+// Priority of splitting a triangle for the given view position. Positive means the
+// triangle wants to be split, negative - that it wants to be merged
+using RoamPriority = std::function<float(const RoamTri&, const Sdk::Vector3F& i_viewPosition)>;
+
+
+// Split/merge ROAM over the same 4-8 grid as ParallelRoam. Keeps a split queue of leaf
+// diamonds and a merge queue of mergeable diamonds and performs a limited number of
+// operations per update, so the per-frame cost and the triangles count stay bounded
+// wherever the view position goes. The splits a split forces to stay crack-free count
+// against both limits. The mesh is kept in a persistent buffer: every operation only
+// rewrites the triangles it changes
+class DynamicRoam
+{
+public:
+  DynamicRoam(float i_size, int i_maxDepth, RoamPriority i_priority);
+
+  void setMaxTrisCount(int i_count);
+  // Max number of splits and merges per update, forced splits included. A split is never
+  // done partially, so the budget has to fit the longest chain of forced splits
+  void setOperationsBudget(int i_count);
+  static int getMinOperationsBudget(int i_maxDepth);
+  // Max number of queued priorities re-evaluated per update
+  void setRefreshBudget(int i_count);
+
+  // Refines the mesh for the given view position without any budgets
+  void reset(const Sdk::Vector3F& i_viewPosition);
+  // Returns true if the mesh has changed
+  bool update(const Sdk::Vector3F& i_viewPosition);
+
+  int getTrisCount() const;
+  int getLastSplitsCount() const;
+  int getLastMergesCount() const;
+  int getLastRefreshesCount() const;
+
+  // The persistent buffer. Slots of the merged triangles are degenerate until reused,
+  // and the vertices no triangle uses are left in place
+  const Dx::IShape3d& getShape() const;
+  // Only the used slots, in the traversal order
+  std::shared_ptr<Dx::IShape3d> createShape() const;
+
+private:
+  struct Links
+  {
+    std::array<int, 4> items{};
+    int count = 0;
+
+    void add(int i_vertex) { items[count++] = i_vertex; }
+    const int* begin() const { return items.data(); }
+    const int* end() const { return items.data() + count; }
+  };
+
+  float d_size = 0;
+  int d_maxDepth = 0;
+  int d_gridSize = 0;
+  int d_levelsCount = 0;
+  RoamPriority d_priority;
+
+  int d_maxTrisCount = 100000;
+  int d_operationsBudget = 1000;
+  int d_refreshBudget = 10000;
+
+  std::vector<std::uint8_t> d_flags;
+  std::vector<float> d_priorities;
+  std::set<std::pair<float, int>> d_splitQueue;
+  std::set<std::pair<float, int>> d_mergeQueue;
+
+  // All queued vertices, used to re-evaluate priorities in a round-robin way
+  std::vector<int> d_queued;
+  std::vector<int> d_queuedPositions;
+  int d_refreshCursor = 0;
+  int d_pendingRefreshesCount = 0;
+
+  Dx::Shape3d d_shape;
+  // Keyed by the apex and the left vertex, which define the triangle given the winding
+  std::unordered_map<std::int64_t, int> d_triSlots;
+  std::vector<int> d_freeTriSlots;
+  // Per grid vertex, -1 if unused
+  std::vector<int> d_vertexSlots;
+  // Per vertex slot
+  std::vector<int> d_slotVertices;
+  std::vector<int> d_slotRefsCount;
+  std::vector<int> d_freeVertexSlots;
+  // Reused by trySplit()
+  std::vector<int> d_splits;
+
+  Sdk::Vector3F d_viewPosition;
+  int d_trisCount = 0;
+  int d_lastSplitsCount = 0;
+  int d_lastMergesCount = 0;
+  int d_lastRefreshesCount = 0;
+
+  bool step(int& io_operationsLeft);
+  bool trySplit(int i_vertex, int& io_operationsLeft);
+  void refreshPriorities(int i_budget);
+
+  // The inactive ancestors first, then the vertex itself
+  void collectSplits(int i_vertex, std::vector<int>& o_splits) const;
+
+  void split(int i_vertex);
+  void merge(int i_vertex);
+
+  void addTri(int i_apex, int i_left, int i_right);
+  void removeTri(int i_apex, int i_left);
+  int addVertexRef(int i_vertex);
+  void removeVertexRef(int i_slot);
+  // Ends of the hypotenuse of the triangle with this apex, in the winding order
+  std::pair<int, int> getOrderedHypotenuse(int i_vertex, int i_apex) const;
+
+  void updateSplitCandidate(int i_vertex);
+  void updateMergeCandidate(int i_vertex);
+  void updateQueued(int i_vertex);
+
+  float evaluatePriority(int i_vertex) const;
+
+  bool isActive(int i_vertex) const;
+  bool isCorner(int i_vertex) const;
+  int getDepth(int i_vertex) const;
+  Links getParents(int i_vertex) const;
+  Links getChildren(int i_vertex) const;
+  std::pair<int, int> getHypotenuse(int i_vertex) const;
+
+  int getIndex(int i_x, int i_z) const;
+  Sdk::Vector3F getPosition(int i_vertex) const;
+};
@@ -0,0 +1,167 @@
+#include "stdafx.h"
+#include "Fft2d.h"
+
+#include "Simd.h"
+#include "ThreadPool.h"
+
+#include <LaggySdk/Math.h>
+
+
+namespace
+{
+  // Rows or columns transformed together, one per SIMD lane. A block of a 512 grid fits
+  // in L1
+  constexpr int BlockSize = 8;
+
+} // anonym NS
+
+
+Fft2d::Fft2d(const int i_size)
+  : d_size(i_size)
+  , d_bitReverse(i_size)
+  , d_twiddleReal(i_size / 2)
+  , d_twiddleImag(i_size / 2)
+{
+  CONTRACT_EXPECT(i_size >= 16);
+  CONTRACT_EXPECT((i_size & (i_size - 1)) == 0);
+
+  int bitsCount = 0;
+  while ((1 << bitsCount) < i_size)
+    ++bitsCount;
+
+  for (int i = 0; i < i_size; ++i)
+  {
+    int reversed = 0;
+    for (int bit = 0; bit < bitsCount; ++bit)
+    {
+      if (i & (1 << bit))
+        reversed |= 1 << (bitsCount - 1 - bit);
+    }
+    d_bitReverse[i] = reversed;
+  }
+
+  // Positive exponent - inverse transform
+  for (int i = 0; i < i_size / 2; ++i)
+  {
+    const double angle = Sdk::Pi2 * i / i_size;
+    d_twiddleReal[i] = (float)std::cos(angle);
+    d_twiddleImag[i] = (float)std::sin(angle);
+  }
+}
+
+
+int Fft2d::getSize() const
+{
+  return d_size;
+}
+
+
+void Fft2d::inverse(float* io_real, float* io_imag, ThreadPool& i_threadPool) const
+{
+  const int blocksCount = d_size / BlockSize;
+
+  i_threadPool.parallelFor(0, blocksCount, [&](const int i_block) {
+    transformBlock(io_real, io_imag, i_block * BlockSize, false);
+    });
+
+  i_threadPool.parallelFor(0, blocksCount, [&](const int i_block) {
+    transformBlock(io_real, io_imag, i_block * BlockSize, true);
+    });
+}
+
+
+void Fft2d::transformBlock(float* io_real, float* io_imag, const int i_begin, const bool i_rows) const
+{
+  using T = Simd::Native;
+  static_assert(BlockSize % T::Width == 0);
+
+  // The block is copied out as BlockSize columns, so the butterflies work on contiguous lanes
+  // and don't walk the grid with a power of two stride. Rows of a block are transposed on the
+  // way, and the elements are put to their bit-reversed places
+  thread_local std::vector<float> blockReal;
+  thread_local std::vector<float> blockImag;
+  blockReal.resize(d_size * BlockSize);
+  blockImag.resize(d_size * BlockSize);
+
+  if (i_rows)
+  {
+    for (int lane = 0; lane < BlockSize; ++lane)
+    {
+      const float* real = io_real + (i_begin + lane) * d_size;
+      const float* imag = io_imag + (i_begin + lane) * d_size;
+      for (int i = 0; i < d_size; ++i)
+      {
+        const int offset = d_bitReverse[i] * BlockSize + lane;
+        blockReal[offset] = real[i];
+        blockImag[offset] = imag[i];
+      }
+    }
+  }
+  else
+  {
+    for (int i = 0; i < d_size; ++i)
+    {
+      const int offset = d_bitReverse[i] * BlockSize;
+      std::copy_n(io_real + i * d_size + i_begin, BlockSize, blockReal.data() + offset);
+      std::copy_n(io_imag + i * d_size + i_begin, BlockSize, blockImag.data() + offset);
+    }
+  }
+
+  for (int length = 2; length <= d_size; length *= 2)
+  {
+    const int half = length / 2;
+    const int twiddleStep = d_size / length;
+
+    for (int start = 0; start < d_size; start += length)
+    {
+      for (int j = 0; j < half; ++j)
+      {
+        const auto wr = T::set(d_twiddleReal[j * twiddleStep]);
+        const auto wi = T::set(d_twiddleImag[j * twiddleStep]);
+
+        float* aReal = blockReal.data() + (start + j) * BlockSize;
+        float* aImag = blockImag.data() + (start + j) * BlockSize;
+        float* bReal = aReal + half * BlockSize;
+        float* bImag = aImag + half * BlockSize;
+
+        for (int lane = 0; lane < BlockSize; lane += T::Width)
+        {
+          const auto ar = T::load(aReal + lane);
+          const auto ai = T::load(aImag + lane);
+          const auto br = T::load(bReal + lane);
+          const auto bi = T::load(bImag + lane);
+
+          const auto tr = T::sub(T::mul(wr, br), T::mul(wi, bi));
+          const auto ti = T::add(T::mul(wr, bi), T::mul(wi, br));
+
+          T::store(aReal + lane, T::add(ar, tr));
+          T::store(aImag + lane, T::add(ai, ti));
+          T::store(bReal + lane, T::sub(ar, tr));
+          T::store(bImag + lane, T::sub(ai, ti));
+        }
+      }
+    }
+  }
+
+  if (i_rows)
+  {
+    for (int lane = 0; lane < BlockSize; ++lane)
+    {
+      float* real = io_real + (i_begin + lane) * d_size;
+      float* imag = io_imag + (i_begin + lane) * d_size;
+      for (int i = 0; i < d_size; ++i)
+      {
+        real[i] = blockReal[i * BlockSize + lane];
+        imag[i] = blockImag[i * BlockSize + lane];
+      }
+    }
+  }
+  else
+  {
+    for (int i = 0; i < d_size; ++i)
+    {
+      std::copy_n(blockReal.data() + i * BlockSize, BlockSize, io_real + i * d_size + i_begin);
+      std::copy_n(blockImag.data() + i * BlockSize, BlockSize, io_imag + i * d_size + i_begin);
+    }
+  }
+}
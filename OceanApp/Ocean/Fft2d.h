@@ -0,0 +1,29 @@
+#pragma once
+
+#include <vector>
+
+
+class ThreadPool;
+
+
+// Inverse 2D FFT of a square complex grid, without normalization. The grid is row-major
+// with the real and imaginary parts in separate planes. Columns, and then rows, are
+// transformed in blocks, one per SIMD lane, a block per task
+class Fft2d
+{
+public:
+  // i_size has to be a power of two, not less than 16
+  Fft2d(int i_size);
+
+  int getSize() const;
+
+  void inverse(float* io_real, float* io_imag, ThreadPool& i_threadPool) const;
+
+private:
+  int d_size = 0;
+  std::vector<int> d_bitReverse;
+  std::vector<float> d_twiddleReal;
+  std::vector<float> d_twiddleImag;
+
+  void transformBlock(float* io_real, float* io_imag, int i_begin, bool i_rows) const;
+};
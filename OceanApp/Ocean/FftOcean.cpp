@@ -0,0 +1,372 @@
+#include "stdafx.h"
+#include "FftOcean.h"
+
+#include "Simd.h"
+#include "ThreadPool.h"
+
+#include <LaggyDx/IShape3d.h>
+#include <LaggyDx/Shape3d.h>
+#include <LaggySdk/Math.h>
+
+#include <random>
+
+
+namespace
+{
+  constexpr float Gravity = 9.8f;
+
+  // Frequencies are rounded to multiples of 2Pi / LoopPeriod, so the phases only depend on the
+  // time within the loop and stay precise at any time. The sea repeats itself once per this
+  // many seconds
+  constexpr double LoopPeriod = 1000;
+  // Bits of a float mantissa
+  constexpr int FloatBits = 24;
+
+  constexpr float PhillipsConstant = 0.0081f;
+  constexpr float JonswapGamma = 3.3f;
+
+  constexpr int RowsPerTask = 16;
+
+
+  // Wave number of the i-th FFT element, negative ones are in the second half
+  float getWaveNumber(const int i_index, const int i_size, const float i_tileSize)
+  {
+    const int n = i_index < i_size / 2 ? i_index : i_index - i_size;
+    return (float)(Sdk::Pi2 * n / i_tileSize);
+  }
+
+  // Waves only go downwind, cos^2 spreading, integrates to 1 over the angle
+  float getDirectionalSpreading(const float i_kx, const float i_kz, const Sdk::Vector2F& i_windDirection)
+  {
+    const float k = std::sqrt(i_kx * i_kx + i_kz * i_kz);
+    const float cos = (i_kx * i_windDirection.x + i_kz * i_windDirection.y) / k;
+    return cos > 0 ? (float)(2 / Sdk::Pi) * cos * cos : 0;
+  }
+
+} // anonym NS
+
+
+FftOcean::FftOcean(const FftOceanSettings& i_settings, const unsigned i_seed)
+  : d_settings(i_settings)
+  , d_size(i_settings.resolution)
+  , d_fft(i_settings.resolution)
+{
+  CONTRACT_EXPECT(i_settings.tileSize > 0);
+  CONTRACT_EXPECT(i_settings.windSpeed > 0);
+
+  const float windLength = std::sqrt(
+    d_settings.windDirection.x * d_settings.windDirection.x + d_settings.windDirection.y * d_settings.windDirection.y);
+  CONTRACT_EXPECT(windLength > 0);
+  d_settings.windDirection = { d_settings.windDirection.x / windLength, d_settings.windDirection.y / windLength };
+
+  const int count = d_size * d_size;
+  for (auto* field : { &d_kx, &d_kz, &d_omega, &d_h0Real, &d_h0Imag, &d_h0MinusReal, &d_h0MinusImag,
+    &d_heightXReal, &d_heightXImag, &d_zSlopeXReal, &d_zSlopeXImag, &d_slopeZReal, &d_slopeZImag })
+  {
+    field->resize(count);
+  }
+  d_displacementMap.resize(count);
+  d_normalMap.resize(count);
+
+  initSpectrum(i_seed);
+}
+
+
+const FftOceanSettings& FftOcean::getSettings() const
+{
+  return d_settings;
+}
+
+float FftOcean::getSignificantWaveHeight() const
+{
+  return d_significantWaveHeight;
+}
+
+
+float FftOcean::getSpectrum(const float i_kx, const float i_kz) const
+{
+  const float k = std::sqrt(i_kx * i_kx + i_kz * i_kz);
+  if (k == 0)
+    return 0;
+
+  const float spreading = getDirectionalSpreading(i_kx, i_kz, d_settings.windDirection);
+  if (spreading == 0)
+    return 0;
+
+  const float windSpeed = d_settings.windSpeed;
+
+  if (d_settings.spectrum == OceanSpectrum::Phillips)
+  {
+    // The largest waves the wind can raise, and a cut of the ones much smaller than those
+    const float largestLength = windSpeed * windSpeed / Gravity;
+    const float smallestLength = largestLength / 1000;
+
+    const float kl = k * largestLength;
+    return PhillipsConstant / 2 * std::exp(-1 / (kl * kl)) / (k * k * k * k) *
+      std::exp(-k * k * smallestLength * smallestLength) * spreading;
+  }
+
+  // JONSWAP over the frequency, converted to the wave vector space
+  const float fetch = d_settings.fetch;
+  const float alpha = 0.076f * std::pow(windSpeed * windSpeed / (fetch * Gravity), 0.22f);
+  const float peakOmega = 22 * std::pow(Gravity * Gravity / (windSpeed * fetch), 1.0f / 3);
+
+  const float omega = std::sqrt(Gravity * k);
+  const float sigma = omega <= peakOmega ? 0.07f : 0.09f;
+  const float peakOffset = (omega - peakOmega) / (sigma * peakOmega);
+  const float peakRatio = peakOmega / omega;
+
+  const float spectrum = alpha * Gravity * Gravity / std::pow(omega, 5.0f) *
+    std::exp(-1.25f * peakRatio * peakRatio * peakRatio * peakRatio) *
+    std::pow(JonswapGamma, std::exp(-0.5f * peakOffset * peakOffset));
+
+  const float omegaDerivative = Gravity / (2 * omega);
+  return spectrum * omegaDerivative / k * spreading;
+}
+
+void FftOcean::initSpectrum(const unsigned i_seed)
+{
+  std::mt19937 random(i_seed);
+  std::normal_distribution<float> gaussian;
+
+  const float deltaK = (float)(Sdk::Pi2 / d_settings.tileSize);
+  const double omegaStep = Sdk::Pi2 / LoopPeriod;
+
+  double variance = 0;
+  float maxOmega = 0;
+  for (int z = 0; z < d_size; ++z)
+  {
+    for (int x = 0; x < d_size; ++x)
+    {
+      const int i = x + z * d_size;
+      const float kx = getWaveNumber(x, d_size, d_settings.tileSize);
+      const float kz = getWaveNumber(z, d_size, d_settings.tileSize);
+
+      d_kx[i] = kx;
+      d_kz[i] = kz;
+      // Kept in cycles per loop rather than in radians per second, see LoopPeriod
+      d_omega[i] = (float)std::floor(std::sqrt(Gravity * std::sqrt(kx * kx + kz * kz)) / omegaStep);
+      maxOmega = std::max(maxOmega, d_omega[i]);
+
+      // The Nyquist waves have no opposite ones to pair with, and would make the fields complex
+      const bool isNyquist = x == d_size / 2 || z == d_size / 2;
+      const float energy = isNyquist ? 0 : getSpectrum(kx, kz) * deltaK * deltaK;
+      // The wave and its conjugate add up to a cosine of twice the amplitude, so a half of
+      // the energy is given to each of the two Gaussian components and halved once more
+      const float amplitude = std::sqrt(energy / 4);
+      d_h0Real[i] = gaussian(random) * amplitude;
+      d_h0Imag[i] = gaussian(random) * amplitude;
+      variance += energy;
+    }
+  }
+
+  for (int z = 0; z < d_size; ++z)
+  {
+    for (int x = 0; x < d_size; ++x)
+    {
+      const int i = x + z * d_size;
+      const int minus = (d_size - x) % d_size + (d_size - z) % d_size * d_size;
+      d_h0MinusReal[i] = d_h0Real[minus];
+      d_h0MinusImag[i] = -d_h0Imag[minus];
+    }
+  }
+
+  d_significantWaveHeight = (float)(4 * std::sqrt(variance));
+
+  // Whole cycles take this many bits, the rest of the mantissa is left to the loop fraction
+  int omegaBits = 0;
+  while ((float)(1 << omegaBits) <= maxOmega)
+    ++omegaBits;
+  CONTRACT_ASSERT(omegaBits < FloatBits);
+  d_loopSteps = (double)(1 << (FloatBits - omegaBits));
+}
+
+
+void FftOcean::update(const double i_time, ThreadPool& i_threadPool)
+{
+  const int tasksCount = (d_size + RowsPerTask - 1) / RowsPerTask;
+  auto forRows = [&](const auto& i_func) {
+    i_threadPool.parallelFor(0, tasksCount, [&](const int i_task) {
+      i_func(i_task * RowsPerTask, std::min((i_task + 1) * RowsPerTask, d_size));
+      });
+  };
+
+  forRows([&](const int i_begin, const int i_end) { updateSpectrum(i_time, i_begin, i_end); });
+
+  d_fft.inverse(d_heightXReal.data(), d_heightXImag.data(), i_threadPool);
+  d_fft.inverse(d_zSlopeXReal.data(), d_zSlopeXImag.data(), i_threadPool);
+  d_fft.inverse(d_slopeZReal.data(), d_slopeZImag.data(), i_threadPool);
+
+  forRows([&](const int i_begin, const int i_end) { updateMaps(i_begin, i_end); });
+}
+
+void FftOcean::updateSpectrum(const double i_time, const int i_rowsBegin, const int i_rowsEnd)
+{
+  using T = Simd::Native;
+
+  // The phase is omega cycles times the loop fraction. A float product of the two would be
+  // off by up to about 1e-3 radians for the fastest waves, so the fraction is split: its high
+  // part has few enough bits for the product to be exact, and the whole cycles of it are
+  // dropped before the low part's product is added
+  const double loops = i_time / LoopPeriod;
+  const double loopFraction = loops - std::floor(loops);
+  const double loopFractionHigh = std::floor(loopFraction * d_loopSteps) / d_loopSteps;
+  const auto fractionHigh = T::set((float)loopFractionHigh);
+  const auto fractionLow = T::set((float)(loopFraction - loopFractionHigh));
+  const auto pi2 = T::set((float)Sdk::Pi2);
+  const auto choppiness = T::set(d_settings.choppiness);
+
+  const int begin = i_rowsBegin * d_size;
+  const int end = i_rowsEnd * d_size;
+  for (int i = begin; i < end; i += T::Width)
+  {
+    typename T::Float sin;
+    typename T::Float cos;
+    const auto omega = T::load(&d_omega[i]);
+    const auto cyclesHigh = T::mul(omega, fractionHigh);
+    const auto cycles = T::add(T::sub(cyclesHigh, T::toFloat(T::roundToInt(cyclesHigh))), T::mul(omega, fractionLow));
+    Simd::sinCos<T>(T::mul(cycles, pi2), sin, cos);
+
+    // h0 * e^(iwt) + conj(h0(-k)) * e^(-iwt)
+    const auto ar = T::load(&d_h0Real[i]);
+    const auto ai = T::load(&d_h0Imag[i]);
+    const auto br = T::load(&d_h0MinusReal[i]);
+    const auto bi = T::load(&d_h0MinusImag[i]);
+    const auto hr = T::add(T::sub(T::mul(ar, cos), T::mul(ai, sin)), T::add(T::mul(br, cos), T::mul(bi, sin)));
+    const auto hi = T::add(T::add(T::mul(ar, sin), T::mul(ai, cos)), T::sub(T::mul(bi, cos), T::mul(br, sin)));
+
+    const auto kx = T::load(&d_kx[i]);
+    const auto kz = T::load(&d_kz[i]);
+    const auto k = T::sqrt(T::add(T::mul(kx, kx), T::mul(kz, kz)));
+    // k is only 0 for the first element, where h is 0 as well
+    const auto invK = T::div(choppiness, T::max(k, T::set(1e-6f)));
+    const auto chopX = T::mul(kx, invK);
+    const auto chopZ = T::mul(kz, invK);
+
+    // Height + i * x displacement, x displacement is -i * kx / k * h
+    T::store(&d_heightXReal[i], T::add(hr, T::mul(chopX, hr)));
+    T::store(&d_heightXImag[i], T::add(hi, T::mul(chopX, hi)));
+
+    // z displacement + i * x slope, x slope is i * kx * h
+    T::store(&d_zSlopeXReal[i], T::sub(T::mul(chopZ, hi), T::mul(kx, hr)));
+    T::store(&d_zSlopeXImag[i], T::neg(T::add(T::mul(chopZ, hr), T::mul(kx, hi))));
+
+    T::store(&d_slopeZReal[i], T::neg(T::mul(kz, hi)));
+    T::store(&d_slopeZImag[i], T::mul(kz, hr));
+  }
+}
+
+void FftOcean::updateMaps(const int i_rowsBegin, const int i_rowsEnd)
+{
+  for (int i = i_rowsBegin * d_size; i < i_rowsEnd * d_size; ++i)
+  {
+    d_displacementMap[i] = { d_heightXImag[i], d_heightXReal[i], d_zSlopeXReal[i] };
+
+    const float slopeX = d_zSlopeXImag[i];
+    const float slopeZ = d_slopeZReal[i];
+    const float invLength = 1 / std::sqrt(slopeX * slopeX + 1 + slopeZ * slopeZ);
+    d_normalMap[i] = { -slopeX * invLength, invLength, -slopeZ * invLength };
+  }
+}
+
+
+const std::vector<Sdk::Vector3F>& FftOcean::getDisplacementMap() const
+{
+  return d_displacementMap;
+}
+
+const std::vector<Sdk::Vector3F>& FftOcean::getNormalMap() const
+{
+  return d_normalMap;
+}
+
+
+Sdk::Vector3F FftOcean::getDisplacement(const float i_x, const float i_z) const
+{
+  const float cellSize = d_settings.tileSize / d_size;
+  const float u = i_x / cellSize;
+  const float v = i_z / cellSize;
+  const float floorU = std::floor(u);
+  const float floorV = std::floor(v);
+  const float tx = u - floorU;
+  const float tz = v - floorV;
+
+  auto wrap = [&](const float i_value) {
+    const int index = (int)std::fmod(i_value, (float)d_size);
+    return index < 0 ? index + d_size : index;
+  };
+  const int x0 = wrap(floorU);
+  const int z0 = wrap(floorV);
+  const int x1 = (x0 + 1) % d_size;
+  const int z1 = (z0 + 1) % d_size;
+
+  const auto& d00 = d_displacementMap[x0 + z0 * d_size];
+  const auto& d10 = d_displacementMap[x1 + z0 * d_size];
+  const auto& d01 = d_displacementMap[x0 + z1 * d_size];
+  const auto& d11 = d_displacementMap[x1 + z1 * d_size];
+  auto bilinear = [&](const float i_00, const float i_10, const float i_01, const float i_11) {
+    const float value0 = i_00 + (i_10 - i_00) * tx;
+    const float value1 = i_01 + (i_11 - i_01) * tx;
+    return value0 + (value1 - value0) * tz;
+  };
+  return {
+    bilinear(d00.x, d10.x, d01.x, d11.x),
+    bilinear(d00.y, d10.y, d01.y, d11.y),
+    bilinear(d00.z, d10.z, d01.z, d11.z) };
+}
+
+float FftOcean::getHeight(const float i_x, const float i_z) const
+{
+  return getDisplacement(i_x, i_z).y;
+}
+
+
+std::shared_ptr<Dx::Shape3d> FftOcean::createShape() const
+{
+  // One vertex more per side, the last ones repeat the first ones
+  const int size = d_size + 1;
+
+  auto shape = std::make_shared<Dx::Shape3d>();
+  auto& inds = shape->getInds();
+
+  shape->getVerts().resize(size * size);
+  updateShape(*shape);
+
+  inds.reserve(d_size * d_size * 6);
+  for (int z = 0; z < d_size; ++z)
+  {
+    for (int x = 0; x < d_size; ++x)
+    {
+      const int a = x + z * size;
+      const int b = a + 1;
+      const int c = a + size + 1;
+      const int d = a + size;
+      inds.insert(inds.end(), { a, d, c, a, c, b });
+    }
+  }
+
+  return shape;
+}
+
+void FftOcean::updateShape(Dx::Shape3d& io_shape) const
+{
+  const int size = d_size + 1;
+  const float cellSize = d_settings.tileSize / d_size;
+
+  auto& verts = io_shape.getVerts();
+  CONTRACT_EXPECT((int)verts.size() == size * size);
+
+  for (int z = 0; z < size; ++z)
+  {
+    for (int x = 0; x < size; ++x)
+    {
+      const int texel = x % d_size + z % d_size * d_size;
+      const auto& displacement = d_displacementMap[texel];
+
+      auto& vertex = verts[x + z * size];
+      vertex.position = { x * cellSize + displacement.x, displacement.y, z * cellSize + displacement.z };
+      vertex.normal = d_normalMap[texel];
+      vertex.texture = { (float)x / d_size, (float)z / d_size };
+    }
+  }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "Fft2d.h"
+
+#include <LaggyDx/LaggyDxFwd.h>
+#include <LaggySdk/Vector.h>
+
+#include <vector>
+
+
+class ThreadPool;
+
+
+enum class OceanSpectrum
+{
+  Phillips,
+  Jonswap,
+};
+
+struct FftOceanSettings
+{
+  OceanSpectrum spectrum = OceanSpectrum::Jonswap;
+  // Power of two, 128 to 512 are sensible
+  int resolution = 256;
+  float tileSize = 64;
+  float windSpeed = 6;
+  Sdk::Vector2F windDirection = { 1, 0 };
+  // Distance the wind blows over the water, JONSWAP only
+  float fetch = 100000;
+  // Scale of the horizontal displacement, 0 for no choppiness
+  float choppiness = 1;
+};
+
+
+// Tessendorf ocean: a random sea state drawn from a wind wave spectrum, animated by the
+// deep water dispersion and transformed to displacement and normal maps of a periodic tile
+class FftOcean
+{
+public:
+  FftOcean(const FftOceanSettings& i_settings, unsigned i_seed = 0);
+
+  const FftOceanSettings& getSettings() const;
+  // Expected height of the highest third of the waves, from the spectrum
+  float getSignificantWaveHeight() const;
+
+  void update(double i_time, ThreadPool& i_threadPool);
+
+  // Resolution x resolution texels, row-major, covering one tile. Displacement is
+  // { x, height, z } from the texel's rest position
+  const std::vector<Sdk::Vector3F>& getDisplacementMap() const;
+  const std::vector<Sdk::Vector3F>& getNormalMap() const;
+
+  // Bilinear, the tile repeats. i_x and i_z are the rest position on the water plane
+  Sdk::Vector3F getDisplacement(float i_x, float i_z) const;
+  // Bilinear, the tile repeats. Horizontal displacement is not taken into account
+  float getHeight(float i_x, float i_z) const;
+
+  // Mesh of the displaced tile in its local space, from 0 to the tile size
+  std::shared_ptr<Dx::Shape3d> createShape() const;
+  // Rewrites the positions and normals of a shape made by createShape(), the indices stay
+  void updateShape(Dx::Shape3d& io_shape) const;
+
+private:
+  FftOceanSettings d_settings;
+  int d_size = 0;
+  float d_significantWaveHeight = 0;
+
+  // Per wave vector, in the FFT order
+  std::vector<float> d_kx, d_kz, d_omega;
+  // The loop fraction's high part is rounded to 1 / d_loopSteps, so that its product with any
+  // d_omega is exact in floats
+  double d_loopSteps = 1;
+  std::vector<float> d_h0Real, d_h0Imag;
+  // Conjugate of h0 at the opposite wave vector
+  std::vector<float> d_h0MinusReal, d_h0MinusImag;
+
+  // Two real fields are packed in each complex one: height and x, z and x slope, z slope
+  std::vector<float> d_heightXReal, d_heightXImag;
+  std::vector<float> d_zSlopeXReal, d_zSlopeXImag;
+  std::vector<float> d_slopeZReal, d_slopeZImag;
+
+  std::vector<Sdk::Vector3F> d_displacementMap;
+  std::vector<Sdk::Vector3F> d_normalMap;
+
+  Fft2d d_fft;
+
+  void initSpectrum(unsigned i_seed);
+  float getSpectrum(float i_kx, float i_kz) const;
+
+  void updateSpectrum(double i_time, int i_rowsBegin, int i_rowsEnd);
+  void updateMaps(int i_rowsBegin, int i_rowsEnd);
+};
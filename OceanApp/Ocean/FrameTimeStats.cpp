@@ -0,0 +1,117 @@
+#include "stdafx.h"
+#include "FrameTimeStats.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+FrameTimeStats::FrameTimeStats(const double i_hitchMinMs, const double i_hitchFactor)
+  : d_hitchMinMs(i_hitchMinMs)
+  , d_hitchFactor(i_hitchFactor)
+{
+}
+
+
+int FrameTimeStats::getBucket(const double i_ms)
+{
+  const auto us = (std::uint32_t)std::clamp(i_ms * 1000, 0.0, (double)((1u << MaxBits) - 1));
+  if (us < SubBucketsCount)
+    return (int)us;
+
+  // Top SubBucketBits bits after the leading one pick the sub-bucket
+  int msb = 0;
+  while ((us >> (msb + 1)) != 0)
+    ++msb;
+  const int shift = msb - SubBucketBits;
+  return SubBucketsCount * (shift + 1) + (int)((us >> shift) & (SubBucketsCount - 1));
+}
+
+double FrameTimeStats::getBucketMs(const int i_bucket)
+{
+  // The middle of the bucket
+  if (i_bucket < SubBucketsCount)
+    return (i_bucket + 0.5) / 1000;
+
+  const int shift = i_bucket / SubBucketsCount - 1;
+  const int subBucket = i_bucket % SubBucketsCount;
+  const double lowUs = (double)((SubBucketsCount + subBucket) << shift);
+  return (lowUs + (1 << shift) * 0.5) / 1000;
+}
+
+
+void FrameTimeStats::addFrame(const double i_ms)
+{
+  // Compared to the median of the frames before it, so a hitch doesn't raise its own bar
+  if (d_framesCount > 0)
+  {
+    const double medianMs = getPercentileMs(50);
+    if (i_ms > d_hitchMinMs && i_ms > d_hitchFactor * medianMs)
+    {
+      d_lastHitch.frame = d_framesCount;
+      d_lastHitch.ms = i_ms;
+      d_lastHitch.medianMs = medianMs;
+      d_lastHitch.scopesCount = 0;
+      if (Profiler::isEnabled())
+      {
+        // endFrame() has summed up the hitch's frame just before
+        const auto& frameStats = Profiler::get().getFrameStats();
+        d_lastHitch.scopesCount = std::min((int)frameStats.size(), HitchScopesCount);
+        std::copy_n(frameStats.begin(), d_lastHitch.scopesCount, d_lastHitch.scopes.begin());
+      }
+      ++d_hitchesCount;
+    }
+  }
+
+  auto& slot = d_window[d_framesCount % WindowSize];
+  if (d_framesCount >= WindowSize)
+    --d_counts[getBucket(slot)];
+  slot = (float)i_ms;
+  ++d_counts[getBucket(slot)];
+  ++d_framesCount;
+}
+
+
+double FrameTimeStats::getPercentileMs(const double i_percentile) const
+{
+  const int count = getWindowFramesCount();
+  if (count == 0)
+    return 0;
+
+  // Rank of the frame, 1-based, as in the nearest-rank method
+  const int rank = std::max((int)std::ceil(i_percentile / 100 * count), 1);
+  int seen = 0;
+  for (int bucket = 0; bucket < BucketsCount; ++bucket)
+  {
+    seen += d_counts[bucket];
+    if (seen >= rank)
+      return getBucketMs(bucket);
+  }
+  return getBucketMs(BucketsCount - 1);
+}
+
+double FrameTimeStats::getMaxMs() const
+{
+  const int count = getWindowFramesCount();
+  return count ? *std::max_element(d_window.begin(), d_window.begin() + count) : 0;
+}
+
+int FrameTimeStats::getWindowFramesCount() const
+{
+  return std::min(d_framesCount, WindowSize);
+}
+
+
+int FrameTimeStats::getFramesCount() const
+{
+  return d_framesCount;
+}
+
+int FrameTimeStats::getHitchesCount() const
+{
+  return d_hitchesCount;
+}
+
+const FrameTimeStats::Hitch* FrameTimeStats::getLastHitch() const
+{
+  return d_hitchesCount > 0 ? &d_lastHitch : nullptr;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "Profiler.h"
+
+#include <array>
+
+
+// Frame times over a sliding window, counted in a log-linear histogram: 16 buckets per power
+// of two microseconds, so a percentile is off by 3% at most. Frames taking much longer than
+// the median are hitches, each one keeps the slowest profiler scopes of its frame. Adding
+// a frame takes neither locks nor allocations
+class FrameTimeStats
+{
+public:
+  static constexpr int WindowSize = 600;
+  static constexpr int HitchScopesCount = 4;
+
+  struct Hitch
+  {
+    // Frames added before it
+    int frame = 0;
+    double ms = 0;
+    double medianMs = 0;
+    // Empty if the profiler was off
+    std::array<Profiler::ScopeStats, HitchScopesCount> scopes;
+    int scopesCount = 0;
+  };
+
+  // A hitch is a frame longer than both i_hitchMinMs and i_hitchFactor medians
+  FrameTimeStats(double i_hitchMinMs = 50, double i_hitchFactor = 2.5);
+
+  void addFrame(double i_ms);
+
+  // Of the frames in the window, i_percentile in [0, 100]
+  double getPercentileMs(double i_percentile) const;
+  double getMaxMs() const;
+  int getWindowFramesCount() const;
+
+  int getFramesCount() const;
+  int getHitchesCount() const;
+  // Null until there is one
+  const Hitch* getLastHitch() const;
+
+private:
+  static constexpr int SubBucketBits = 4;
+  static constexpr int SubBucketsCount = 1 << SubBucketBits;
+  // Up to 2^24 us, about 17 s
+  static constexpr int MaxBits = 24;
+  static constexpr int BucketsCount = SubBucketsCount * (MaxBits - SubBucketBits + 1);
+
+  static int getBucket(double i_ms);
+  static double getBucketMs(int i_bucket);
+
+  double d_hitchMinMs = 0;
+  double d_hitchFactor = 0;
+
+  std::array<int, BucketsCount> d_counts{};
+  std::array<float, WindowSize> d_window{};
+  int d_framesCount = 0;
+
+  Hitch d_lastHitch;
+  int d_hitchesCount = 0;
+};
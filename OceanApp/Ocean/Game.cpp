@@ -1,6 +1,12 @@
 #include "stdafx.h"
 #include "Game.h"
 
+#include "HeightField.h"
+#include "MeshFileCache.h"
+#include "Profiler.h"
+#include "RoamPredicates.h"
+#include "SceneSettings.h"
+
 #include <LaggyDx/Colors.h>
 #include <LaggyDx/FreeCameraController.h>
 #include <LaggyDx/GameSettings.h>
@@ -12,16 +18,48 @@
 #include <LaggyDx/ModelUtils.h>
 #include <LaggyDx/Model.h>
 #include <LaggyDx/Object3.h>
-#include <LaggyDx/Roam.h>
-#include <LaggyDx/Tri.h>
 
 #include <LaggySdk/Math.h>
 
+#include <chrono>
+
 
 namespace
 {
   const Sdk::Vector3F WorldCenter = { 100, 0, 100 };
 
+  // Built meshes are stored here and loaded on the next launches
+  const std::string MeshCacheFolder = "Data/Cache";
+  const std::string TerrainPagesFolder = "Data/Terrain";
+  // Where the resource controller reads it from
+  const std::string HeightMapPath = "Data/Assets/height_map.png";
+  // Bump on any change of how the height map is turned into the terrain heights
+  constexpr int TerrainHeightsVersion = 1;
+  const Sdk::Vector4F TerrainColor = { 0.2f, 0.5f, 0.2f, 1.0f };
+
+  // FFT tiles drawn around the camera, per side
+  constexpr int FftOceanTilesCount = 3;
+  // The tiles' mesh is rewritten every frame, its uploads are batched
+  constexpr double FftOceanUploadPeriod = 1.0 / 30;
+
+  // The boat model is in centimeters and turned, its bounds are taken generously around its origin
+  const BoundingBox BoatLocalBounds = { { -160, -160, -160 }, { 160, 160, 160 } };
+
+  // Fewer objects are not worth a job of their own
+  constexpr int MinObjectsPerRecordJob = 512;
+
+  // The ROAM mesh changes almost every frame while the camera moves, its uploads are batched
+  constexpr double OceanUploadPeriod = 0.1;
+
+  void setOceanMaterial(Dx::IObject3& i_object)
+  {
+    Dx::traverseMaterials(i_object.getModel(), [](auto& i_mat) {
+      i_mat.diffuseColor = { 0.16f, 0.33f, 0.5f, 0.9f };
+      i_mat.specularIntensity = 1;
+      i_mat.specularPower = 16;
+      });
+  }
+
   const Dx::GameSettings& getGameSettings()
   {
     static Dx::GameSettings settings;
@@ -38,105 +76,190 @@ namespace
 } // anonym NS
 
 
-Game::Game()
+Game::Game(const WaveModel i_waveModel, const OceanMeshType i_oceanMeshType)
   : Dx::Game(getGameSettings())
+  , d_waveModel(i_waveModel)
+  , d_oceanMeshType(i_oceanMeshType)
+  , d_threadPool(std::max((int)std::thread::hardware_concurrency(), 1))
+  , d_waterHeightQuery(
+    OceanLodController::getLevelCellsCount(), OceanLodController::getLevelCellSize(WaterHeightQueryLevel))
   , d_actionsController(*this)
   , d_guiController(*this)
 {
-  createSurfaceMesh();
-  createOceanMesh();
-  createTestObjects();
-  createSkydomeMesh();
-  createBoat();
-  createNotebook();
+  d_assetStreamer.measure("Camera", [&]() { createCamera(); });
 
-  createCamera();
+  d_assetStreamer.measure("height_map.png", [&]() { createTerrainPages(); });
+  d_assetStreamer.measure("Ocean mesh", [&]() { createOceanMesh(); });
+  d_assetStreamer.measure("Test objects", [&]() { createTestObjects(); });
+  d_assetStreamer.measure("Skydome mesh", [&]() { createSkydomeMesh(); });
+  d_assetStreamer.measure("row_boat.fbx", [&]() { createBoat(); });
+  d_assetStreamer.measure("Notebook", [&]() { createNotebook(); });
+  d_assetStreamer.measure("Objects BVH", [&]() { createObjectsBvh(); });
 
-  createOceanShader();
-  createSimpleShader();
-  createSkydomeShader();
+  d_assetStreamer.measure("Ocean shader", [&]() { createOceanShader(); });
+  d_assetStreamer.measure("Simple shader", [&]() { createSimpleShader(); });
+  d_assetStreamer.measure("Skydome shader", [&]() { createSkydomeShader(); });
 
   d_actionsController.createActions();
 
-  d_guiController.createInGameGui();
+  d_assetStreamer.measure("GUI textures, play.spritefont", [&]() { d_guiController.createInGameGui(); });
   getInputDevice().showCursor();
+
+  if (d_waveModel == WaveModel::Fft)
+  {
+    // The FFT tiles carry the whole sea state, the shader's own waves are flattened. The
+    // physics and the water queries read the FFT ocean, the Gerstner waves are flattened too
+    for (int i = 0; i < GerstnerWaves::WavesCount; ++i)
+    {
+      getOceanShader().setWavesSteepness(i, 0);
+      d_waves.setWavesSteepness(i, 0);
+    }
+  }
 }
 
 
-void Game::createSurfaceMesh()
+void Game::createTerrainPages()
 {
+  // The pages written by a previous launch are recognized by the file's hash, without decoding it
+  const auto sourceKey = MeshFileCache::getFileKey(HeightMapPath, TerrainHeightsVersion);
+  if (sourceKey != 0 && TerrainPager::hasPages(TerrainPagesFolder, sourceKey))
+  {
+    createTerrainPager();
+    return;
+  }
+
+  // Only getting the bitmap needs the device. The height map is cut into pages in the
+  // background, the pager is created by updateStreamedAssets() once they're written
   const auto& heightMapTexture = getResourceController().getTexture("height_map.png");
-  auto heightMap = Dx::HeightMap::fromBitmap(*heightMapTexture.getBitmap(getRenderDevice()));
-  heightMap.normalize(-30, 10);
-
-  auto pred = [](const Dx::Tri& i_tri, const double i_heightDiff) {
-    const int depth = i_tri.depth();
-    constexpr int MinDepth = 5;
-    constexpr int MaxDepth = 20;
-    constexpr double Precision = 0.1;
-
-    if (depth < MinDepth)
-      return true;
-    if (depth >= MaxDepth)
-      return false;
-    return i_heightDiff > Precision;
-  };
-
-  const Dx::Roam surf(heightMap, pred);
-  const auto shape = Dx::IShape3d::fromRoam(surf);
-  d_surfaceObject = Dx::createObjectFromShape(*shape, getRenderDevice(), true);
-
-  Dx::traverseMaterials(d_surfaceObject->getModel(), [](auto& i_mat) {
-    i_mat.diffuseColor = { 0.2f, 0.5f, 0.2f, 1.0f };
+  const auto bitmap = heightMapTexture.getBitmap(getRenderDevice());
+
+  d_terrainPagesWritten = d_assetStreamer.request<bool>("Terrain pages", [bitmap, sourceKey]() {
+    auto heightField = HeightField::fromHeightMap(Dx::HeightMap::fromBitmap(*bitmap));
+    heightField.normalize(-30, 10);
+    return TerrainPager::writePages(heightField, sourceKey, TerrainPagesFolder);
     });
 }
 
+void Game::createTerrainPager()
+{
+  TerrainPagerSettings settings;
+  settings.pagesFolder = TerrainPagesFolder;
+  settings.meshesFolder = MeshCacheFolder;
+  d_terrainPager = std::make_unique<TerrainPager>(std::move(settings));
+}
+
 void Game::createOceanMesh()
 {
-  auto pred = [&](const Dx::Tri& i_tri, const std::vector<Dx::VertexPosNormText>& i_points) {
-    const auto center = (
-      i_points.at(i_tri.ind1).position +
-      i_points.at(i_tri.ind2).position +
-      i_points.at(i_tri.ind3).position) / 3;
-    const auto dist = std::max((center - WorldCenter).length(), 1.0f);
+  if (d_waveModel == WaveModel::Fft)
+  {
+    d_fftOcean = std::make_unique<FftOcean>(FftOceanSettings());
+    createFftOceanObjects();
+    updateFftOcean();
+    return;
+  }
 
-    constexpr int MinLevel = 15;
-    constexpr int MaxLevel = 20;
-    constexpr float MaxQualityRadius = 10.0f;
-    constexpr float MinQualityRadius = 80.0f;
+  if (d_oceanMeshType == OceanMeshType::Clipmap)
+    createOceanClipmap();
+  else
+    createOceanRoam();
+}
+
+void Game::createOceanClipmap()
+{
+  d_oceanLodController.createObjects(getRenderDevice());
+  d_oceanLodController.update(d_camera->getPosition());
 
-    const float ratio = Sdk::saturate((dist - MaxQualityRadius) / (MinQualityRadius - MaxQualityRadius));
-    const auto score = MinLevel + (MaxLevel - MinLevel) * (1 - ratio);
+  for (const auto& objPtr : d_oceanLodController.getObjects())
+    setOceanMaterial(*objPtr);
+}
 
-    return i_tri.depth() < score;
-  };
-  const Dx::Roam surf(200, pred);
+void Game::createOceanRoam()
+{
+  constexpr int MaxTrisCount = 100000;
+  constexpr int OperationsBudget = 256;
+  constexpr int RefreshBudget = 4000;
 
-  const auto shape = Dx::IShape3d::fromRoam(surf);
-  d_oceanObject = Dx::createObjectFromShape(*shape, getRenderDevice(), true);
+  d_oceanRoam = std::make_unique<DynamicRoam>(OceanSize, OceanMaxDepth, getOceanPriority());
+  d_oceanRoam->setMaxTrisCount(MaxTrisCount);
+  d_oceanRoam->setOperationsBudget(OperationsBudget);
+  d_oceanRoam->setRefreshBudget(RefreshBudget);
+  d_oceanRoam->reset(d_camera->getPosition());
 
-  Dx::traverseMaterials(d_oceanObject->getModel(), [](auto& i_mat) {
-    i_mat.diffuseColor = { 0.16f, 0.33f, 0.5f, 0.9f };
-    i_mat.specularIntensity = 1;
-    i_mat.specularPower = 16;
-    });
+  createOceanObject();
+}
+
+void Game::createOceanObject()
+{
+  if (d_oceanObject)
+    d_objectBounds.erase(d_oceanObject.get());
+
+  // The persistent buffer as is: the freed slots are degenerate triangles
+  const auto& shape = d_oceanRoam->getShape();
+  d_oceanObject = Dx::createObjectFromShape(shape, getRenderDevice(), true);
+  d_objectBounds[d_oceanObject.get()] = getShapeBounds(shape);
+  setOceanMaterial(*d_oceanObject);
+
+  d_oceanUploadTime = getGlobalTime();
+  d_oceanChanged = false;
+}
+
+void Game::createFftOceanObjects()
+{
+  // The tiles share the model, its mesh is displaced on the CPU and rewritten every frame.
+  // Bounds are taken once, the displacement rarely reaches the significant wave height
+  d_fftOceanShape = d_fftOcean->createShape();
+
+  const float tileSize = d_fftOcean->getSettings().tileSize;
+  const float margin = 2 * d_fftOcean->getSignificantWaveHeight();
+  const BoundingBox tileBounds = { { -margin, -margin, -margin }, { tileSize + margin, margin, tileSize + margin } };
+
+  d_fftOceanObjects.resize(FftOceanTilesCount * FftOceanTilesCount);
+  for (auto& object : d_fftOceanObjects)
+  {
+    object = std::make_shared<Dx::Object3>();
+    d_objectBounds[object.get()] = tileBounds;
+  }
+
+  uploadFftOceanShape();
+}
+
+void Game::uploadFftOceanShape()
+{
+  // LaggyDx has no way to write into an existing vertex buffer, so the model is replaced
+  const auto uploaded = Dx::createObjectFromShape(*d_fftOceanShape, getRenderDevice(), true);
+  setOceanMaterial(*uploaded);
+  for (const auto& object : d_fftOceanObjects)
+    object->setModel(uploaded->getModel());
+
+  d_fftOceanUploadTime = getGlobalTime();
 }
 
 void Game::createTestObjects()
 {
-  const auto testShape = Dx::IShape3d::sphere(1.0f, 50, 50);
+  constexpr float Radius = 1.0f;
+  constexpr float Volume = 4.0f / 3.0f * (float)Sdk::Pi * Radius * Radius * Radius;
+  // Half as dense as the water, so they float half-submerged
+  constexpr float Mass = 0.5f * 1025 * Volume;
+
+  const std::shared_ptr<Dx::IShape3d> testShape = Dx::IShape3d::sphere(Radius, 50, 50);
 
+  // Start at different depths and float up
   std::vector<float> Depths{ 0, -2, -5, -10, -20 };
-  for (const float depth : Depths)
+  for (int i = 0; i < (int)Depths.size(); ++i)
   {
-    auto testObject = Dx::createObjectFromShape(*testShape, getRenderDevice(), true);
-    testObject->setPosition({ 102, depth, 96 });
+    const Sdk::Vector3F position{ 102 + 3.0f * i, Depths[i], 96 };
+
+    auto testObject = d_objectsMeshCache.createObject(testShape, getRenderDevice());
+    testObject->setPosition(position);
 
     Dx::traverseMaterials(testObject->getModel(), [](auto& i_mat) {
       i_mat.diffuseColor = { 0.16f, 0.5f, 0.33f, 1.0f };
       i_mat.specularIntensity = 1;
       });
 
+    const int body = d_buoyancySystem.addBody(Mass, Volume, position, { { 0, 0, 0 } }, Radius);
+    d_floatingObjects.push_back({ testObject, body, { 0, 0, 0 } });
+
     d_objects.push_back(std::move(testObject));
   }
 }
@@ -149,7 +272,7 @@ void Game::createSkydomeMesh()
 
 void Game::createBoat()
 {
-  auto boat = std::make_unique<Dx::Object3>();
+  auto boat = std::make_shared<Dx::Object3>();
   boat->setModel(getResourceController().getFbx("row_boat.fbx").getModel());
 
   Dx::traverseMaterials(boat->getModel(), [](auto& i_mat) {
@@ -161,6 +284,21 @@ void Game::createBoat()
   boat->setRotation({ -(float)Sdk::PiHalf, 0, 0 });
   boat->setPosition(WorldCenter);
 
+  // Hull approximated with 2 x 4 samples, about 3 x 1 m
+  constexpr float BoatMass = 150;
+  constexpr float HullVolume = 1.0f;
+  constexpr float HullSampleRadius = 0.25f;
+  std::vector<Sdk::Vector3F> hullSamples;
+  for (const float x : { -0.4f, 0.4f })
+  {
+    for (const float z : { -1.5f, -0.5f, 0.5f, 1.5f })
+      hullSamples.push_back({ x, 0, z });
+  }
+
+  const int body = d_buoyancySystem.addBody(BoatMass, HullVolume, WorldCenter, hullSamples, HullSampleRadius);
+  d_floatingObjects.push_back({ boat, body, boat->getRotation() });
+  d_objectBounds[boat.get()] = BoatLocalBounds;
+
   d_objects.push_back(std::move(boat));
 }
 
@@ -189,6 +327,23 @@ void Game::createCamera()
 }
 
 
+void Game::createObjectsBvh()
+{
+  d_objectProxies.clear();
+  for (int i = 0; i < (int)d_objects.size(); ++i)
+  {
+    const auto& object = *d_objects[i];
+    const auto* bounds = getLocalBounds(object);
+    const auto worldBounds = bounds ?
+      transformBounds(*bounds, object.getPosition(), object.getRotation(), object.getScale()) :
+      BoundingBox{ object.getPosition(), object.getPosition() };
+    d_objectProxies.push_back(d_objectsBvh.insert(worldBounds, i));
+  }
+  d_objectsBvh.rebuild();
+  d_objectsBvhReinsertsCount = 0;
+}
+
+
 const Dx::ICamera& Game::getCamera() const
 {
   CONTRACT_EXPECT(d_camera);
@@ -220,6 +375,76 @@ Dx::ISkydomeShader& Game::getSkydomeShader() const
 }
 
 
+GerstnerWaves& Game::getWaves()
+{
+  return d_waves;
+}
+
+const GerstnerWaves& Game::getWaves() const
+{
+  return d_waves;
+}
+
+const BuoyancySystem& Game::getBuoyancySystem() const
+{
+  return d_buoyancySystem;
+}
+
+WaterHeightQuery& Game::getWaterHeightQuery()
+{
+  return d_waterHeightQuery;
+}
+
+
+WaveModel Game::getWaveModel() const
+{
+  return d_waveModel;
+}
+
+OceanMeshType Game::getOceanMeshType() const
+{
+  return d_oceanMeshType;
+}
+
+void Game::setOceanMeshType(const OceanMeshType i_oceanMeshType)
+{
+  if (d_waveModel == WaveModel::Fft || i_oceanMeshType == d_oceanMeshType)
+    return;
+
+  d_oceanMeshType = i_oceanMeshType;
+  if (d_oceanMeshType == OceanMeshType::Clipmap)
+  {
+    if (d_oceanLodController.getObjects().empty())
+      createOceanClipmap();
+    else
+      d_oceanLodController.update(d_camera->getPosition());
+  }
+  else if (!d_oceanRoam)
+    createOceanRoam();
+  else
+  {
+    // The camera may have flown far since, catch up at once rather than over the budgeted frames
+    d_oceanRoam->reset(d_camera->getPosition());
+    createOceanObject();
+  }
+}
+
+const DynamicRoam* Game::getOceanRoam() const
+{
+  return d_oceanRoam.get();
+}
+
+const FftOcean* Game::getFftOcean() const
+{
+  return d_fftOcean.get();
+}
+
+double Game::getFftOceanUpdateMs() const
+{
+  return d_fftOceanUpdateMs;
+}
+
+
 bool Game::hasInputControllerAttached() const
 {
   return d_inputController.get();
@@ -247,6 +472,57 @@ Dx::IObject3* Game::getNotebook() const
 }
 
 
+ThreadPool& Game::getThreadPool()
+{
+  return d_threadPool;
+}
+
+const AssetStreamer& Game::getAssetStreamer() const
+{
+  return d_assetStreamer;
+}
+
+const TerrainPager* Game::getTerrainPager() const
+{
+  return d_terrainPager.get();
+}
+
+const VisibilityCuller& Game::getVisibilityCuller() const
+{
+  return d_visibilityCuller;
+}
+
+const RenderQueue& Game::getRenderQueue() const
+{
+  return d_renderQueue;
+}
+
+const std::vector<double>& Game::getRecordJobsMs() const
+{
+  return d_recordJobsMs;
+}
+
+const FrameTimeStats& Game::getFrameTimeStats() const
+{
+  return d_frameTimeStats;
+}
+
+const Dx::IObject3* Game::getPickedObject() const
+{
+  return d_pickedObject.tag >= 0 ? d_objects[d_pickedObject.tag].get() : nullptr;
+}
+
+float Game::getPickedDistance() const
+{
+  return d_pickedObject.distance;
+}
+
+const OceanLodController& Game::getOceanLodController() const
+{
+  return d_oceanLodController;
+}
+
+
 void Game::createOceanShader()
 {
   d_oceanShader = Dx::IOceanShader::create(getRenderDevice(), *d_camera, getResourceController());
@@ -275,38 +551,449 @@ void Game::createSkydomeShader()
 
 void Game::update(double i_dt)
 {
+  // The previous frame's render is done by now
+  Profiler::get().endFrame();
+  updateFrameTimeStats();
+  PROFILE_SCOPE("Game::update");
+
   Dx::Game::update(i_dt);
   d_guiController.update(i_dt);
 
   getOceanShader().setGlobalTime(getGlobalTime());
+  d_waves.setGlobalTime(getGlobalTime());
   getSkydomeShader().setGlobalTime(getGlobalTime());
 
+  updateStreamedAssets();
   updateSkydomePosition();
   updateNotebookPosition();
+  updateOceanMesh();
+  updateWaterHeightQuery();
+  updateFloatingObjects();
+  updateObjectsBvh();
+  updatePickedObject();
 }
 
 
 void Game::render()
 {
-  getSkydomeShader().draw(*d_skydomeObject);
-  getSimpleShader().draw(*d_surfaceObject);
-
-  for (const auto& objPtr : d_objects)
-    getSimpleShader().draw(*objPtr);
-  
-  getOceanShader().draw(*d_oceanObject);
+  PROFILE_SCOPE("Game::render");
 
-  getSimpleShader().draw(*d_notebook);
+  cullObjects();
+  recordDraws();
+  submitDraws();
 
+  // GUI and present
+  PROFILE_SCOPE("Dx::Game::render");
   Dx::Game::render();
 }
 
 
+void Game::cullObjects()
+{
+  PROFILE_SCOPE("Game::cullObjects");
+
+  const auto& settings = getGameSettings();
+  const float aspect = (float)settings.screenWidth / settings.screenHeight;
+  const auto& cameraPosition = d_camera->getPosition();
+  d_visibilityCuller.begin(
+    createViewProjection(cameraPosition, d_camera->getLookAt(), CameraFovY, aspect, CameraNear, CameraFar),
+    cameraPosition);
+
+  // Terrain is solid below its pages' lowest points, so the pages hide whatever is behind them
+  d_terrainCullIds.clear();
+  for (const auto& [key, objPtr] : d_terrainObjects)
+  {
+    d_terrainCullIds.push_back(addToCuller(*objPtr));
+    if (const auto* bounds = getLocalBounds(*objPtr))
+      d_visibilityCuller.addOccluder(transformBounds(*bounds, objPtr->getPosition(), {}, { 1, 1, 1 }));
+  }
+
+  d_objectCullIds.resize(d_objects.size());
+  for (int i = 0; i < (int)d_objects.size(); ++i)
+    d_objectCullIds[i] = addToCuller(*d_objects[i]);
+
+  // Gerstner waves are applied in the shader, the FFT tiles are displaced already
+  const float waveMargin = d_waveModel == WaveModel::Fft ? 0.0f : d_waves.getMaxDisplacement();
+  d_oceanCullIds.clear();
+  for (const auto* objPtr : getOceanObjects())
+    d_oceanCullIds.push_back(addToCuller(*objPtr, { waveMargin, waveMargin, waveMargin }));
+
+  d_visibilityCuller.cull();
+}
+
+int Game::addToCuller(const Dx::IObject3& i_object, const Sdk::Vector3F& i_margins)
+{
+  const auto* bounds = getLocalBounds(i_object);
+  if (!bounds)
+    return -1;
+
+  const auto worldBounds = transformBounds(*bounds, i_object.getPosition(), i_object.getRotation(), i_object.getScale());
+  return d_visibilityCuller.add(worldBounds.getInflated(i_margins));
+}
+
+bool Game::isVisible(const int i_cullId) const
+{
+  return i_cullId < 0 || d_visibilityCuller.isVisible(i_cullId);
+}
+
+const BoundingBox* Game::getLocalBounds(const Dx::IObject3& i_object) const
+{
+  if (const auto it = d_objectBounds.find(&i_object); it != d_objectBounds.end())
+    return &it->second;
+  if (const auto* bounds = d_objectsMeshCache.getLocalBounds(i_object))
+    return bounds;
+  return d_oceanLodController.getMeshCache().getLocalBounds(i_object);
+}
+
+std::vector<const Dx::IObject3*> Game::getOceanObjects() const
+{
+  std::vector<const Dx::IObject3*> objects;
+  if (d_waveModel == WaveModel::Fft)
+  {
+    for (const auto& objPtr : d_fftOceanObjects)
+      objects.push_back(objPtr.get());
+  }
+  else if (d_oceanMeshType == OceanMeshType::Clipmap)
+  {
+    for (const auto& objPtr : d_oceanLodController.getObjects())
+      objects.push_back(objPtr.get());
+  }
+  else
+    objects.push_back(d_oceanObject.get());
+  return objects;
+}
+
+
+void Game::recordDraws()
+{
+  PROFILE_SCOPE("Game::recordDraws");
+
+  d_renderQueue.clear();
+  d_renderItems.clear();
+  d_materialIds.clear();
+
+  // The objects are the bulk of the draws, so they are recorded in parallel, a range per job.
+  // Jobs are merged in their order, so the queue doesn't depend on the scheduling
+  const int objectsCount = (int)d_objects.size();
+  const int jobsCount = std::clamp(
+    (objectsCount + MinObjectsPerRecordJob - 1) / MinObjectsPerRecordJob, 1, d_threadPool.getThreadsCount());
+  if ((int)d_recordJobs.size() < jobsCount)
+    d_recordJobs.resize(jobsCount);
+
+  d_threadPool.parallelFor(0, jobsCount, [&](const int i_job) {
+    const auto start = std::chrono::steady_clock::now();
+    recordObjects(i_job, objectsCount * i_job / jobsCount, objectsCount * (i_job + 1) / jobsCount);
+    const auto end = std::chrono::steady_clock::now();
+    d_recordJobs[i_job].ms = std::chrono::duration<double, std::milli>(end - start).count();
+    });
+
+  // Terrain and ocean objects are visited in the order they were culled in
+  recordDraw(*d_skydomeObject, RenderPass::Sky, RenderShader::Skydome);
+  int terrainIndex = 0;
+  for (const auto& [key, objPtr] : d_terrainObjects)
+    recordDraw(*objPtr, RenderPass::Opaque, RenderShader::Simple, d_terrainCullIds[terrainIndex++]);
+  const auto oceanObjects = getOceanObjects();
+  for (int i = 0; i < (int)oceanObjects.size(); ++i)
+    recordDraw(*oceanObjects[i], RenderPass::Water, RenderShader::Ocean, d_oceanCullIds[i]);
+  recordDraw(*d_notebook, RenderPass::Overlay, RenderShader::Simple);
+
+  d_recordJobsMs.clear();
+  for (int jobIndex = 0; jobIndex < jobsCount; ++jobIndex)
+  {
+    const auto& job = d_recordJobs[jobIndex];
+    d_renderQueue.append(job.renderQueue, (int)d_renderItems.size());
+    d_renderItems.insert(d_renderItems.end(), job.renderItems.begin(), job.renderItems.end());
+    d_recordJobsMs.push_back(job.ms);
+  }
+
+  d_renderQueue.sort();
+}
+
+void Game::recordDraw(const Dx::IObject3& i_object, const RenderPass i_pass, const RenderShader i_shader, const int i_cullId)
+{
+  if (!isVisible(i_cullId))
+    return;
+
+  d_renderQueue.add(i_pass, i_shader, getMaterialId(i_object), getDepth(i_object), (int)d_renderItems.size());
+  d_renderItems.push_back({ &i_object });
+}
+
+void Game::recordObjects(const int i_job, const int i_begin, const int i_end)
+{
+  // Runs on the pool: only reads the shared state and writes to its own job
+  PROFILE_SCOPE("Game::recordObjects");
+  auto& job = d_recordJobs[i_job];
+  job.renderQueue.clear();
+  job.renderItems.clear();
+
+  job.instanceBatcher.clear();
+  for (int i = i_begin; i < i_end; ++i)
+  {
+    if (isVisible(d_objectCullIds[i]))
+      job.instanceBatcher.add(getObjectModelId(i), i);
+  }
+  job.instanceBatcher.build();
+
+  // A batch is a single command, sorted by its nearest instance. Batches of the same model
+  // from different jobs have the same key, so they are still drawn one after another
+  const auto& batches = job.instanceBatcher.getBatches();
+  const auto& tags = job.instanceBatcher.getTags();
+  for (int batchIndex = 0; batchIndex < (int)batches.size(); ++batchIndex)
+  {
+    const auto& batch = batches[batchIndex];
+
+    float depth = std::numeric_limits<float>::max();
+    for (int i = batch.firstInstance; i < batch.firstInstance + batch.instancesCount; ++i)
+      depth = std::min(depth, getDepth(*d_objects[tags[i]]));
+
+    job.renderQueue.add(RenderPass::Opaque, RenderShader::Simple, batch.modelId, depth, (int)job.renderItems.size());
+    job.renderItems.push_back({ nullptr, i_job, batchIndex });
+  }
+}
+
+void Game::submitDraws()
+{
+  PROFILE_SCOPE("Game::submitDraws");
+
+  // Shaders bind their state on every draw, so the queue can't skip the binds, but
+  // the draws sharing a shader and a material go one after another
+  for (const auto& command : d_renderQueue.getCommands())
+  {
+    const auto& item = d_renderItems[command.payload];
+    if (item.batch >= 0)
+    {
+      // ISimpleShader can't draw instances yet, so the batches are still drawn object by object
+      const auto& instanceBatcher = d_recordJobs[item.job].instanceBatcher;
+      const auto& batch = instanceBatcher.getBatches()[item.batch];
+      const auto& tags = instanceBatcher.getTags();
+      for (int i = batch.firstInstance; i < batch.firstInstance + batch.instancesCount; ++i)
+      {
+        PROFILE_SCOPE("ISimpleShader::draw");
+        getSimpleShader().draw(*d_objects[tags[i]]);
+      }
+      continue;
+    }
+
+    switch (RenderQueue::getShader(command.key))
+    {
+    case RenderShader::Skydome:
+    {
+      PROFILE_SCOPE("ISkydomeShader::draw");
+      getSkydomeShader().draw(*item.object);
+      break;
+    }
+    case RenderShader::Simple:
+    {
+      PROFILE_SCOPE("ISimpleShader::draw");
+      getSimpleShader().draw(*item.object);
+      break;
+    }
+    case RenderShader::Ocean:
+    {
+      PROFILE_SCOPE("IOceanShader::draw");
+      getOceanShader().draw(*item.object);
+      break;
+    }
+    }
+  }
+}
+
+int Game::getObjectModelId(const int i_objectIndex) const
+{
+  // Objects not created by the cache have models of their own. Materials belong to the
+  // models, so the model is enough to tell the groups apart
+  const int meshId = d_objectsMeshCache.getMeshId(*d_objects[i_objectIndex]);
+  return meshId >= 0 ? meshId : d_objectsMeshCache.getUploadsCount() + i_objectIndex;
+}
+
+int Game::getMaterialId(const Dx::IObject3& i_object)
+{
+  // Ids of the rest of the models go after the ones of d_objects, in the order they are met
+  const int firstId = d_objectsMeshCache.getUploadsCount() + (int)d_objects.size();
+  const auto [it, inserted] = d_materialIds.try_emplace(i_object.getModel().get(), firstId + (int)d_materialIds.size());
+  return it->second;
+}
+
+float Game::getDepth(const Dx::IObject3& i_object) const
+{
+  return (i_object.getPosition() - d_camera->getPosition()).length();
+}
+
+
+void Game::updateFrameTimeStats()
+{
+  // From update to update, i.e. the whole previous frame, present included
+  const auto now = std::chrono::steady_clock::now();
+  if (d_lastUpdateTime != std::chrono::steady_clock::time_point())
+    d_frameTimeStats.addFrame(std::chrono::duration<double, std::milli>(now - d_lastUpdateTime).count());
+  d_lastUpdateTime = now;
+}
+
+void Game::updateStreamedAssets()
+{
+  if (d_terrainPagesWritten.valid() &&
+    d_terrainPagesWritten.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+  {
+    createTerrainPager();
+    d_terrainPagesWritten = {};
+  }
+
+  updateTerrainPages();
+}
+
+void Game::updateTerrainPages()
+{
+  PROFILE_SCOPE("Game::updateTerrainPages");
+
+  if (!d_terrainPager)
+    return;
+
+  d_terrainPager->update(d_camera->getPosition());
+
+  for (const auto& page : d_terrainPager->takeEvictedPages())
+  {
+    const auto it = d_terrainObjects.find(TerrainPager::getPageKey(page.x, page.z));
+    if (it == d_terrainObjects.end())
+      continue;
+    d_objectBounds.erase(it->second.get());
+    d_terrainObjects.erase(it);
+  }
+
+  for (const auto& page : d_terrainPager->takeLoadedPages())
+  {
+    auto object = Dx::createObjectFromShape(*page.shape, getRenderDevice(), true);
+    object->setPosition({ (float)page.x * TerrainPager::PageSize, 0, (float)page.z * TerrainPager::PageSize });
+    Dx::traverseMaterials(object->getModel(), [](auto& i_mat) {
+      i_mat.diffuseColor = TerrainColor;
+      });
+
+    d_objectBounds[object.get()] = getShapeBounds(*page.shape);
+    auto& terrainObject = d_terrainObjects[TerrainPager::getPageKey(page.x, page.z)];
+    if (terrainObject)
+      d_objectBounds.erase(terrainObject.get());
+    terrainObject = std::move(object);
+  }
+}
+
+
 void Game::updateSkydomePosition() const
 {
   d_skydomeObject->setPosition(d_camera->getPosition());
 }
 
+void Game::updateOceanMesh()
+{
+  PROFILE_SCOPE("Game::updateOceanMesh");
+
+  if (d_waveModel == WaveModel::Fft)
+    updateFftOcean();
+  else if (d_oceanMeshType == OceanMeshType::Clipmap)
+    d_oceanLodController.update(d_camera->getPosition());
+  else
+  {
+    if (d_oceanRoam->update(d_camera->getPosition()))
+      d_oceanChanged = true;
+    if (d_oceanChanged && getGlobalTime() - d_oceanUploadTime >= OceanUploadPeriod)
+      createOceanObject();
+  }
+}
+
+void Game::updateFftOcean()
+{
+  const auto start = std::chrono::steady_clock::now();
+  d_fftOcean->update(getGlobalTime(), d_threadPool);
+  const auto end = std::chrono::steady_clock::now();
+  d_fftOceanUpdateMs = std::chrono::duration<double, std::milli>(end - start).count();
+
+  d_fftOcean->updateShape(*d_fftOceanShape);
+  if (getGlobalTime() - d_fftOceanUploadTime >= FftOceanUploadPeriod)
+    uploadFftOceanShape();
+
+  const float tileSize = d_fftOcean->getSettings().tileSize;
+  const auto& cameraPosition = d_camera->getPosition();
+  const float firstX = (std::floor(cameraPosition.x / tileSize) - FftOceanTilesCount / 2) * tileSize;
+  const float firstZ = (std::floor(cameraPosition.z / tileSize) - FftOceanTilesCount / 2) * tileSize;
+
+  for (int z = 0; z < FftOceanTilesCount; ++z)
+  {
+    for (int x = 0; x < FftOceanTilesCount; ++x)
+      d_fftOceanObjects[x + z * FftOceanTilesCount]->setPosition({ firstX + x * tileSize, 0, firstZ + z * tileSize });
+  }
+}
+
+void Game::updateWaterHeightQuery()
+{
+  // After the ocean mesh, the FFT ocean has to be at the current time
+  if (d_waveModel == WaveModel::Fft)
+    d_waterHeightQuery.update(*d_fftOcean, d_camera->getPosition());
+  else
+    d_waterHeightQuery.update(d_waves, d_camera->getPosition());
+}
+
+void Game::updateFloatingObjects()
+{
+  PROFILE_SCOPE("Game::updateFloatingObjects");
+
+  if (d_waveModel == WaveModel::Fft)
+    d_buoyancySystem.update(*d_fftOcean, getGlobalTime());
+  else
+    d_buoyancySystem.update(d_waves);
+
+  for (const auto& floatingObject : d_floatingObjects)
+  {
+    const auto rotation = d_buoyancySystem.getRotation(floatingObject.body);
+    floatingObject.object->setPosition(d_buoyancySystem.getPosition(floatingObject.body));
+
+    // Roll is left out: it comes before the base rotation, so it would turn around
+    // the wrong axis for the models that need one
+    floatingObject.object->setRotation({
+      floatingObject.baseRotation.x + rotation.x,
+      floatingObject.baseRotation.y + rotation.y,
+      floatingObject.baseRotation.z });
+  }
+}
+
+void Game::updateObjectsBvh()
+{
+  // Objects are moved by the buoyancy only, so they are refitted after it. Most of them stay
+  // within their grown boxes and the tree doesn't change
+  for (int i = 0; i < (int)d_objectProxies.size(); ++i)
+  {
+    const auto& object = *d_objects[i];
+    if (const auto* bounds = getLocalBounds(object))
+    {
+      if (d_objectsBvh.update(d_objectProxies[i], transformBounds(*bounds, object.getPosition(), object.getRotation(), object.getScale())))
+        ++d_objectsBvhReinsertsCount;
+    }
+  }
+
+  if (d_objectsBvhReinsertsCount >= ObjectsBvhRebuildFraction * d_objectProxies.size())
+  {
+    d_objectsBvh.rebuild();
+    d_objectsBvhReinsertsCount = 0;
+  }
+}
+
+void Game::updatePickedObject()
+{
+  // Ray through the cursor, from the camera's basis and field of view
+  const auto& settings = getGameSettings();
+  const auto cursor = getInputDevice().getMousePosition();
+  const float x = (2.0f * cursor.x / settings.screenWidth - 1) * std::tan(CameraFovY / 2) * settings.screenWidth / settings.screenHeight;
+  const float y = (1 - 2.0f * cursor.y / settings.screenHeight) * std::tan(CameraFovY / 2);
+
+  const auto& eye = d_camera->getPosition();
+  const auto forward = (d_camera->getLookAt() - eye).getNormalized();
+  const Sdk::Vector3F right = Sdk::Vector3F{ forward.z, 0, -forward.x }.getNormalized();
+  const Sdk::Vector3F up = {
+    forward.y * right.z - forward.z * right.y,
+    forward.z * right.x - forward.x * right.z,
+    forward.x * right.y - forward.y * right.x };
+  const auto direction = (forward + right * x + up * y).getNormalized();
+
+  d_pickedObject = d_objectsBvh.raycast(eye, direction, PickingDistance);
+}
+
 void Game::updateNotebookPosition() const
 {
   const auto pos = d_camera->getPosition() +
@@ -1,8 +1,22 @@
 #pragma once
 
 #include "ActionsController.h"
+#include "AssetStreamer.h"
+#include "BuoyancySystem.h"
+#include "DynamicRoam.h"
+#include "FftOcean.h"
+#include "FrameTimeStats.h"
+#include "GerstnerWaves.h"
 #include "GuiController.h"
+#include "InstanceBatcher.h"
+#include "MeshCache.h"
+#include "ObjectBvh.h"
 #include "OceanLodController.h"
+#include "RenderQueue.h"
+#include "TerrainPager.h"
+#include "ThreadPool.h"
+#include "VisibilityCuller.h"
+#include "WaterHeightQuery.h"
 
 #include <LaggyDx/Game.h>
 #include <LaggyDx/ICamera.h>
@@ -14,10 +28,24 @@
 #include <LaggyDx/ISkydomeShader.h>
 
 
+enum class WaveModel
+{
+  Gerstner,
+  Fft,
+};
+
+// The Gerstner ocean's mesh, the FFT one always uses its tiles
+enum class OceanMeshType
+{
+  Roam,
+  Clipmap,
+};
+
+
 class Game : public Dx::Game
 {
 public:
-  Game();
+  Game(WaveModel i_waveModel = WaveModel::Gerstner, OceanMeshType i_oceanMeshType = OceanMeshType::Clipmap);
 
   virtual void update(double i_dt) override;
   virtual void render() override;
@@ -29,33 +57,144 @@ public:
   Dx::ISimpleShader& getSimpleShader() const;
   Dx::ISkydomeShader& getSkydomeShader() const;
 
+  // Same waves as the ocean shader renders
+  GerstnerWaves& getWaves();
+  const GerstnerWaves& getWaves() const;
+  const BuoyancySystem& getBuoyancySystem() const;
+  WaterHeightQuery& getWaterHeightQuery();
+
+  WaveModel getWaveModel() const;
+  OceanMeshType getOceanMeshType() const;
+  // Creates the mesh on its first use, ignored under the FFT wave model
+  void setOceanMeshType(OceanMeshType i_oceanMeshType);
+  // Null until the ROAM ocean mesh is used
+  const DynamicRoam* getOceanRoam() const;
+  // Null unless the FFT wave model is used
+  const FftOcean* getFftOcean() const;
+  double getFftOceanUpdateMs() const;
+
   bool hasInputControllerAttached() const;
   void createInputController();
   void removeInputController();
 
   Dx::IObject3* getNotebook() const;
 
+  ThreadPool& getThreadPool();
+  const AssetStreamer& getAssetStreamer() const;
+  // Null until the terrain pages are written
+  const TerrainPager* getTerrainPager() const;
+  const OceanLodController& getOceanLodController() const;
+  const VisibilityCuller& getVisibilityCuller() const;
+  const RenderQueue& getRenderQueue() const;
+  const FrameTimeStats& getFrameTimeStats() const;
+  // Times of the parallel jobs that recorded the last frame's objects
+  const std::vector<double>& getRecordJobsMs() const;
+  // The object of d_objects under the mouse cursor, null if none
+  const Dx::IObject3* getPickedObject() const;
+  float getPickedDistance() const;
+
 private:
+  WaveModel d_waveModel;
+  OceanMeshType d_oceanMeshType;
+  ThreadPool d_threadPool;
+  // The loads run on threads of their own, not on the pool, and take what they use by value.
+  // Their futures block on destruction, so a pending load is waited for when the game ends
+  AssetStreamer d_assetStreamer;
+  std::shared_future<bool> d_terrainPagesWritten;
+
   std::unique_ptr<Dx::ICamera> d_camera;
 
   std::unique_ptr<Dx::IOceanShader> d_oceanShader;
   std::unique_ptr<Dx::ISimpleShader> d_simpleShader;
   std::unique_ptr<Dx::ISkydomeShader> d_skydomeShader;
+  GerstnerWaves d_waves;
+  WaterHeightQuery d_waterHeightQuery;
 
   std::unique_ptr<Dx::IObject3> d_skydomeObject;
-  std::unique_ptr<Dx::IObject3> d_surfaceObject;
+  std::unique_ptr<TerrainPager> d_terrainPager;
+  std::unordered_map<std::int64_t, std::unique_ptr<Dx::IObject3>> d_terrainObjects;
   std::unique_ptr<Dx::IObject3> d_oceanObject;
   std::unique_ptr<Dx::IObject3> d_notebook;
 
   std::vector<std::shared_ptr<Dx::IObject3>> d_objects;
+  MeshCache d_objectsMeshCache;
+  // Tags are the indices in d_objects, proxies are in the same order
+  ObjectBvh d_objectsBvh;
+  std::vector<int> d_objectProxies;
+  // Since the last rebuild
+  int d_objectsBvhReinsertsCount = 0;
+  RayHit d_pickedObject;
+
+  struct FloatingObject
+  {
+    std::shared_ptr<Dx::IObject3> object;
+    int body = 0;
+    Sdk::Vector3F baseRotation;
+  };
+  BuoyancySystem d_buoyancySystem;
+  std::vector<FloatingObject> d_floatingObjects;
+
+  std::unique_ptr<DynamicRoam> d_oceanRoam;
+  // Changed since the last upload of its buffer
+  bool d_oceanChanged = false;
+  double d_oceanUploadTime = 0;
+  OceanLodController d_oceanLodController;
+
+  std::unique_ptr<FftOcean> d_fftOcean;
+  std::shared_ptr<Dx::Shape3d> d_fftOceanShape;
+  // Tiles around the camera, all sharing the model uploaded from d_fftOceanShape
+  std::vector<std::shared_ptr<Dx::IObject3>> d_fftOceanObjects;
+  double d_fftOceanUploadTime = 0;
+  double d_fftOceanUpdateMs = 0;
 
   std::unique_ptr<Dx::IInputController> d_inputController;
 
   ActionsController d_actionsController;
   GuiController d_guiController;
 
-  void createSurfaceMesh();
+  // Local bounds of the objects not created by a mesh cache
+  std::unordered_map<const Dx::IObject3*, BoundingBox> d_objectBounds;
+  VisibilityCuller d_visibilityCuller;
+  // Culler ids of this frame's objects, -1 for the ones without bounds, which are not culled.
+  // Per index in d_objects, in the order of d_terrainObjects and of getOceanObjects()
+  std::vector<int> d_objectCullIds;
+  std::vector<int> d_terrainCullIds;
+  std::vector<int> d_oceanCullIds;
+
+  RenderQueue d_renderQueue;
+  // Command payloads are the indices here
+  struct RenderItem
+  {
+    const Dx::IObject3* object = nullptr;
+    // Or a batch of d_objects, recorded by that job
+    int job = -1;
+    int batch = -1;
+  };
+  std::vector<RenderItem> d_renderItems;
+  std::unordered_map<const Dx::IModel*, int> d_materialIds;
+
+  // Kept between the frames, so that their buffers are reused
+  struct RecordJob
+  {
+    InstanceBatcher instanceBatcher;
+    RenderQueue renderQueue;
+    std::vector<RenderItem> renderItems;
+    double ms = 0;
+  };
+  std::vector<RecordJob> d_recordJobs;
+  std::vector<double> d_recordJobsMs;
+
+  FrameTimeStats d_frameTimeStats;
+  std::chrono::steady_clock::time_point d_lastUpdateTime;
+
+  void createTerrainPages();
+  void createTerrainPager();
   void createOceanMesh();
+  void createOceanClipmap();
+  void createOceanRoam();
+  void createOceanObject();
+  void createFftOceanObjects();
+  void uploadFftOceanShape();
   void createTestObjects();
   void createSkydomeMesh();
   void createBoat();
@@ -66,7 +205,32 @@ private:
   void createSkydomeShader();
 
   void createCamera();
+  void createObjectsBvh();
+
+  void cullObjects();
+  // Returns the culler id, -1 if the object has no bounds
+  int addToCuller(const Dx::IObject3& i_object, const Sdk::Vector3F& i_margins = { 0, 0, 0 });
+  bool isVisible(int i_cullId) const;
+  const BoundingBox* getLocalBounds(const Dx::IObject3& i_object) const;
+  std::vector<const Dx::IObject3*> getOceanObjects() const;
+  void recordDraws();
+  void recordDraw(const Dx::IObject3& i_object, RenderPass i_pass, RenderShader i_shader, int i_cullId = -1);
+  void recordObjects(int i_job, int i_begin, int i_end);
+  void submitDraws();
+  int getObjectModelId(int i_objectIndex) const;
+  int getMaterialId(const Dx::IObject3& i_object);
+  float getDepth(const Dx::IObject3& i_object) const;
+
+  void updateFrameTimeStats();
+  void updateStreamedAssets();
+  void updateTerrainPages();
 
   void updateSkydomePosition() const;
+  void updateFloatingObjects();
+  void updateObjectsBvh();
+  void updatePickedObject();
   void updateNotebookPosition() const;
+  void updateOceanMesh();
+  void updateFftOcean();
+  void updateWaterHeightQuery();
 };
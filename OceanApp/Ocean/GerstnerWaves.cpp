@@ -0,0 +1,209 @@
+#include "stdafx.h"
+#include "GerstnerWaves.h"
+
+#include "Simd.h"
+
+#include <LaggySdk/Math.h>
+
+
+namespace
+{
+  constexpr double Gravity = 9.8;
+
+} // anonym NS
+
+
+void GerstnerWaves::setWindDirection(const int i_index, const Sdk::Vector2D& i_direction)
+{
+  const double length = std::sqrt(i_direction.x * i_direction.x + i_direction.y * i_direction.y);
+  CONTRACT_EXPECT(length > 0);
+
+  auto& wave = d_waves.at(i_index);
+  wave.direction = { (float)(i_direction.x / length), (float)(i_direction.y / length) };
+}
+
+void GerstnerWaves::setWavesSteepness(const int i_index, const double i_steepness)
+{
+  auto& wave = d_waves.at(i_index);
+  wave.steepness = (float)i_steepness;
+  updateWave(wave);
+}
+
+void GerstnerWaves::setWavesLength(const int i_index, const double i_length)
+{
+  auto& wave = d_waves.at(i_index);
+  wave.length = (float)i_length;
+  updateWave(wave);
+}
+
+void GerstnerWaves::setGlobalTime(const double i_time)
+{
+  d_time = i_time;
+  for (auto& wave : d_waves)
+    updateWave(wave);
+}
+
+
+double GerstnerWaves::getGlobalTime() const
+{
+  return d_time;
+}
+
+float GerstnerWaves::getMaxDisplacement() const
+{
+  float displacement = 0;
+  for (const auto& wave : d_waves)
+    displacement += std::abs(wave.amplitude);
+  return displacement;
+}
+
+
+void GerstnerWaves::updateWave(Wave& io_wave) const
+{
+  // Zero length waves are switched off
+  if (io_wave.length <= 0)
+  {
+    io_wave.waveNumber = 0;
+    io_wave.amplitude = 0;
+    io_wave.phaseShift = 0;
+    return;
+  }
+
+  const double waveNumber = Sdk::Pi2 / io_wave.length;
+  const double speed = std::sqrt(Gravity / waveNumber);
+
+  io_wave.waveNumber = (float)waveNumber;
+  io_wave.amplitude = (float)(io_wave.steepness / waveNumber);
+  io_wave.phaseShift = (float)std::fmod(waveNumber * speed * d_time, Sdk::Pi2);
+}
+
+
+void GerstnerWaves::evaluate(const float i_x, const float i_z, Sdk::Vector3F& o_position, Sdk::Vector3F& o_normal) const
+{
+  o_position = { i_x, 0, i_z };
+  Sdk::Vector3F tangent{ 1, 0, 0 };
+  Sdk::Vector3F binormal{ 0, 0, 1 };
+
+  for (const auto& wave : d_waves)
+  {
+    if (wave.waveNumber == 0)
+      continue;
+
+    const auto& d = wave.direction;
+    const float phase = wave.waveNumber * (d.x * i_x + d.y * i_z) - wave.phaseShift;
+    const float sin = std::sin(phase);
+    const float cos = std::cos(phase);
+
+    const float a = wave.amplitude;
+    const float s = wave.steepness;
+
+    o_position.x += d.x * a * cos;
+    o_position.y += a * sin;
+    o_position.z += d.y * a * cos;
+
+    tangent.x -= d.x * d.x * s * sin;
+    tangent.y += d.x * s * cos;
+    tangent.z -= d.x * d.y * s * sin;
+
+    binormal.x -= d.x * d.y * s * sin;
+    binormal.y += d.y * s * cos;
+    binormal.z -= d.y * d.y * s * sin;
+  }
+
+  o_normal = {
+    binormal.y * tangent.z - binormal.z * tangent.y,
+    binormal.z * tangent.x - binormal.x * tangent.z,
+    binormal.x * tangent.y - binormal.y * tangent.x };
+  o_normal.normalize();
+}
+
+
+void GerstnerWaves::evaluate(const int i_count, const float* i_x, const float* i_z,
+  float* o_x, float* o_y, float* o_z, float* o_normalX, float* o_normalY, float* o_normalZ) const
+{
+  using T = Simd::Native;
+  const int simdEnd = i_count - i_count % T::Width;
+
+  evaluateSimd<T>(0, simdEnd, i_x, i_z, o_x, o_y, o_z, o_normalX, o_normalY, o_normalZ);
+
+  for (int i = simdEnd; i < i_count; ++i)
+  {
+    Sdk::Vector3F position;
+    Sdk::Vector3F normal;
+    evaluate(i_x[i], i_z[i], position, normal);
+
+    o_x[i] = position.x;
+    o_y[i] = position.y;
+    o_z[i] = position.z;
+    o_normalX[i] = normal.x;
+    o_normalY[i] = normal.y;
+    o_normalZ[i] = normal.z;
+  }
+}
+
+template <typename T>
+void GerstnerWaves::evaluateSimd(const int i_begin, const int i_end, const float* i_x, const float* i_z,
+  float* o_x, float* o_y, float* o_z, float* o_normalX, float* o_normalY, float* o_normalZ) const
+{
+  for (int i = i_begin; i < i_end; i += T::Width)
+  {
+    const auto x = T::load(i_x + i);
+    const auto z = T::load(i_z + i);
+
+    auto px = x;
+    auto py = T::zero();
+    auto pz = z;
+    auto tx = T::set(1);
+    auto ty = T::zero();
+    auto tz = T::zero();
+    auto bx = T::zero();
+    auto by = T::zero();
+    auto bz = T::set(1);
+
+    for (const auto& wave : d_waves)
+    {
+      if (wave.waveNumber == 0)
+        continue;
+
+      const auto& d = wave.direction;
+      const auto kdx = T::set(wave.waveNumber * d.x);
+      const auto kdz = T::set(wave.waveNumber * d.y);
+      const auto phase = T::sub(T::add(T::mul(kdx, x), T::mul(kdz, z)), T::set(wave.phaseShift));
+
+      typename T::Float sin;
+      typename T::Float cos;
+      Simd::sinCos<T>(phase, sin, cos);
+
+      const float a = wave.amplitude;
+      const float s = wave.steepness;
+      const auto aSin = T::mul(T::set(a), sin);
+      const auto aCos = T::mul(T::set(a), cos);
+      const auto sSin = T::mul(T::set(s), sin);
+      const auto sCos = T::mul(T::set(s), cos);
+
+      px = T::add(px, T::mul(T::set(d.x), aCos));
+      py = T::add(py, aSin);
+      pz = T::add(pz, T::mul(T::set(d.y), aCos));
+
+      const auto xzSin = T::mul(T::set(d.x * d.y), sSin);
+      tx = T::sub(tx, T::mul(T::set(d.x * d.x), sSin));
+      ty = T::add(ty, T::mul(T::set(d.x), sCos));
+      tz = T::sub(tz, xzSin);
+      bx = T::sub(bx, xzSin);
+      by = T::add(by, T::mul(T::set(d.y), sCos));
+      bz = T::sub(bz, T::mul(T::set(d.y * d.y), sSin));
+    }
+
+    const auto nx = T::sub(T::mul(by, tz), T::mul(bz, ty));
+    const auto ny = T::sub(T::mul(bz, tx), T::mul(bx, tz));
+    const auto nz = T::sub(T::mul(bx, ty), T::mul(by, tx));
+    const auto invLength = T::div(T::set(1), T::sqrt(T::add(T::add(T::mul(nx, nx), T::mul(ny, ny)), T::mul(nz, nz))));
+
+    T::store(o_x + i, px);
+    T::store(o_y + i, py);
+    T::store(o_z + i, pz);
+    T::store(o_normalX + i, T::mul(nx, invLength));
+    T::store(o_normalY + i, T::mul(ny, invLength));
+    T::store(o_normalZ + i, T::mul(nz, invLength));
+  }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <LaggySdk/Vector.h>
+
+#include <array>
+
+
+// CPU copy of the waves rendered by IOceanShader. Takes the same parameters (and is fed by
+// the same controls) so the physics can query the surface the player sees
+class GerstnerWaves
+{
+public:
+  static constexpr int WavesCount = 3;
+
+  void setWindDirection(int i_index, const Sdk::Vector2D& i_direction);
+  void setWavesSteepness(int i_index, double i_steepness);
+  void setWavesLength(int i_index, double i_length);
+  void setGlobalTime(double i_time);
+
+  double getGlobalTime() const;
+  // Largest displacement from the rest position in any direction, the sum of the amplitudes
+  float getMaxDisplacement() const;
+
+  // Scalar reference. i_x and i_z are the undisplaced position on the water plane
+  void evaluate(float i_x, float i_z, Sdk::Vector3F& o_position, Sdk::Vector3F& o_normal) const;
+
+  // The same for i_count points at once, SIMD. Arrays are structure-of-arrays and can't overlap
+  void evaluate(int i_count, const float* i_x, const float* i_z,
+    float* o_x, float* o_y, float* o_z, float* o_normalX, float* o_normalY, float* o_normalZ) const;
+
+private:
+  struct Wave
+  {
+    Sdk::Vector2F direction = { 1, 0 };
+    float steepness = 0;
+    float length = 0;
+
+    // Derived from the above and the time
+    float waveNumber = 0;
+    float amplitude = 0;
+    // Time part of the phase, wrapped to [0, 2Pi) in doubles so it doesn't lose precision
+    float phaseShift = 0;
+  };
+
+  std::array<Wave, WavesCount> d_waves;
+  double d_time = 0;
+
+  void updateWave(Wave& io_wave) const;
+
+  template <typename T>
+  void evaluateSimd(int i_begin, int i_end, const float* i_x, const float* i_z,
+    float* o_x, float* o_y, float* o_z, float* o_normalX, float* o_normalY, float* o_normalZ) const;
+};
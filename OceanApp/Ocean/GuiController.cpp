@@ -1,7 +1,10 @@
 #include "stdafx.h"
 #include "GuiController.h"
 
+#include "AllocationCounter.h"
 #include "Game.h"
+#include "Profiler.h"
+#include "SceneSettings.h"
 
 #include <LaggyDx/Geometry.h>
 #include <LaggyDx/IResourceController.h>
@@ -13,24 +16,19 @@
 #include <LaggyDx/Slider.h>
 
 #include <LaggySdk/Math.h>
-#include <LaggySdk/StringUtils.h>
 
 
 namespace
 {
   const std::string FontName = "play.spritefont";
-
-  struct Wave
-  {
-    const double direction = 0;
-    const double steepness = 0;
-    const double length = 0;
-  };
-  const std::unordered_map<int, Wave> Waves{
-    { 0, { 20, 0.15, 15 } },
-    { 1, { 0, 0.15, 7 } },
-    { 2, { 40, 0.15, 3 } },
-  };
+  // Slowest startup steps shown in the overlay
+  constexpr int StartupTimingsCount = 3;
+  // Slowest scopes of the last frame
+  constexpr int ProfileScopesCount = 6;
+  constexpr int FrameMsPrecision = 1;
+  // The overlay's values change every frame, it's refreshed at 4 Hz so that they can be read,
+  // and so that the label isn't laid out again every frame
+  constexpr double OverlayRefreshPeriod = 0.25;
 
 
   const Dx::ITexture& getTexture(const std::string& i_name)
@@ -134,13 +132,33 @@ namespace
     return radioGroupPtr;
   }
 
-  std::string toStr(const Sdk::Vector3F& i_pos)
+  void appendVector(TextBuffer& io_text, const Sdk::Vector3F& i_vector)
   {
     constexpr int VectorPrecision = 2;
-    return
-      Sdk::toString(i_pos.x, VectorPrecision) + ", " +
-      Sdk::toString(i_pos.y, VectorPrecision) + ", " +
-      Sdk::toString(i_pos.z, VectorPrecision);
+    io_text.appendFloat(i_vector.x, VectorPrecision);
+    io_text.append(", ");
+    io_text.appendFloat(i_vector.y, VectorPrecision);
+    io_text.append(", ");
+    io_text.appendFloat(i_vector.z, VectorPrecision);
+  }
+
+  void appendHitch(TextBuffer& io_text, const FrameTimeStats::Hitch* i_hitch)
+  {
+    if (!i_hitch)
+      return;
+
+    io_text.append(", last ");
+    io_text.appendFloat(i_hitch->ms, FrameMsPrecision);
+    io_text.append(" ms at frame ");
+    io_text.appendInt(i_hitch->frame);
+    for (int i = 0; i < i_hitch->scopesCount; ++i)
+    {
+      const auto& scope = i_hitch->scopes[i];
+      io_text.append(i == 0 ? ": " : ", ");
+      io_text.append(scope.name);
+      io_text.append(" ");
+      io_text.appendFloat(scope.ms, FrameMsPrecision);
+    }
   }
 }
 
@@ -153,10 +171,227 @@ GuiController::GuiController(Game& i_game)
 
 void GuiController::update(double i_dt)
 {
-  const std::string text = "FPS: " + std::to_string(d_game.getFpsCounter().fps()) + "\n" +
-    "Pos: " + toStr(d_game.getCamera().getPosition()) + "\n" +
-    "Look: " + toStr(d_game.getCamera().getLookAt());
-  d_fpsLabel->setText(text);
+  PROFILE_SCOPE("GuiController::update");
+
+  // Nothing to format for a hidden overlay, it's refreshed as soon as it's shown.
+  // Switched by the label itself, see switchGuiVisibility()
+  if (!d_fpsLabel->getVisible())
+  {
+    d_overlayRefreshTime = OverlayRefreshPeriod;
+    return;
+  }
+
+  d_overlayRefreshTime += i_dt;
+  if (d_overlayRefreshTime < OverlayRefreshPeriod)
+    return;
+  d_overlayRefreshTime = 0;
+  const auto allocationsCount = getThreadAllocationsCount();
+
+  // Formatted in place, into the same buffer every frame
+  auto& text = d_fpsText;
+  text.clear();
+
+  const auto& frameTimeStats = d_game.getFrameTimeStats();
+  text.append("FPS: ");
+  text.appendInt(d_game.getFpsCounter().fps());
+  text.append("\nFrame: p50 ");
+  text.appendFloat(frameTimeStats.getPercentileMs(50), FrameMsPrecision);
+  text.append(", p95 ");
+  text.appendFloat(frameTimeStats.getPercentileMs(95), FrameMsPrecision);
+  text.append(", p99 ");
+  text.appendFloat(frameTimeStats.getPercentileMs(99), FrameMsPrecision);
+  text.append(", max ");
+  text.appendFloat(frameTimeStats.getMaxMs(), FrameMsPrecision);
+  text.append(" ms\nHitches: ");
+  text.appendInt(frameTimeStats.getHitchesCount());
+  appendHitch(text, frameTimeStats.getLastHitch());
+
+  text.append("\nPos: ");
+  appendVector(text, d_game.getCamera().getPosition());
+  text.append("\nLook: ");
+  appendVector(text, d_game.getCamera().getLookAt());
+
+  const auto& meshCache = d_game.getOceanLodController().getMeshCache();
+  text.append("\nOcean meshes: ");
+  text.appendInt(meshCache.getUploadedBytes() / 1024);
+  text.append(" KB, saved ");
+  text.appendInt(meshCache.getSavedBytes() / 1024);
+  text.append(" KB\nOcean ACMR: ");
+  text.appendFloat(meshCache.getVertexCacheStatsBefore().acmr, 3);
+  text.append(" -> ");
+  text.appendFloat(meshCache.getVertexCacheStatsAfter().acmr, 3);
+
+  if (d_game.getWaveModel() == WaveModel::Gerstner && d_game.getOceanMeshType() == OceanMeshType::Roam)
+  {
+    const auto* oceanRoam = d_game.getOceanRoam();
+    text.append("\nOcean ROAM (R for the clipmap): ");
+    text.appendInt(oceanRoam->getTrisCount());
+    text.append(" tris, last update ");
+    text.appendInt(oceanRoam->getLastSplitsCount());
+    text.append(" splits, ");
+    text.appendInt(oceanRoam->getLastMergesCount());
+    text.append(" merges, ");
+    text.appendInt(oceanRoam->getLastRefreshesCount());
+    text.append(" refreshes");
+  }
+
+  text.append("\nBuoyancy step: ");
+  text.appendFloat(d_game.getBuoyancySystem().getLastStepMs(), 3);
+  text.append(" ms");
+
+  const auto& cameraPosition = d_game.getCamera().getPosition();
+  auto& waterHeightQuery = d_game.getWaterHeightQuery();
+  text.append("\nAbove water: ");
+  text.appendFloat(cameraPosition.y - waterHeightQuery.getHeight(cameraPosition.x, cameraPosition.z), 2);
+  // The query's own counters restart with every update, the totals are diffed between the refreshes
+  const auto waterHitsCount = waterHeightQuery.getTotalHitsCount();
+  const auto waterMissesCount = waterHeightQuery.getTotalMissesCount();
+  const auto waterBakesCount = waterHeightQuery.getTotalBakesCount();
+  text.append(" m\nWater queries: ");
+  text.appendInt(waterHitsCount - d_waterHitsCount);
+  text.append(" hits, ");
+  text.appendInt(waterMissesCount - d_waterMissesCount);
+  text.append(" misses, ");
+  text.appendInt(waterBakesCount - d_waterBakesCount);
+  text.append(" bakes per refresh");
+  d_waterHitsCount = waterHitsCount;
+  d_waterMissesCount = waterMissesCount;
+  d_waterBakesCount = waterBakesCount;
+
+  if (const auto* terrainPager = d_game.getTerrainPager())
+  {
+    text.append("\nTerrain pages: ");
+    text.appendInt(terrainPager->getResidentPagesCount());
+    text.append(" resident, ");
+    text.appendInt(terrainPager->getQueuedPagesCount());
+    text.append(" queued, ");
+    text.appendInt(terrainPager->getEvictionsCount());
+    text.append(" evicted, ");
+    text.appendInt(terrainPager->getFailedLoadsCount());
+    text.append(" failed");
+  }
+
+  const auto& culler = d_game.getVisibilityCuller();
+  text.append("\nCulled: ");
+  text.appendInt(culler.getFrustumCulledCount());
+  text.append(" frustum, ");
+  text.appendInt(culler.getHorizonCulledCount());
+  text.append(" horizon of ");
+  text.appendInt(culler.getTestedCount());
+
+  const auto& renderQueue = d_game.getRenderQueue();
+  text.append("\nDraws: ");
+  text.appendInt(renderQueue.getCommands().size());
+  text.append(", state changes ");
+  text.appendInt(renderQueue.getRecordedStateChangesCount());
+  text.append(" -> ");
+  text.appendInt(renderQueue.getStateChangesCount());
+
+  const auto& recordJobsMs = d_game.getRecordJobsMs();
+  double recordTotalMs = 0;
+  double recordSlowestMs = 0;
+  for (const double ms : recordJobsMs)
+  {
+    recordTotalMs += ms;
+    recordSlowestMs = std::max(recordSlowestMs, ms);
+  }
+  text.append("\nRecording: ");
+  text.appendInt(recordJobsMs.size());
+  text.append(" jobs, slowest ");
+  text.appendFloat(recordSlowestMs, 2);
+  text.append(" ms of ");
+  text.appendFloat(recordTotalMs, 2);
+  text.append(" ms");
+
+  if (Profiler::isEnabled())
+  {
+    text.append("\nProfile (P to stop, T to save a trace):");
+    const auto& frameStats = Profiler::get().getFrameStats();
+    for (int i = 0; i < std::min((int)frameStats.size(), ProfileScopesCount); ++i)
+    {
+      text.append("\n  ");
+      text.append(frameStats[i].name);
+      text.append(": ");
+      text.appendFloat(frameStats[i].ms, 2);
+      text.append(" ms");
+      if (frameStats[i].callsCount > 1)
+      {
+        text.append(" x");
+        text.appendInt(frameStats[i].callsCount);
+      }
+    }
+  }
+  else
+    text.append("\nProfile: off (P to start)");
+
+  text.append("\nUnder cursor: ");
+  if (d_game.getPickedObject())
+  {
+    text.append("object at ");
+    text.appendFloat(d_game.getPickedDistance(), 1);
+    text.append(" m");
+  }
+  else
+    text.append("nothing");
+
+  updateStartupText();
+  text.append(d_startupText.getText());
+
+  if (d_game.getWaveModel() == WaveModel::Fft)
+  {
+    text.append("\nFFT ocean: ");
+    text.appendFloat(d_game.getFftOceanUpdateMs(), 2);
+    text.append(" ms");
+  }
+
+#ifdef OCEAN_COUNT_ALLOCATIONS
+  text.append("\nGUI allocations: ");
+  text.appendInt(d_lastRefreshAllocationsCount);
+  text.append(" per refresh");
+#endif
+
+  // Setting the text lays it out again, so it's only set when it has changed
+  if (text.getText() != d_fpsLabelText)
+  {
+    d_fpsLabelText.assign(text.getText());
+    d_fpsLabel->setText(d_fpsLabelText);
+  }
+
+  d_lastRefreshAllocationsCount = getThreadAllocationsCount() - allocationsCount;
+}
+
+void GuiController::updateStartupText()
+{
+  // Timings only change when a step finishes, so that's when the text is rebuilt
+  const auto& assetStreamer = d_game.getAssetStreamer();
+  const int timingsCount = assetStreamer.getTimingsCount();
+  const int pendingCount = assetStreamer.getPendingCount();
+  if (timingsCount == d_startupTimingsCount && pendingCount == d_startupPendingCount)
+    return;
+  d_startupTimingsCount = timingsCount;
+  d_startupPendingCount = pendingCount;
+
+  auto& text = d_startupText;
+  text.clear();
+  text.append("\nStartup: ");
+  text.appendInt((int)assetStreamer.getTotalMs());
+  text.append(" ms");
+  if (pendingCount > 0)
+  {
+    text.append(", ");
+    text.appendInt(pendingCount);
+    text.append(" loading");
+  }
+  for (const auto& timing : assetStreamer.getSlowestTimings(StartupTimingsCount))
+  {
+    text.append("\n  ");
+    text.append(timing.name);
+    text.append(": ");
+    text.appendInt((int)timing.durationMs);
+    text.append(" ms");
+    if (timing.async)
+      text.append(" (async)");
+  }
 }
 
 
@@ -237,8 +472,15 @@ void GuiController::createWavesSettings(Dx::IControl& i_parent)
 {
   d_wavesSettingsLayout = createSettingsLayout(i_parent);
 
+  // The controls set the Gerstner waves, which are flattened under the FFT ocean
+  if (d_game.getWaveModel() == WaveModel::Fft)
+  {
+    auto fftLabel = createSidePanelLabel(*d_wavesSettingsLayout);
+    fftLabel->setText("Set by the FFT ocean spectrum");
+    return;
+  }
 
-  constexpr int WavesCount = 3;
+  constexpr int WavesCount = GerstnerWaves::WavesCount;
   for (int waveIndex = 0; waveIndex < WavesCount; ++waveIndex)
   {
     auto windDirectionLabel = createSidePanelLabel(*d_wavesSettingsLayout);
@@ -252,11 +494,12 @@ void GuiController::createWavesSettings(Dx::IControl& i_parent)
     windDirectionSlider->setOnValueChangedHandler([&, waveIndex](const double i_value) {
       Sdk::Vector2D v{ 1, 0 };
       v.rotate(Sdk::degToRad(i_value));
+      d_game.getWaves().setWindDirection(waveIndex, v);
       d_game.getOceanShader().setWindDirection(waveIndex, std::move(v));
       });
     windDirectionSlider->setMinValue(0);
     windDirectionSlider->setMaxValue(360);
-    windDirectionSlider->setCurrentValue(Waves.at(waveIndex).direction);
+    windDirectionSlider->setCurrentValue(DefaultWaves[waveIndex].direction);
 
 
     auto wavesAmplitudeLabel = createSidePanelLabel(*d_wavesSettingsLayout);
@@ -269,10 +512,11 @@ void GuiController::createWavesSettings(Dx::IControl& i_parent)
       wavesAmplitudeSlider->getSidesSize().x);
     wavesAmplitudeSlider->setOnValueChangedHandler([&, waveIndex](const double i_value) {
       d_game.getOceanShader().setWavesSteepness(waveIndex, i_value);
+      d_game.getWaves().setWavesSteepness(waveIndex, i_value);
       });
     wavesAmplitudeSlider->setMinValue(0);
     wavesAmplitudeSlider->setMaxValue(1);
-    wavesAmplitudeSlider->setCurrentValue(Waves.at(waveIndex).steepness);
+    wavesAmplitudeSlider->setCurrentValue(DefaultWaves[waveIndex].steepness);
     wavesAmplitudeSlider->setLabelsPrecision(2);
 
 
@@ -286,10 +530,11 @@ void GuiController::createWavesSettings(Dx::IControl& i_parent)
       wavesLengthSlider->getSidesSize().x);
     wavesLengthSlider->setOnValueChangedHandler([&, waveIndex](const double i_value) {
       d_game.getOceanShader().setWavesLength(waveIndex, i_value);
+      d_game.getWaves().setWavesLength(waveIndex, i_value);
       });
     wavesLengthSlider->setMinValue(0);
     wavesLengthSlider->setMaxValue(50);
-    wavesLengthSlider->setCurrentValue(Waves.at(waveIndex).length);
+    wavesLengthSlider->setCurrentValue(DefaultWaves[waveIndex].length);
     wavesLengthSlider->setLabelsPrecision(2);
 
     if (waveIndex == WavesCount - 1)
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Fwd.h"
+#include "TextBuffer.h"
 
 #include <LaggyDx/LaggyDxFwd.h>
 
@@ -19,6 +20,20 @@ private:
   Game& d_game;
 
   std::shared_ptr<Dx::Label> d_fpsLabel;
+  TextBuffer d_fpsText;
+  // What d_fpsLabel shows
+  std::string d_fpsLabelText;
+  TextBuffer d_startupText;
+  int d_startupTimingsCount = -1;
+  int d_startupPendingCount = -1;
+  // Since the last refresh of the overlay
+  double d_overlayRefreshTime = 0;
+  // Heap allocations of the last refresh: the formatting, setting the text and laying it out
+  std::uint64_t d_lastRefreshAllocationsCount = 0;
+  // The water queries' totals at the last refresh
+  long long d_waterHitsCount = 0;
+  long long d_waterMissesCount = 0;
+  long long d_waterBakesCount = 0;
   std::shared_ptr<Dx::Panel> d_sidePanel;
   std::shared_ptr<Dx::Layout> d_wavesSettingsLayout;
   std::shared_ptr<Dx::Layout> d_lightSettingsLayout;
@@ -30,6 +45,8 @@ private:
   void setSunLongitude(double i_value);
   void updateLightDirection() const;
 
+  void updateStartupText();
+
   void createFpsLabel();
   void createSidePanel();
 
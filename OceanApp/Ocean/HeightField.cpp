@@ -0,0 +1,322 @@
+#include "stdafx.h"
+#include "HeightField.h"
+
+#include "Simd.h"
+
+#include <LaggyDx/HeightMap.h>
+
+
+namespace
+{
+  using T = Simd::Native;
+
+} // anonym NS
+
+
+HeightField HeightField::fromHeightMap(const Dx::HeightMap& i_heightMap)
+{
+  const auto size = i_heightMap.getSize();
+
+  HeightField heightField(size.x, size.y);
+  for (int y = 0; y < size.y; ++y)
+  {
+    for (int x = 0; x < size.x; ++x)
+      heightField.setValue(x, y, (float)i_heightMap.getHeight(x, y));
+  }
+
+  return heightField;
+}
+
+
+HeightField HeightField::fromPixels(
+  const std::uint8_t* i_pixels, const int i_width, const int i_height, const int i_pixelStride, const int i_rowPitch)
+{
+  CONTRACT_EXPECT(i_pixels);
+  CONTRACT_EXPECT(i_pixelStride > 0);
+
+  constexpr float Scale = 1.0f / 255;
+
+  HeightField heightField(i_width, i_height);
+  for (int y = 0; y < i_height; ++y)
+  {
+    const std::uint8_t* row = i_pixels + (std::size_t)y * i_rowPitch;
+    float* values = heightField.d_values.data() + (std::size_t)y * i_width;
+
+    int x = 0;
+    // 4-byte pixels are loaded a vector at a time, the first channel is the lowest byte
+    if (i_pixelStride == 4)
+    {
+      const auto mask = T::setInt(0xFF);
+      for (; x + T::Width <= i_width; x += T::Width)
+        T::store(values + x, T::mul(T::toFloat(T::andInt(T::loadInt(row + x * 4), mask)), T::set(Scale)));
+    }
+
+    for (; x < i_width; ++x)
+      values[x] = row[x * i_pixelStride] * Scale;
+  }
+
+  return heightField;
+}
+
+
+HeightField::HeightField(const int i_width, const int i_height)
+  : d_width(i_width)
+  , d_height(i_height)
+  , d_values((size_t)i_width * i_height, 0.0f)
+{
+  CONTRACT_EXPECT(i_width > 0);
+  CONTRACT_EXPECT(i_height > 0);
+}
+
+
+int HeightField::getWidth() const
+{
+  return d_width;
+}
+
+int HeightField::getHeight() const
+{
+  return d_height;
+}
+
+
+float HeightField::getValue(const int i_x, const int i_y) const
+{
+  return d_values[i_x + (size_t)i_y * d_width];
+}
+
+void HeightField::setValue(const int i_x, const int i_y, const float i_value)
+{
+  d_values[i_x + (size_t)i_y * d_width] = i_value;
+}
+
+
+float HeightField::sample(const float i_u, const float i_v) const
+{
+  const float x = std::clamp(i_u, 0.0f, 1.0f) * (d_width - 1);
+  const float y = std::clamp(i_v, 0.0f, 1.0f) * (d_height - 1);
+
+  const int x0 = std::max(std::min((int)x, d_width - 2), 0);
+  const int y0 = std::max(std::min((int)y, d_height - 2), 0);
+  const int x1 = std::min(x0 + 1, d_width - 1);
+  const int y1 = std::min(y0 + 1, d_height - 1);
+
+  const float fx = x - x0;
+  const float fy = y - y0;
+
+  const float top = getValue(x0, y0) * (1 - fx) + getValue(x1, y0) * fx;
+  const float bottom = getValue(x0, y1) * (1 - fx) + getValue(x1, y1) * fx;
+  return top * (1 - fy) + bottom * fy;
+}
+
+
+void HeightField::sampleRow(const float i_v, const int i_count, float* o_values) const
+{
+  CONTRACT_EXPECT(i_count > 0);
+
+  // Same arithmetic as sample(), a vector of columns at a time
+  const float y = std::clamp(i_v, 0.0f, 1.0f) * (d_height - 1);
+  const int y0 = std::max(std::min((int)y, d_height - 2), 0);
+  const int y1 = std::min(y0 + 1, d_height - 1);
+  const float fy = y - y0;
+
+  const float* row0 = d_values.data() + (std::size_t)y0 * d_width;
+  const float* row1 = d_values.data() + (std::size_t)y1 * d_width;
+  const float step = i_count > 1 ? 1.0f / (i_count - 1) : 0.0f;
+
+  alignas(32) float lanes[T::Width];
+  for (int lane = 0; lane < T::Width; ++lane)
+    lanes[lane] = (float)lane;
+
+  const auto maxX0 = T::set((float)std::max(d_width - 2, 0));
+  const auto maxX1 = T::set((float)(d_width - 1));
+  const auto one = T::set(1);
+
+  int i = 0;
+  for (; i + T::Width <= i_count; i += T::Width)
+  {
+    const auto u = T::min(T::mul(T::add(T::set((float)i), T::load(lanes)), T::set(step)), one);
+    const auto x = T::mul(u, maxX1);
+    const auto x0 = T::max(T::min(T::toFloat(T::truncToInt(x)), maxX0), T::zero());
+    const auto x1 = T::min(T::add(x0, one), maxX1);
+    const auto fx = T::sub(x, x0);
+    const auto invFx = T::sub(one, fx);
+
+    const auto x0Indices = T::truncToInt(x0);
+    const auto x1Indices = T::truncToInt(x1);
+    const auto top = T::add(T::mul(T::gather(row0, x0Indices), invFx), T::mul(T::gather(row0, x1Indices), fx));
+    const auto bottom = T::add(T::mul(T::gather(row1, x0Indices), invFx), T::mul(T::gather(row1, x1Indices), fx));
+    T::store(o_values + i, T::add(T::mul(top, T::set(1 - fy)), T::mul(bottom, T::set(fy))));
+  }
+
+  for (; i < i_count; ++i)
+    o_values[i] = sample(i * step, i_v);
+}
+
+
+void HeightField::getMinMax(float& o_min, float& o_max) const
+{
+  CONTRACT_EXPECT(!d_values.empty());
+
+  const float* values = d_values.data();
+  const int count = (int)d_values.size();
+
+  auto minValue = T::set(values[0]);
+  auto maxValue = minValue;
+  int i = 0;
+  for (; i + T::Width <= count; i += T::Width)
+  {
+    const auto value = T::load(values + i);
+    minValue = T::min(minValue, value);
+    maxValue = T::max(maxValue, value);
+  }
+
+  o_min = Simd::reduceMin<T>(minValue);
+  o_max = Simd::reduceMax<T>(maxValue);
+  for (; i < count; ++i)
+  {
+    o_min = std::min(o_min, values[i]);
+    o_max = std::max(o_max, values[i]);
+  }
+}
+
+void HeightField::normalize(const float i_min, const float i_max)
+{
+  float min = 0;
+  float max = 0;
+  getMinMax(min, max);
+
+  // A flat field goes to the bottom of the range
+  const float scale = max > min ? (i_max - i_min) / (max - min) : 0.0f;
+  const float offset = i_min - min * scale;
+
+  float* values = d_values.data();
+  const int count = (int)d_values.size();
+
+  int i = 0;
+  for (; i + T::Width <= count; i += T::Width)
+    T::store(values + i, T::add(T::mul(T::load(values + i), T::set(scale)), T::set(offset)));
+  for (; i < count; ++i)
+    values[i] = values[i] * scale + offset;
+}
+
+
+HeightField HeightField::resample(const int i_width, const int i_height) const
+{
+  HeightField heightField(i_width, i_height);
+
+  const float step = i_height > 1 ? 1.0f / (i_height - 1) : 0.0f;
+  for (int y = 0; y < i_height; ++y)
+    sampleRow(y * step, i_width, heightField.d_values.data() + (std::size_t)y * i_width);
+
+  return heightField;
+}
+
+std::vector<HeightField> HeightField::createMips() const
+{
+  std::vector<HeightField> mips;
+
+  const HeightField* source = this;
+  while (source->d_width > 1 || source->d_height > 1)
+  {
+    const int sourceWidth = source->d_width;
+    const int sourceHeight = source->d_height;
+    const int width = (sourceWidth + 1) / 2;
+    const int height = (sourceHeight + 1) / 2;
+
+    HeightField mip(width, height);
+    for (int y = 0; y < height; ++y)
+    {
+      // Odd sizes repeat the last row or column
+      const float* row0 = source->d_values.data() + (std::size_t)(2 * y) * sourceWidth;
+      const float* row1 = source->d_values.data() + (std::size_t)std::min(2 * y + 1, sourceHeight - 1) * sourceWidth;
+      float* values = mip.d_values.data() + (std::size_t)y * width;
+
+      int x = 0;
+      for (; 2 * (x + T::Width) <= sourceWidth; x += T::Width)
+      {
+        const auto low = T::add(T::load(row0 + 2 * x), T::load(row1 + 2 * x));
+        const auto high = T::add(T::load(row0 + 2 * x + T::Width), T::load(row1 + 2 * x + T::Width));
+        T::store(values + x, T::mul(T::addPairs(low, high), T::set(0.25f)));
+      }
+
+      for (; x < width; ++x)
+      {
+        const int x0 = 2 * x;
+        const int x1 = std::min(2 * x + 1, sourceWidth - 1);
+        values[x] = (row0[x0] + row0[x1] + row1[x0] + row1[x1]) * 0.25f;
+      }
+    }
+
+    mips.push_back(std::move(mip));
+    source = &mips.back();
+  }
+
+  return mips;
+}
+
+std::vector<Sdk::Vector3F> HeightField::createNormals(const float i_cellSize) const
+{
+  CONTRACT_EXPECT(i_cellSize > 0);
+
+  std::vector<Sdk::Vector3F> normals(d_values.size());
+
+  const auto getNormal = [&](const int i_x, const int i_y) {
+    const int x0 = std::max(i_x - 1, 0);
+    const int x1 = std::min(i_x + 1, d_width - 1);
+    const int y0 = std::max(i_y - 1, 0);
+    const int y1 = std::min(i_y + 1, d_height - 1);
+    const float dx = x1 > x0 ? (getValue(x1, i_y) - getValue(x0, i_y)) / ((x1 - x0) * i_cellSize) : 0.0f;
+    const float dz = y1 > y0 ? (getValue(i_x, y1) - getValue(i_x, y0)) / ((y1 - y0) * i_cellSize) : 0.0f;
+    return Sdk::Vector3F{ -dx, 1, -dz }.getNormalized();
+  };
+
+  // Vectorized over the inner columns of every row, the normals are computed into planes
+  // and interleaved afterwards
+  std::vector<float> planeX(d_width), planeY(d_width), planeZ(d_width);
+  const float inverseStep = 1.0f / (2 * i_cellSize);
+
+  for (int y = 0; y < d_height; ++y)
+  {
+    const int y0 = std::max(y - 1, 0);
+    const int y1 = std::min(y + 1, d_height - 1);
+    const float rowInverseStep = y1 > y0 ? 1.0f / ((y1 - y0) * i_cellSize) : 0.0f;
+
+    const float* row = d_values.data() + (std::size_t)y * d_width;
+    const float* rowAbove = d_values.data() + (std::size_t)y0 * d_width;
+    const float* rowBelow = d_values.data() + (std::size_t)y1 * d_width;
+    auto* rowNormals = normals.data() + (std::size_t)y * d_width;
+
+    int x = 1;
+    for (; x + T::Width < d_width; x += T::Width)
+    {
+      const auto dx = T::mul(T::sub(T::load(row + x + 1), T::load(row + x - 1)), T::set(inverseStep));
+      const auto dz = T::mul(T::sub(T::load(rowBelow + x), T::load(rowAbove + x)), T::set(rowInverseStep));
+      const auto length = T::sqrt(T::add(T::add(T::mul(dx, dx), T::mul(dz, dz)), T::set(1)));
+      const auto inverseLength = T::div(T::set(1), length);
+
+      T::store(planeX.data() + x, T::neg(T::mul(dx, inverseLength)));
+      T::store(planeY.data() + x, inverseLength);
+      T::store(planeZ.data() + x, T::neg(T::mul(dz, inverseLength)));
+    }
+
+    for (int i = 1; i < x; ++i)
+      rowNormals[i] = { planeX[i], planeY[i], planeZ[i] };
+    for (; x < d_width; ++x)
+      rowNormals[x] = getNormal(x, y);
+    rowNormals[0] = getNormal(0, y);
+  }
+
+  return normals;
+}
+
+
+const std::vector<float>& HeightField::getValues() const
+{
+  return d_values;
+}
+
+std::vector<float>& HeightField::getValues()
+{
+  return d_values;
+}
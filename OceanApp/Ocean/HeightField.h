@@ -0,0 +1,52 @@
+#pragma once
+
+#include <LaggyDx/LaggyDxFwd.h>
+#include <LaggySdk/Vector.h>
+
+#include <cstdint>
+#include <vector>
+
+
+// CPU-side copy of a height map, one float per texel, row-major. The bulk operations
+// are vectorized
+class HeightField
+{
+public:
+  static HeightField fromHeightMap(const Dx::HeightMap& i_heightMap);
+  // First channel of 8-bit pixels, scaled to [0, 1]
+  static HeightField fromPixels(const std::uint8_t* i_pixels, int i_width, int i_height, int i_pixelStride, int i_rowPitch);
+
+  HeightField() = default;
+  HeightField(int i_width, int i_height);
+
+  int getWidth() const;
+  int getHeight() const;
+
+  float getValue(int i_x, int i_y) const;
+  void setValue(int i_x, int i_y, float i_value);
+
+  // Bilinear, i_u and i_v are in [0, 1] and are clamped to it
+  float sample(float i_u, float i_v) const;
+  // i_count samples evenly spread over the whole width, at the given v. Same values as sample()
+  void sampleRow(float i_v, int i_count, float* o_values) const;
+
+  void getMinMax(float& o_min, float& o_max) const;
+  // Maps the values range linearly to [i_min, i_max]
+  void normalize(float i_min, float i_max);
+
+  // Bilinear, corners stay in place
+  HeightField resample(int i_width, int i_height) const;
+  // Each level averages 2 x 2 texels of the previous one, down to 1 x 1. The field itself
+  // isn't included
+  std::vector<HeightField> createMips() const;
+  // Central differences, one-sided at the edges
+  std::vector<Sdk::Vector3F> createNormals(float i_cellSize) const;
+
+  const std::vector<float>& getValues() const;
+  std::vector<float>& getValues();
+
+private:
+  int d_width = 0;
+  int d_height = 0;
+  std::vector<float> d_values;
+};
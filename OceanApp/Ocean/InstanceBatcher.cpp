@@ -0,0 +1,56 @@
+#include "stdafx.h"
+#include "InstanceBatcher.h"
+
+#include <algorithm>
+
+
+void InstanceBatcher::clear()
+{
+  // Capacities are kept, so rebuilding every frame doesn't allocate
+  d_items.clear();
+  d_modelsCount = 0;
+  d_batches.clear();
+  d_tags.clear();
+}
+
+void InstanceBatcher::add(const int i_modelId, const int i_tag)
+{
+  CONTRACT_EXPECT(i_modelId >= 0);
+  d_items.push_back({ i_modelId, i_tag });
+  d_modelsCount = std::max(d_modelsCount, i_modelId + 1);
+}
+
+
+void InstanceBatcher::build()
+{
+  // Counting sort: the items are placed in the order they were added, so it's stable
+  d_offsets.assign(d_modelsCount, 0);
+  for (const auto& item : d_items)
+    ++d_offsets[item.modelId];
+
+  d_batches.clear();
+  int firstInstance = 0;
+  for (int modelId = 0; modelId < d_modelsCount; ++modelId)
+  {
+    const int instancesCount = d_offsets[modelId];
+    if (instancesCount > 0)
+      d_batches.push_back({ modelId, firstInstance, instancesCount });
+    d_offsets[modelId] = firstInstance;
+    firstInstance += instancesCount;
+  }
+
+  d_tags.resize(d_items.size());
+  for (const auto& item : d_items)
+    d_tags[d_offsets[item.modelId]++] = item.tag;
+}
+
+
+const std::vector<InstanceBatch>& InstanceBatcher::getBatches() const
+{
+  return d_batches;
+}
+
+const std::vector<int>& InstanceBatcher::getTags() const
+{
+  return d_tags;
+}
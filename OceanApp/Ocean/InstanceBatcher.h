@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+
+
+struct InstanceBatch
+{
+  int modelId = 0;
+  int firstInstance = 0;
+  int instancesCount = 0;
+};
+
+
+// Groups objects by model. After build() the objects of every group are contiguous in
+// getTags(), in the order they were added, and every batch is a range of them sharing the
+// vertex and index buffers and the material. Only the grouping: the shaders have no instanced
+// draw yet, so the batches are drawn object by object and there is no per-instance data to fill.
+// Model ids index a counting sort, so they should be dense
+class InstanceBatcher
+{
+public:
+  void clear();
+  // i_tag is returned back by getTags() in the order of the built batches
+  void add(int i_modelId, int i_tag);
+  // Doesn't allocate once the buffers have grown to the objects and models counts
+  void build();
+
+  const std::vector<InstanceBatch>& getBatches() const;
+  const std::vector<int>& getTags() const;
+
+private:
+  struct Item
+  {
+    int modelId = 0;
+    int tag = 0;
+  };
+
+  std::vector<Item> d_items;
+  int d_modelsCount = 0;
+  // Per model id, the items counts and then the next position of the model's tags
+  std::vector<int> d_offsets;
+
+  std::vector<InstanceBatch> d_batches;
+  std::vector<int> d_tags;
+};
@@ -0,0 +1,131 @@
+#include "stdafx.h"
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+MappedFile::~MappedFile()
+{
+  close();
+}
+
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::filesystem::path& i_path)
+{
+  close();
+
+  d_file = CreateFileW(i_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+    OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (d_file == INVALID_HANDLE_VALUE)
+  {
+    d_file = nullptr;
+    return false;
+  }
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(d_file, &size) || size.QuadPart == 0)
+  {
+    close();
+    return false;
+  }
+
+  d_mapping = CreateFileMappingW(d_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!d_mapping)
+  {
+    close();
+    return false;
+  }
+
+  d_data = (const std::byte*)MapViewOfFile(d_mapping, FILE_MAP_READ, 0, 0, 0);
+  if (!d_data)
+  {
+    close();
+    return false;
+  }
+
+  d_size = (std::size_t)size.QuadPart;
+  return true;
+}
+
+void MappedFile::close()
+{
+  if (d_data)
+    UnmapViewOfFile(d_data);
+  if (d_mapping)
+    CloseHandle(d_mapping);
+  if (d_file)
+    CloseHandle(d_file);
+
+  d_data = nullptr;
+  d_size = 0;
+  d_mapping = nullptr;
+  d_file = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const std::filesystem::path& i_path)
+{
+  close();
+
+  d_file = ::open(i_path.c_str(), O_RDONLY);
+  if (d_file < 0)
+    return false;
+
+  struct stat status;
+  if (fstat(d_file, &status) != 0 || status.st_size == 0)
+  {
+    close();
+    return false;
+  }
+
+  void* data = mmap(nullptr, (std::size_t)status.st_size, PROT_READ, MAP_PRIVATE, d_file, 0);
+  if (data == MAP_FAILED)
+  {
+    close();
+    return false;
+  }
+
+  d_data = (const std::byte*)data;
+  d_size = (std::size_t)status.st_size;
+  return true;
+}
+
+void MappedFile::close()
+{
+  if (d_data)
+    munmap((void*)d_data, d_size);
+  if (d_file >= 0)
+    ::close(d_file);
+
+  d_data = nullptr;
+  d_size = 0;
+  d_file = -1;
+}
+
+#endif
+
+
+bool MappedFile::isOpen() const
+{
+  return d_data;
+}
+
+const std::byte* MappedFile::getData() const
+{
+  return d_data;
+}
+
+std::size_t MappedFile::getSize() const
+{
+  return d_size;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+
+
+// Read-only view of a whole file mapped to memory
+class MappedFile
+{
+public:
+  MappedFile() = default;
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  // Returns false if the file can't be opened or is empty
+  bool open(const std::filesystem::path& i_path);
+  void close();
+
+  bool isOpen() const;
+  const std::byte* getData() const;
+  std::size_t getSize() const;
+
+private:
+  const std::byte* d_data = nullptr;
+  std::size_t d_size = 0;
+
+#ifdef _WIN32
+  void* d_file = nullptr;
+  void* d_mapping = nullptr;
+#else
+  int d_file = -1;
+#endif
+};
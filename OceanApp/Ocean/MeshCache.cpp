@@ -0,0 +1,115 @@
+#include "stdafx.h"
+#include "MeshCache.h"
+
+#include "MeshOptimizer.h"
+
+#include <LaggyDx/IShape3d.h>
+#include <LaggyDx/ModelUtils.h>
+#include <LaggyDx/Object3.h>
+
+
+namespace
+{
+  std::size_t getShapeBytes(const Dx::IShape3d& i_shape)
+  {
+    return
+      i_shape.getVerts().size() * sizeof(Dx::VertexPosNormText) +
+      i_shape.getInds().size() * sizeof(int);
+  }
+
+} // anonym NS
+
+
+std::shared_ptr<Dx::IObject3> MeshCache::createObject(
+  const std::shared_ptr<Dx::IShape3d>& i_shape, const Dx::IRenderDevice& i_renderDevice)
+{
+  CONTRACT_EXPECT(i_shape);
+  ++d_instancesCount;
+
+  auto it = d_entries.find(i_shape.get());
+  if (it == d_entries.end())
+  {
+    VertexCacheStats before;
+    VertexCacheStats after;
+    const auto optimizedShape = createOptimizedShape(*i_shape, &before, &after);
+
+    const double trisCount = (double)i_shape->getInds().size() / 3;
+    const double transformedCount = before.acmr * trisCount;
+    d_trisCount += trisCount;
+    d_transformedVertsCountBefore += transformedCount;
+    d_transformedVertsCountAfter += after.acmr * trisCount;
+    if (before.atvr > 0)
+      d_referencedVertsCount += transformedCount / before.atvr;
+
+    Entry entry;
+    entry.shape = i_shape;
+    entry.prototype = Dx::createObjectFromShape(*optimizedShape, i_renderDevice, true);
+    entry.bytes = getShapeBytes(*optimizedShape);
+    entry.id = (int)d_entries.size();
+    d_bounds.push_back(getShapeBounds(*optimizedShape));
+
+    d_uploadedBytes += entry.bytes;
+    d_objectMeshIds[entry.prototype.get()] = entry.id;
+    d_entries.insert({ i_shape.get(), entry });
+    return entry.prototype;
+  }
+
+  auto& entry = it->second;
+  d_savedBytes += entry.bytes;
+
+  auto object = std::make_shared<Dx::Object3>();
+  object->setModel(entry.prototype->getModel());
+  d_objectMeshIds[object.get()] = entry.id;
+  return object;
+}
+
+
+int MeshCache::getMeshId(const Dx::IObject3& i_object) const
+{
+  const auto it = d_objectMeshIds.find(&i_object);
+  return it != d_objectMeshIds.end() ? it->second : -1;
+}
+
+
+const BoundingBox* MeshCache::getLocalBounds(const Dx::IObject3& i_object) const
+{
+  const int meshId = getMeshId(i_object);
+  return meshId >= 0 ? &d_bounds[meshId] : nullptr;
+}
+
+
+int MeshCache::getUploadsCount() const
+{
+  return (int)d_entries.size();
+}
+
+int MeshCache::getInstancesCount() const
+{
+  return d_instancesCount;
+}
+
+
+std::size_t MeshCache::getUploadedBytes() const
+{
+  return d_uploadedBytes;
+}
+
+std::size_t MeshCache::getSavedBytes() const
+{
+  return d_savedBytes;
+}
+
+
+VertexCacheStats MeshCache::getVertexCacheStatsBefore() const
+{
+  if (d_trisCount == 0 || d_referencedVertsCount == 0)
+    return {};
+  return { (float)(d_transformedVertsCountBefore / d_trisCount), (float)(d_transformedVertsCountBefore / d_referencedVertsCount) };
+}
+
+VertexCacheStats MeshCache::getVertexCacheStatsAfter() const
+{
+  if (d_trisCount == 0 || d_referencedVertsCount == 0)
+    return {};
+  return { (float)(d_transformedVertsCountAfter / d_trisCount), (float)(d_transformedVertsCountAfter / d_referencedVertsCount) };
+}
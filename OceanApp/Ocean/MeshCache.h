@@ -0,0 +1,60 @@
+#pragma once
+
+#include "BoundingBox.h"
+#include "MeshOptimizer.h"
+
+#include <LaggyDx/IObject3.h>
+#include <LaggyDx/LaggyDxFwd.h>
+
+#include <unordered_map>
+
+
+// Creates objects from shapes, uploading every shape to the device only once.
+// Objects created from the same shape share the model (and so the vertex and index buffers)
+// and differ only in transform. Shapes are reordered for the vertex cache before the upload
+class MeshCache
+{
+public:
+  std::shared_ptr<Dx::IObject3> createObject(
+    const std::shared_ptr<Dx::IShape3d>& i_shape, const Dx::IRenderDevice& i_renderDevice);
+
+  // Objects sharing the model have the same id. Returns -1 for objects not created by the cache
+  int getMeshId(const Dx::IObject3& i_object) const;
+  // Bounds of the object's shape in its local space, nullptr for objects not created by the cache
+  const BoundingBox* getLocalBounds(const Dx::IObject3& i_object) const;
+
+  int getUploadsCount() const;
+  int getInstancesCount() const;
+
+  // Size of the vertex and index data actually uploaded
+  std::size_t getUploadedBytes() const;
+  // Size of the data that would have been uploaded again without the cache
+  std::size_t getSavedBytes() const;
+
+  // Of all the uploaded meshes together, as generated and as uploaded
+  VertexCacheStats getVertexCacheStatsBefore() const;
+  VertexCacheStats getVertexCacheStatsAfter() const;
+
+private:
+  struct Entry
+  {
+    std::shared_ptr<Dx::IShape3d> shape;
+    std::shared_ptr<Dx::IObject3> prototype;
+    std::size_t bytes = 0;
+    int id = 0;
+  };
+
+  std::unordered_map<const Dx::IShape3d*, Entry> d_entries;
+  std::unordered_map<const Dx::IObject3*, int> d_objectMeshIds;
+  // Per mesh id
+  std::vector<BoundingBox> d_bounds;
+
+  int d_instancesCount = 0;
+  std::size_t d_uploadedBytes = 0;
+  std::size_t d_savedBytes = 0;
+
+  double d_trisCount = 0;
+  double d_referencedVertsCount = 0;
+  double d_transformedVertsCountBefore = 0;
+  double d_transformedVertsCountAfter = 0;
+};
@@ -0,0 +1,190 @@
+#include "stdafx.h"
+#include "MeshFileCache.h"
+
+#include "HeightField.h"
+#include "MappedFile.h"
+
+#include <LaggyDx/IShape3d.h>
+#include <LaggyDx/Shape3d.h>
+
+#include <cstring>
+#include <fstream>
+
+
+namespace
+{
+  // Bump on any change of the layout below or of the vertex type
+  constexpr std::uint32_t FormatVersion = 2;
+  constexpr char Magic[4] = { 'O', 'M', 'S', 'H' };
+
+  struct Header
+  {
+    char magic[4];
+    std::uint32_t version;
+    std::uint64_t key;
+    std::uint32_t vertexSize;
+    std::uint32_t vertsCount;
+    std::uint32_t indsCount;
+    std::uint32_t padding;
+    MeshFileMaterial material;
+  };
+  static_assert(std::is_trivially_copyable_v<Header>);
+  static_assert(std::is_trivially_copyable_v<Dx::VertexPosNormText>);
+
+  // FNV-1a, fed with 8 bytes at a time: a byte at a time takes longer than loading the mesh
+  class Hasher
+  {
+  public:
+    void add(const void* i_data, const std::size_t i_size)
+    {
+      const auto* bytes = (const unsigned char*)i_data;
+      std::size_t i = 0;
+      for (; i + sizeof(std::uint64_t) <= i_size; i += sizeof(std::uint64_t))
+      {
+        std::uint64_t word;
+        std::memcpy(&word, bytes + i, sizeof(word));
+        mix(word);
+      }
+      for (; i < i_size; ++i)
+        mix(bytes[i]);
+    }
+
+    template <typename T>
+    void add(const T& i_value)
+    {
+      add(&i_value, sizeof(i_value));
+    }
+
+    std::uint64_t get() const
+    {
+      return d_hash;
+    }
+
+  private:
+    std::uint64_t d_hash = 14695981039346656037ull;
+
+    void mix(const std::uint64_t i_value)
+    {
+      d_hash = (d_hash ^ i_value) * 1099511628211ull;
+    }
+  };
+
+} // anonym NS
+
+
+MeshFileCache::MeshFileCache(std::filesystem::path i_folder)
+  : d_folder(std::move(i_folder))
+{
+}
+
+
+std::uint64_t MeshFileCache::getKey(const HeightField& i_heightField, const int i_maxDepth, const int i_predicateVersion)
+{
+  Hasher hasher;
+  hasher.add(i_heightField.getWidth());
+  hasher.add(i_heightField.getHeight());
+  hasher.add(i_maxDepth);
+  hasher.add(i_predicateVersion);
+
+  const auto& values = i_heightField.getValues();
+  hasher.add(values.data(), values.size() * sizeof(float));
+
+  return hasher.get();
+}
+
+std::uint64_t MeshFileCache::getFileKey(const std::filesystem::path& i_path, const int i_version)
+{
+  MappedFile file;
+  if (!file.open(i_path))
+    return 0;
+
+  Hasher hasher;
+  hasher.add(i_version);
+  hasher.add(file.getData(), file.getSize());
+  return hasher.get();
+}
+
+
+std::shared_ptr<Dx::IShape3d> MeshFileCache::load(const std::uint64_t i_key, MeshFileMaterial& o_material) const
+{
+  MappedFile file;
+  if (!file.open(getPath(i_key)) || file.getSize() < sizeof(Header))
+    return nullptr;
+
+  Header header;
+  std::memcpy(&header, file.getData(), sizeof(Header));
+
+  if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 ||
+    header.version != FormatVersion ||
+    header.key != i_key ||
+    header.vertexSize != sizeof(Dx::VertexPosNormText))
+  {
+    return nullptr;
+  }
+
+  const std::size_t vertsBytes = (std::size_t)header.vertsCount * sizeof(Dx::VertexPosNormText);
+  const std::size_t indsBytes = (std::size_t)header.indsCount * sizeof(int);
+  if (file.getSize() != sizeof(Header) + vertsBytes + indsBytes)
+    return nullptr;
+
+  auto shape = std::make_shared<Dx::Shape3d>();
+  auto& verts = shape->getVerts();
+  auto& inds = shape->getInds();
+
+  verts.resize(header.vertsCount);
+  inds.resize(header.indsCount);
+  std::memcpy(verts.data(), file.getData() + sizeof(Header), vertsBytes);
+  std::memcpy(inds.data(), file.getData() + sizeof(Header) + vertsBytes, indsBytes);
+
+  o_material = header.material;
+  return shape;
+}
+
+bool MeshFileCache::save(const std::uint64_t i_key, const Dx::IShape3d& i_shape, const MeshFileMaterial& i_material) const
+{
+  const auto& verts = i_shape.getVerts();
+  const auto& inds = i_shape.getInds();
+
+  Header header{};
+  std::memcpy(header.magic, Magic, sizeof(Magic));
+  header.version = FormatVersion;
+  header.key = i_key;
+  header.vertexSize = sizeof(Dx::VertexPosNormText);
+  header.vertsCount = (std::uint32_t)verts.size();
+  header.indsCount = (std::uint32_t)inds.size();
+  header.material = i_material;
+
+  std::error_code error;
+  std::filesystem::create_directories(d_folder, error);
+
+  // Written aside and renamed, so an interrupted write never leaves a truncated file behind
+  const auto path = getPath(i_key);
+  auto tempPath = path;
+  tempPath += ".tmp";
+
+  bool written = false;
+  {
+    std::ofstream stream(tempPath, std::ios::binary | std::ios::trunc);
+    stream.write((const char*)&header, sizeof(header));
+    stream.write((const char*)verts.data(), verts.size() * sizeof(Dx::VertexPosNormText));
+    stream.write((const char*)inds.data(), inds.size() * sizeof(int));
+    written = (bool)stream;
+  }
+
+  if (written)
+    std::filesystem::rename(tempPath, path, error);
+  if (!written || error)
+  {
+    std::filesystem::remove(tempPath, error);
+    return false;
+  }
+  return true;
+}
+
+
+std::filesystem::path MeshFileCache::getPath(const std::uint64_t i_key) const
+{
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx.mesh", (unsigned long long)i_key);
+  return d_folder / name;
+}
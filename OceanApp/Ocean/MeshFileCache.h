@@ -0,0 +1,45 @@
+#pragma once
+
+#include <LaggyDx/LaggyDxFwd.h>
+#include <LaggySdk/Vector.h>
+
+#include <cstdint>
+#include <filesystem>
+
+
+class HeightField;
+
+
+struct MeshFileMaterial
+{
+  Sdk::Vector4F diffuseColor = { 1, 1, 1, 1 };
+  float specularIntensity = 0;
+  float specularPower = 0;
+};
+
+
+// Built meshes stored on disk, one file per key. A file is a fixed header followed by the raw
+// vertices and indices, so loading maps it and copies the arrays out without any parsing.
+// Files of another format version or with a different key are ignored and rebuilt
+class MeshFileCache
+{
+public:
+  MeshFileCache(std::filesystem::path i_folder);
+
+  // Hash of everything the surface mesh is built from. i_predicateVersion stands for the
+  // predicate, which can't be hashed
+  static std::uint64_t getKey(const HeightField& i_heightField, int i_maxDepth, int i_predicateVersion);
+  // Hash of a source file's bytes, so it can be recognized without being decoded. 0 if the
+  // file can't be read
+  static std::uint64_t getFileKey(const std::filesystem::path& i_path, int i_version);
+
+  // Null if there's no valid file for the key
+  std::shared_ptr<Dx::IShape3d> load(std::uint64_t i_key, MeshFileMaterial& o_material) const;
+  // Returns false if the file can't be written
+  bool save(std::uint64_t i_key, const Dx::IShape3d& i_shape, const MeshFileMaterial& i_material) const;
+
+  std::filesystem::path getPath(std::uint64_t i_key) const;
+
+private:
+  std::filesystem::path d_folder;
+};
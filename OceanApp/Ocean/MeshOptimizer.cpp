@@ -0,0 +1,222 @@
+#include "stdafx.h"
+#include "MeshOptimizer.h"
+
+#include <LaggyDx/IShape3d.h>
+#include <LaggyDx/Shape3d.h>
+
+
+namespace
+{
+  class TipsifyState
+  {
+  public:
+    TipsifyState(const std::vector<int>& i_inds, const int i_vertsCount, const int i_cacheSize)
+      : d_inds(i_inds)
+      , d_cacheSize(i_cacheSize)
+      , d_liveCounts(i_vertsCount, 0)
+      , d_offsets(i_vertsCount + 1, 0)
+      , d_timestamps(i_vertsCount, 0)
+      , d_emitted(i_inds.size() / 3, false)
+    {
+      // Vertex to triangles adjacency, packed
+      for (const int index : d_inds)
+        ++d_liveCounts[index];
+      for (int vertex = 0; vertex < i_vertsCount; ++vertex)
+        d_offsets[vertex + 1] = d_offsets[vertex] + d_liveCounts[vertex];
+
+      d_triangles.resize(d_inds.size());
+      std::vector<int> fill(d_offsets.begin(), d_offsets.end() - 1);
+      for (int i = 0; i < (int)d_inds.size(); ++i)
+        d_triangles[fill[d_inds[i]]++] = i / 3;
+
+      // Far enough from 0 that no vertex is in the cache at the start
+      d_time = i_cacheSize + 1;
+    }
+
+    std::vector<int> run()
+    {
+      std::vector<int> result;
+      result.reserve(d_inds.size());
+
+      int fanning = skipDeadEnd();
+      while (fanning >= 0)
+      {
+        d_candidates.clear();
+
+        for (int i = d_offsets[fanning]; i < d_offsets[fanning + 1]; ++i)
+        {
+          const int triangle = d_triangles[i];
+          if (d_emitted[triangle])
+            continue;
+          d_emitted[triangle] = true;
+
+          for (int corner = 0; corner < 3; ++corner)
+          {
+            const int vertex = d_inds[triangle * 3 + corner];
+            result.push_back(vertex);
+            d_deadEnd.push_back(vertex);
+            d_candidates.push_back(vertex);
+            --d_liveCounts[vertex];
+
+            if (d_time - d_timestamps[vertex] > d_cacheSize)
+              d_timestamps[vertex] = d_time++;
+          }
+        }
+
+        fanning = getNextVertex();
+      }
+
+      return result;
+    }
+
+  private:
+    const std::vector<int>& d_inds;
+    const int d_cacheSize;
+
+    std::vector<int> d_liveCounts;
+    std::vector<int> d_offsets;
+    std::vector<int> d_triangles;
+    std::vector<int> d_timestamps;
+    std::vector<bool> d_emitted;
+
+    std::vector<int> d_deadEnd;
+    std::vector<int> d_candidates;
+    int d_time = 0;
+    int d_cursor = 0;
+
+    int getNextVertex()
+    {
+      // The candidate that would still be in the cache after its remaining triangles are
+      // emitted, the oldest such one
+      int best = -1;
+      int bestPriority = -1;
+      for (const int vertex : d_candidates)
+      {
+        if (d_liveCounts[vertex] <= 0)
+          continue;
+
+        int priority = 0;
+        if (d_time - d_timestamps[vertex] + 2 * d_liveCounts[vertex] <= d_cacheSize)
+          priority = d_time - d_timestamps[vertex];
+
+        if (priority > bestPriority)
+        {
+          best = vertex;
+          bestPriority = priority;
+        }
+      }
+
+      return best >= 0 ? best : skipDeadEnd();
+    }
+
+    int skipDeadEnd()
+    {
+      // Recently used vertices first, then the input order
+      while (!d_deadEnd.empty())
+      {
+        const int vertex = d_deadEnd.back();
+        d_deadEnd.pop_back();
+        if (d_liveCounts[vertex] > 0)
+          return vertex;
+      }
+
+      for (; d_cursor < (int)d_liveCounts.size(); ++d_cursor)
+      {
+        if (d_liveCounts[d_cursor] > 0)
+          return d_cursor;
+      }
+
+      return -1;
+    }
+  };
+
+} // anonym NS
+
+
+VertexCacheStats getVertexCacheStats(const std::vector<int>& i_inds, const int i_cacheSize)
+{
+  CONTRACT_EXPECT(i_cacheSize > 0);
+  if (i_inds.empty())
+    return {};
+
+  const int vertsCount = *std::max_element(i_inds.begin(), i_inds.end()) + 1;
+
+  // A vertex is in the FIFO while fewer than cache size vertices were transformed after it
+  std::vector<int> insertedAt(vertsCount, -1);
+  int transformedCount = 0;
+  int referencedCount = 0;
+  for (const int index : i_inds)
+  {
+    if (insertedAt[index] < 0)
+      ++referencedCount;
+    else if (transformedCount - insertedAt[index] < i_cacheSize)
+      continue;
+
+    insertedAt[index] = ++transformedCount;
+  }
+
+  VertexCacheStats stats;
+  stats.acmr = (float)transformedCount / (i_inds.size() / 3);
+  stats.atvr = (float)transformedCount / referencedCount;
+  return stats;
+}
+
+
+void optimizeVertexCache(std::vector<int>& io_inds, const int i_vertsCount, const int i_cacheSize)
+{
+  CONTRACT_EXPECT(io_inds.size() % 3 == 0);
+  CONTRACT_EXPECT(i_cacheSize > 0);
+
+  if (io_inds.empty())
+    return;
+
+  io_inds = TipsifyState(io_inds, i_vertsCount, i_cacheSize).run();
+}
+
+void optimizeVertexFetch(std::vector<Dx::VertexPosNormText>& io_verts, std::vector<int>& io_inds)
+{
+  std::vector<int> remap(io_verts.size(), -1);
+  std::vector<Dx::VertexPosNormText> verts;
+  verts.reserve(io_verts.size());
+
+  for (int& index : io_inds)
+  {
+    if (remap[index] < 0)
+    {
+      remap[index] = (int)verts.size();
+      verts.push_back(io_verts[index]);
+    }
+    index = remap[index];
+  }
+
+  for (int vertex = 0; vertex < (int)io_verts.size(); ++vertex)
+  {
+    if (remap[vertex] < 0)
+      verts.push_back(io_verts[vertex]);
+  }
+
+  io_verts = std::move(verts);
+}
+
+
+void optimizeMesh(std::vector<Dx::VertexPosNormText>& io_verts, std::vector<int>& io_inds)
+{
+  optimizeVertexCache(io_inds, (int)io_verts.size());
+  optimizeVertexFetch(io_verts, io_inds);
+}
+
+std::shared_ptr<Dx::IShape3d> createOptimizedShape(const Dx::IShape3d& i_shape,
+  VertexCacheStats* o_before, VertexCacheStats* o_after)
+{
+  auto shape = std::make_shared<Dx::Shape3d>();
+  shape->getVerts() = i_shape.getVerts();
+  shape->getInds() = i_shape.getInds();
+
+  if (o_before)
+    *o_before = getVertexCacheStats(shape->getInds());
+  optimizeMesh(shape->getVerts(), shape->getInds());
+  if (o_after)
+    *o_after = getVertexCacheStats(shape->getInds());
+
+  return shape;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <LaggyDx/LaggyDxFwd.h>
+#include <LaggyDx/VertexTypes.h>
+
+#include <memory>
+#include <vector>
+
+
+// FIFO size of the simulated post-transform cache. Real caches vary, 16 to 32 entries
+// are common, the orders that are good for one are good for the others
+constexpr int VertexCacheSize = 16;
+
+struct VertexCacheStats
+{
+  // Vertices transformed per triangle, 0.5 for an ideal regular grid, 3 at worst
+  float acmr = 0;
+  // Vertices transformed per referenced vertex, 1 at best
+  float atvr = 0;
+};
+
+// Runs the indices of a triangle list through a simulated FIFO vertex cache
+VertexCacheStats getVertexCacheStats(const std::vector<int>& i_inds, int i_cacheSize = VertexCacheSize);
+
+// Reorders triangles for the post-transform cache (Tipsify: fans around the vertex that stays
+// longest in the cache, linear in the size of the mesh). The triangles and their winding are kept
+void optimizeVertexCache(std::vector<int>& io_inds, int i_vertsCount, int i_cacheSize = VertexCacheSize);
+// Reorders vertices in the order of their first use, so vertex fetches walk the buffer forward.
+// Unreferenced vertices are moved to the end
+void optimizeVertexFetch(std::vector<Dx::VertexPosNormText>& io_verts, std::vector<int>& io_inds);
+
+// Both of the above
+void optimizeMesh(std::vector<Dx::VertexPosNormText>& io_verts, std::vector<int>& io_inds);
+// Optimized copy of the shape. Stats before and after are returned if asked for
+std::shared_ptr<Dx::IShape3d> createOptimizedShape(const Dx::IShape3d& i_shape,
+  VertexCacheStats* o_before = nullptr, VertexCacheStats* o_after = nullptr);
@@ -0,0 +1,481 @@
+#include "stdafx.h"
+#include "ObjectBvh.h"
+
+#include <cmath>
+#include <limits>
+
+
+namespace
+{
+  BoundingBox combine(const BoundingBox& i_left, const BoundingBox& i_right)
+  {
+    BoundingBox box = i_left;
+    box.expand(i_right);
+    return box;
+  }
+
+  float getArea(const BoundingBox& i_box)
+  {
+    const auto size = i_box.max - i_box.min;
+    return 2 * (size.x * size.y + size.y * size.z + size.z * size.x);
+  }
+
+  bool contains(const BoundingBox& i_outer, const BoundingBox& i_inner)
+  {
+    return
+      i_outer.min.x <= i_inner.min.x && i_outer.min.y <= i_inner.min.y && i_outer.min.z <= i_inner.min.z &&
+      i_outer.max.x >= i_inner.max.x && i_outer.max.y >= i_inner.max.y && i_outer.max.z >= i_inner.max.z;
+  }
+
+  bool overlaps(const BoundingBox& i_left, const BoundingBox& i_right)
+  {
+    return
+      i_left.min.x <= i_right.max.x && i_left.max.x >= i_right.min.x &&
+      i_left.min.y <= i_right.max.y && i_left.max.y >= i_right.min.y &&
+      i_left.min.z <= i_right.max.z && i_left.max.z >= i_right.min.z;
+  }
+
+  float getSquaredDistance(const BoundingBox& i_box, const Sdk::Vector3F& i_point)
+  {
+    const float dx = std::max({ i_box.min.x - i_point.x, 0.0f, i_point.x - i_box.max.x });
+    const float dy = std::max({ i_box.min.y - i_point.y, 0.0f, i_point.y - i_box.max.y });
+    const float dz = std::max({ i_box.min.z - i_point.z, 0.0f, i_point.z - i_box.max.z });
+    return dx * dx + dy * dy + dz * dz;
+  }
+
+  bool isInFrustum(const BoundingBox& i_box, const FrustumPlanes& i_planes)
+  {
+    const auto center = i_box.getCenter();
+    const auto extents = i_box.getExtents();
+    for (const auto& plane : i_planes)
+    {
+      const float distance = plane[0] * center.x + plane[1] * center.y + plane[2] * center.z + plane[3];
+      const float radius = std::abs(plane[0]) * extents.x + std::abs(plane[1]) * extents.y + std::abs(plane[2]) * extents.z;
+      if (distance + radius < 0)
+        return false;
+    }
+    return true;
+  }
+
+  // Narrows the distances along the ray to the part within the slab. Returns false if the ray
+  // misses it. A ray parallel to the slab is tested apart: on the slab's planes the distance
+  // would be 0 * infinity, which is NaN
+  bool clipSlab(const float i_min, const float i_max, const float i_origin, const float i_inverseDirection,
+    float& io_enter, float& io_exit)
+  {
+    if (std::isinf(i_inverseDirection))
+      return i_origin >= i_min && i_origin <= i_max;
+
+    const float t1 = (i_min - i_origin) * i_inverseDirection;
+    const float t2 = (i_max - i_origin) * i_inverseDirection;
+    io_enter = std::max(io_enter, std::min(t1, t2));
+    io_exit = std::min(io_exit, std::max(t1, t2));
+    return true;
+  }
+
+  // Distance along the ray to the box, or infinity if it's missed within the max distance
+  float intersect(const BoundingBox& i_box, const Sdk::Vector3F& i_origin, const Sdk::Vector3F& i_inverseDirection, const float i_maxDistance)
+  {
+    float enter = 0;
+    float exit = i_maxDistance;
+    if (!clipSlab(i_box.min.x, i_box.max.x, i_origin.x, i_inverseDirection.x, enter, exit) ||
+      !clipSlab(i_box.min.y, i_box.max.y, i_origin.y, i_inverseDirection.y, enter, exit) ||
+      !clipSlab(i_box.min.z, i_box.max.z, i_origin.z, i_inverseDirection.z, enter, exit))
+    {
+      return std::numeric_limits<float>::infinity();
+    }
+    return enter <= exit ? enter : std::numeric_limits<float>::infinity();
+  }
+
+} // anonym NS
+
+
+ObjectBvh::ObjectBvh(const float i_margin)
+  : d_margin(i_margin)
+{
+  CONTRACT_EXPECT(i_margin >= 0);
+}
+
+
+int ObjectBvh::insert(const BoundingBox& i_box, const int i_tag)
+{
+  const int leaf = allocateNode();
+  auto& node = d_nodes[leaf];
+  node.objectBox = i_box;
+  node.box = i_box.getInflated({ d_margin, d_margin, d_margin });
+  node.tag = i_tag;
+
+  insertLeaf(leaf);
+  ++d_proxiesCount;
+  return leaf;
+}
+
+void ObjectBvh::remove(const int i_proxy)
+{
+  CONTRACT_EXPECT(d_nodes.at(i_proxy).isLeaf());
+  removeLeaf(i_proxy);
+  freeNode(i_proxy);
+  --d_proxiesCount;
+}
+
+bool ObjectBvh::update(const int i_proxy, const BoundingBox& i_box)
+{
+  auto& node = d_nodes.at(i_proxy);
+  CONTRACT_EXPECT(node.isLeaf());
+
+  node.objectBox = i_box;
+  if (contains(node.box, i_box))
+    return false;
+
+  removeLeaf(i_proxy);
+  d_nodes[i_proxy].box = i_box.getInflated({ d_margin, d_margin, d_margin });
+  insertLeaf(i_proxy);
+  return true;
+}
+
+void ObjectBvh::rebuild()
+{
+  std::vector<int> leaves;
+  leaves.reserve(d_proxiesCount);
+  for (int i = 0; i < (int)d_nodes.size(); ++i)
+  {
+    auto& node = d_nodes[i];
+    if (node.height < 0)
+      continue;
+
+    if (node.isLeaf())
+      leaves.push_back(i);
+    else
+      freeNode(i);
+  }
+
+  d_root = leaves.empty() ? -1 : build(leaves, 0, (int)leaves.size());
+  if (d_root >= 0)
+    d_nodes[d_root].parent = -1;
+}
+
+
+int ObjectBvh::getTag(const int i_proxy) const
+{
+  return d_nodes.at(i_proxy).tag;
+}
+
+int ObjectBvh::getProxiesCount() const
+{
+  return d_proxiesCount;
+}
+
+int ObjectBvh::getHeight() const
+{
+  return d_root >= 0 ? d_nodes[d_root].height : 0;
+}
+
+float ObjectBvh::getAreaRatio() const
+{
+  if (d_root < 0)
+    return 0;
+
+  float area = 0;
+  for (const auto& node : d_nodes)
+  {
+    if (node.height > 0)
+      area += getArea(node.box);
+  }
+  return area / getArea(d_nodes[d_root].box);
+}
+
+
+RayHit ObjectBvh::raycast(const Sdk::Vector3F& i_origin, const Sdk::Vector3F& i_direction, const float i_maxDistance) const
+{
+  RayHit hit;
+  if (d_root < 0)
+    return hit;
+
+  // Division by a zero component gives infinities, the slab test checks those axes apart
+  const Sdk::Vector3F inverseDirection = { 1 / i_direction.x, 1 / i_direction.y, 1 / i_direction.z };
+  float nearest = i_maxDistance;
+
+  d_stack.clear();
+  d_stack.push_back(d_root);
+  while (!d_stack.empty())
+  {
+    const auto& node = d_nodes[d_stack.back()];
+    d_stack.pop_back();
+
+    if (intersect(node.box, i_origin, inverseDirection, nearest) > nearest)
+      continue;
+
+    if (node.isLeaf())
+    {
+      const float distance = intersect(node.objectBox, i_origin, inverseDirection, nearest);
+      if (distance <= nearest)
+      {
+        nearest = distance;
+        hit = { node.tag, distance };
+      }
+      continue;
+    }
+
+    d_stack.push_back(node.left);
+    d_stack.push_back(node.right);
+  }
+
+  return hit;
+}
+
+void ObjectBvh::queryBox(const BoundingBox& i_box, const std::function<void(int)>& i_func) const
+{
+  query([&](const BoundingBox& i_nodeBox) { return overlaps(i_nodeBox, i_box); }, i_func);
+}
+
+void ObjectBvh::querySphere(const Sdk::Vector3F& i_center, const float i_radius, const std::function<void(int)>& i_func) const
+{
+  const float squaredRadius = i_radius * i_radius;
+  query([&](const BoundingBox& i_nodeBox) { return getSquaredDistance(i_nodeBox, i_center) <= squaredRadius; }, i_func);
+}
+
+void ObjectBvh::queryFrustum(const FrustumPlanes& i_planes, const std::function<void(int)>& i_func) const
+{
+  query([&](const BoundingBox& i_nodeBox) { return isInFrustum(i_nodeBox, i_planes); }, i_func);
+}
+
+template <typename TOverlaps>
+void ObjectBvh::query(TOverlaps&& i_overlaps, const std::function<void(int)>& i_func) const
+{
+  if (d_root < 0)
+    return;
+
+  d_stack.clear();
+  d_stack.push_back(d_root);
+  while (!d_stack.empty())
+  {
+    const auto& node = d_nodes[d_stack.back()];
+    d_stack.pop_back();
+
+    if (!i_overlaps(node.box))
+      continue;
+
+    if (node.isLeaf())
+    {
+      if (i_overlaps(node.objectBox))
+        i_func(node.tag);
+      continue;
+    }
+
+    d_stack.push_back(node.left);
+    d_stack.push_back(node.right);
+  }
+}
+
+
+int ObjectBvh::allocateNode()
+{
+  int index = d_freeNode;
+  if (index >= 0)
+    d_freeNode = d_nodes[index].parent;
+  else
+  {
+    index = (int)d_nodes.size();
+    d_nodes.emplace_back();
+  }
+
+  d_nodes[index] = Node();
+  return index;
+}
+
+void ObjectBvh::freeNode(const int i_node)
+{
+  // Negative height marks the free nodes
+  auto& node = d_nodes[i_node];
+  node.parent = d_freeNode;
+  node.height = -1;
+  d_freeNode = i_node;
+}
+
+
+void ObjectBvh::insertLeaf(const int i_leaf)
+{
+  if (d_root < 0)
+  {
+    d_root = i_leaf;
+    d_nodes[i_leaf].parent = -1;
+    return;
+  }
+
+  // Descends to the sibling with the least increase of the surface area of the tree
+  const auto leafBox = d_nodes[i_leaf].box;
+  int index = d_root;
+  while (!d_nodes[index].isLeaf())
+  {
+    const auto& node = d_nodes[index];
+    const float area = getArea(node.box);
+    const float combinedArea = getArea(combine(node.box, leafBox));
+
+    // Pairing with this node makes a new parent, going down grows this node anyway
+    const float cost = 2 * combinedArea;
+    const float inheritedCost = 2 * (combinedArea - area);
+
+    const auto getChildCost = [&](const int i_child) {
+      const auto& child = d_nodes[i_child];
+      const float childArea = getArea(combine(leafBox, child.box));
+      return (child.isLeaf() ? childArea : childArea - getArea(child.box)) + inheritedCost;
+    };
+    const float leftCost = getChildCost(node.left);
+    const float rightCost = getChildCost(node.right);
+
+    if (cost < leftCost && cost < rightCost)
+      break;
+    index = leftCost < rightCost ? node.left : node.right;
+  }
+
+  const int sibling = index;
+  const int oldParent = d_nodes[sibling].parent;
+  const int newParent = allocateNode();
+
+  auto& parentNode = d_nodes[newParent];
+  parentNode.parent = oldParent;
+  parentNode.box = combine(leafBox, d_nodes[sibling].box);
+  parentNode.height = d_nodes[sibling].height + 1;
+  parentNode.left = sibling;
+  parentNode.right = i_leaf;
+
+  if (oldParent >= 0)
+  {
+    auto& oldParentNode = d_nodes[oldParent];
+    (oldParentNode.left == sibling ? oldParentNode.left : oldParentNode.right) = newParent;
+  }
+  else
+    d_root = newParent;
+
+  d_nodes[sibling].parent = newParent;
+  d_nodes[i_leaf].parent = newParent;
+
+  refitUp(newParent);
+}
+
+void ObjectBvh::removeLeaf(const int i_leaf)
+{
+  if (i_leaf == d_root)
+  {
+    d_root = -1;
+    return;
+  }
+
+  const int parent = d_nodes[i_leaf].parent;
+  const int grandParent = d_nodes[parent].parent;
+  const int sibling = d_nodes[parent].left == i_leaf ? d_nodes[parent].right : d_nodes[parent].left;
+
+  if (grandParent >= 0)
+  {
+    auto& grandParentNode = d_nodes[grandParent];
+    (grandParentNode.left == parent ? grandParentNode.left : grandParentNode.right) = sibling;
+    d_nodes[sibling].parent = grandParent;
+    freeNode(parent);
+    refitUp(grandParent);
+  }
+  else
+  {
+    d_root = sibling;
+    d_nodes[sibling].parent = -1;
+    freeNode(parent);
+  }
+}
+
+void ObjectBvh::refitUp(int i_node)
+{
+  while (i_node >= 0)
+  {
+    i_node = balance(i_node);
+
+    auto& node = d_nodes[i_node];
+    const auto& left = d_nodes[node.left];
+    const auto& right = d_nodes[node.right];
+    node.height = 1 + std::max(left.height, right.height);
+    node.box = combine(left.box, right.box);
+
+    i_node = node.parent;
+  }
+}
+
+int ObjectBvh::balance(const int i_node)
+{
+  // AVL rotation: the higher child takes the node's place, and the node takes the lower
+  // of the grandchildren. Returns the node that is at the place now
+  auto& a = d_nodes[i_node];
+  if (a.isLeaf() || a.height < 2)
+    return i_node;
+
+  const int balanceFactor = d_nodes[a.right].height - d_nodes[a.left].height;
+  if (balanceFactor >= -1 && balanceFactor <= 1)
+    return i_node;
+
+  const bool rightUp = balanceFactor > 1;
+  const int up = rightUp ? a.right : a.left;
+  const int stay = rightUp ? a.left : a.right;
+  auto& upNode = d_nodes[up];
+  const int first = upNode.left;
+  const int second = upNode.right;
+
+  upNode.left = i_node;
+  upNode.parent = a.parent;
+  a.parent = up;
+
+  if (upNode.parent >= 0)
+  {
+    auto& parentNode = d_nodes[upNode.parent];
+    (parentNode.left == i_node ? parentNode.left : parentNode.right) = up;
+  }
+  else
+    d_root = up;
+
+  // The higher grandchild stays with the risen node, the lower one goes to the old node
+  const bool firstHigher = d_nodes[first].height > d_nodes[second].height;
+  const int kept = firstHigher ? first : second;
+  const int moved = firstHigher ? second : first;
+
+  upNode.right = kept;
+  (rightUp ? a.right : a.left) = moved;
+  d_nodes[moved].parent = i_node;
+
+  a.box = combine(d_nodes[stay].box, d_nodes[moved].box);
+  a.height = 1 + std::max(d_nodes[stay].height, d_nodes[moved].height);
+  upNode.box = combine(a.box, d_nodes[kept].box);
+  upNode.height = 1 + std::max(a.height, d_nodes[kept].height);
+  return up;
+}
+
+int ObjectBvh::build(std::vector<int>& io_leaves, const int i_begin, const int i_end)
+{
+  if (i_end - i_begin == 1)
+    return io_leaves[i_begin];
+
+  // Median split along the longest axis of the centers
+  BoundingBox centers{ d_nodes[io_leaves[i_begin]].box.getCenter(), d_nodes[io_leaves[i_begin]].box.getCenter() };
+  for (int i = i_begin; i < i_end; ++i)
+    centers.expand(d_nodes[io_leaves[i]].box.getCenter());
+
+  const auto size = centers.max - centers.min;
+  const auto getKey = [&](const int i_leaf) {
+    const auto center = d_nodes[i_leaf].box.getCenter();
+    if (size.x >= size.y && size.x >= size.z)
+      return center.x;
+    return size.y >= size.z ? center.y : center.z;
+  };
+
+  const int middle = (i_begin + i_end) / 2;
+  std::nth_element(io_leaves.begin() + i_begin, io_leaves.begin() + middle, io_leaves.begin() + i_end,
+    [&](const int i_left, const int i_right) { return getKey(i_left) < getKey(i_right); });
+
+  const int left = build(io_leaves, i_begin, middle);
+  const int right = build(io_leaves, middle, i_end);
+
+  const int index = allocateNode();
+  auto& node = d_nodes[index];
+  node.left = left;
+  node.right = right;
+  node.box = combine(d_nodes[left].box, d_nodes[right].box);
+  node.height = 1 + std::max(d_nodes[left].height, d_nodes[right].height);
+  d_nodes[left].parent = index;
+  d_nodes[right].parent = index;
+  return index;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "BoundingBox.h"
+#include "VisibilityCuller.h"
+
+#include <functional>
+#include <vector>
+
+
+struct RayHit
+{
+  int tag = -1;
+  float distance = 0;
+};
+
+
+// Dynamic AABB tree over objects, balanced by rotations as leaves are inserted. Leaves keep
+// a box grown by the margin, so objects moving within it don't change the tree; the ones
+// that leave it are removed and inserted again. Tags are the caller's ids of the objects
+class ObjectBvh
+{
+public:
+  ObjectBvh(float i_margin = 0.5f);
+
+  // Returns the proxy to update and remove the object with
+  int insert(const BoundingBox& i_box, int i_tag);
+  void remove(int i_proxy);
+  // Returns true if the object left its grown box and was reinserted
+  bool update(int i_proxy, const BoundingBox& i_box);
+  // Rebuilds the tree top-down from its leaves, for when the incremental changes made it worse
+  void rebuild();
+
+  int getTag(int i_proxy) const;
+  int getProxiesCount() const;
+  int getHeight() const;
+  // Sum of the areas of the inner nodes over the root's, the SAH cost of the tree
+  float getAreaRatio() const;
+
+  // Nearest hit of the objects' boxes. The direction is normalized
+  RayHit raycast(const Sdk::Vector3F& i_origin, const Sdk::Vector3F& i_direction, float i_maxDistance) const;
+  // The functions get the tags of the objects whose boxes intersect the volume
+  void queryBox(const BoundingBox& i_box, const std::function<void(int)>& i_func) const;
+  void querySphere(const Sdk::Vector3F& i_center, float i_radius, const std::function<void(int)>& i_func) const;
+  void queryFrustum(const FrustumPlanes& i_planes, const std::function<void(int)>& i_func) const;
+
+private:
+  struct Node
+  {
+    // Grown box for leaves
+    BoundingBox box;
+    BoundingBox objectBox;
+    int parent = -1;
+    int left = -1;
+    int right = -1;
+    int height = 0;
+    int tag = -1;
+
+    bool isLeaf() const { return left < 0; }
+  };
+
+  float d_margin = 0;
+  std::vector<Node> d_nodes;
+  int d_root = -1;
+  // Free nodes are linked through their parents
+  int d_freeNode = -1;
+  int d_proxiesCount = 0;
+  mutable std::vector<int> d_stack;
+
+  int allocateNode();
+  void freeNode(int i_node);
+
+  void insertLeaf(int i_leaf);
+  void removeLeaf(int i_leaf);
+  void refitUp(int i_node);
+  int balance(int i_node);
+  int build(std::vector<int>& io_leaves, int i_begin, int i_end);
+
+  template <typename TOverlaps>
+  void query(TOverlaps&& i_overlaps, const std::function<void(int)>& i_func) const;
+};
@@ -2,86 +2,256 @@
 #include "OceanLodController.h"
 
 #include <LaggyDx/IShape3d.h>
-#include <LaggyDx/ModelUtils.h>
-
-#include <LaggySdk/Size.h>
+#include <LaggyDx/Shape3d.h>
 
 
 namespace
 {
-  constexpr int Size = 5;
-  constexpr int CenterCoord = Size / 2;
+  constexpr int LevelsCount = 6;
+  constexpr float FinestCellSize = 0.1f;
+
+  // Cells per level side. Half of it has to be odd, so that the ring around
+  // the finer level has the same width on both sides
+  constexpr int LevelCellsCount = 126;
+  constexpr int HoleCellsCount = LevelCellsCount / 2 + 1;
+  constexpr int RingWidth = (LevelCellsCount - HoleCellsCount) / 2;
+
+  static_assert((LevelCellsCount / 2) % 2 == 1);
+
+
+  bool isInHole(const int i_x, const int i_z)
+  {
+    return
+      i_x >= RingWidth && i_x < RingWidth + HoleCellsCount &&
+      i_z >= RingWidth && i_z < RingWidth + HoleCellsCount;
+  }
 
-  std::vector<int> getLods()
+  // Square grid of unit cells on the XZ plane. If i_stitchBorder is set, odd vertices on the outer
+  // border are collapsed into the previous even ones, so the border matches a twice coarser grid
+  // and there are no T-junctions with the next level
+  std::shared_ptr<Dx::IShape3d> createGridShape(
+    const std::function<bool(int, int)>& i_includeCell, const bool i_stitchBorder)
   {
-    std::vector<int> lods(Size * Size, 2);
+    constexpr int Size = LevelCellsCount + 1;
+
+    auto remap = [&](int i_x, int i_z) {
+      if (i_stitchBorder)
+      {
+        if ((i_z == 0 || i_z == LevelCellsCount) && i_x % 2)
+          --i_x;
+        if ((i_x == 0 || i_x == LevelCellsCount) && i_z % 2)
+          --i_z;
+      }
+      return i_x + i_z * Size;
+    };
 
-    for (int y = 0; y < Size; ++y)
+    std::vector<int> gridInds;
+    for (int z = 0; z < LevelCellsCount; ++z)
     {
-      for (int x = 0; x < Size; ++x)
+      for (int x = 0; x < LevelCellsCount; ++x)
       {
-        auto set = [&](const int i_value) {
-          lods.at(x + y * Size) = i_value;
-        };
-
-        const int diffX = std::abs(x - CenterCoord);
-        const int diffY = std::abs(y - CenterCoord);
-        const int maxDist = std::max(diffX, diffY);
-
-        if (maxDist == 0)
-          set(0);
-        else if (maxDist <= 1)
-          set(1);
+        if (!i_includeCell(x, z))
+          continue;
+
+        const int a = remap(x, z);
+        const int b = remap(x + 1, z);
+        const int c = remap(x + 1, z + 1);
+        const int d = remap(x, z + 1);
+
+        for (const auto& tri : { std::array<int, 3>{ a, d, c }, std::array<int, 3>{ a, c, b } })
+        {
+          if (tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2])
+            continue;
+          gridInds.insert(gridInds.end(), tri.begin(), tri.end());
+        }
       }
     }
 
-    return lods;
+    auto shape = std::make_shared<Dx::Shape3d>();
+    auto& verts = shape->getVerts();
+    auto& inds = shape->getInds();
+
+    std::vector<int> vertexIndices(Size * Size, -1);
+    for (const int gridIndex : gridInds)
+      vertexIndices[gridIndex] = 0;
+
+    for (int gridIndex = 0; gridIndex < Size * Size; ++gridIndex)
+    {
+      if (vertexIndices[gridIndex] < 0)
+        continue;
+
+      const int x = gridIndex % Size;
+      const int z = gridIndex / Size;
+
+      Dx::VertexPosNormText vertex;
+      vertex.position = { (float)x, 0, (float)z };
+      vertex.normal = { 0, 1, 0 };
+      vertex.texture = { (float)x / LevelCellsCount, (float)z / LevelCellsCount };
+
+      vertexIndices[gridIndex] = (int)verts.size();
+      verts.push_back(vertex);
+    }
+
+    inds.reserve(gridInds.size());
+    for (const int gridIndex : gridInds)
+      inds.push_back(vertexIndices[gridIndex]);
+
+    return shape;
+  }
+
+  std::shared_ptr<Dx::IShape3d> createTrimShape(const bool i_highX, const bool i_highZ)
+  {
+    const int trimX = i_highX ? RingWidth + HoleCellsCount - 1 : RingWidth;
+    const int trimZ = i_highZ ? RingWidth + HoleCellsCount - 1 : RingWidth;
+
+    return createGridShape([&](const int i_x, const int i_z) {
+      return isInHole(i_x, i_z) && (i_x == trimX || i_z == trimZ);
+      }, false);
+  }
+
+  int getTrimIndex(const bool i_highX, const bool i_highZ)
+  {
+    return (i_highX ? 1 : 0) + (i_highZ ? 2 : 0);
+  }
+
+  float getCellSize(const int i_level)
+  {
+    return FinestCellSize * (1 << i_level);
+  }
+
+  double snapDown(const double i_value, const double i_step)
+  {
+    return std::floor(i_value / i_step) * i_step;
   }
 
 } // anonym NS
 
 
+int OceanLodController::getLevelsCount()
+{
+  return LevelsCount;
+}
+
+int OceanLodController::getLevelCellsCount()
+{
+  return LevelCellsCount;
+}
+
+float OceanLodController::getLevelCellSize(const int i_level)
+{
+  return getCellSize(i_level);
+}
+
+void OceanLodController::getPlacements(const Sdk::Vector3F& i_viewPosition, std::vector<LevelPlacement>& o_placements)
+{
+  o_placements.resize(LevelsCount);
+
+  // Every level origin is snapped to the vertices of the next coarser level. Coarser levels
+  // are placed relative to the finer ones, so the finer level is always off by at most
+  // one cell from the center of the hole, and the trim covers that cell
+  double originX = 0;
+  double originZ = 0;
+
+  for (int levelIndex = 0; levelIndex < LevelsCount; ++levelIndex)
+  {
+    auto& placement = o_placements[levelIndex];
+    const double cellSize = getCellSize(levelIndex);
+
+    if (levelIndex == 0)
+    {
+      const double halfSize = LevelCellsCount / 2 * cellSize;
+      originX = snapDown(i_viewPosition.x - halfSize, 2 * cellSize);
+      originZ = snapDown(i_viewPosition.z - halfSize, 2 * cellSize);
+      placement.visibleTrim = -1;
+    }
+    else
+    {
+      const double finerOriginX = originX;
+      const double finerOriginZ = originZ;
+      originX = snapDown(finerOriginX - RingWidth * cellSize, 2 * cellSize);
+      originZ = snapDown(finerOriginZ - RingWidth * cellSize, 2 * cellSize);
+
+      // The finer level is at the low side of the hole - the gap is at the high side
+      const bool highX = std::lround((finerOriginX - originX) / cellSize) == RingWidth;
+      const bool highZ = std::lround((finerOriginZ - originZ) / cellSize) == RingWidth;
+      placement.visibleTrim = getTrimIndex(highX, highZ);
+    }
+
+    placement.origin = { (float)originX, 0, (float)originZ };
+  }
+}
+
+
 const std::vector<std::shared_ptr<Dx::IObject3>>& OceanLodController::getObjects() const
 {
   return d_objects;
 }
 
+const MeshCache& OceanLodController::getMeshCache() const
+{
+  return d_meshCache;
+}
+
 
 void OceanLodController::createObjects(const Dx::IRenderDevice& i_renderDevice)
 {
-  constexpr float GridSize = 40;
-  constexpr float GridSizeHalf = GridSize / 2;
+  const auto finestShape = createGridShape([](int, int) { return true; }, true);
+  const auto ringShape = createGridShape([](const int i_x, const int i_z) {
+    return !isInHole(i_x, i_z);
+    }, true);
 
-  constexpr int GridResolutionMultiplier = 2;
-  constexpr float GridResolution1 = 0.1f;
-  constexpr float GridResolution2 = GridResolution1 * GridResolutionMultiplier;
-  constexpr float GridResolution4 = GridResolution2 * GridResolutionMultiplier;
+  std::array<std::shared_ptr<Dx::IShape3d>, 4> trimShapes;
+  for (const bool highX : { false, true })
+  {
+    for (const bool highZ : { false, true })
+      trimShapes[getTrimIndex(highX, highZ)] = createTrimShape(highX, highZ);
+  }
 
-  constexpr int GridPointsNumber1 = (int)(GridSize / GridResolution1) + 1;
-  constexpr int GridPointsNumber2 = (int)(GridSize / GridResolution2) + 1;
-  constexpr int GridPointsNumber4 = (int)(GridSize / GridResolution4) + 1;
 
-  const Sdk::Vector3F WorldCenter = { 100, 0, 100 };
+  for (int levelIndex = 0; levelIndex < LevelsCount; ++levelIndex)
+  {
+    const float cellSize = getCellSize(levelIndex);
+
+    Level level;
+    level.object = d_meshCache.createObject(levelIndex == 0 ? finestShape : ringShape, i_renderDevice);
+    level.object->setScale({ cellSize, 1, cellSize });
+    d_objects.push_back(level.object);
 
+    if (levelIndex > 0)
+    {
+      for (int trimIndex = 0; trimIndex < (int)trimShapes.size(); ++trimIndex)
+      {
+        auto& trim = level.trims[trimIndex];
+        trim = d_meshCache.createObject(trimShapes[trimIndex], i_renderDevice);
+        trim->setScale({ cellSize, 1, cellSize });
+        trim->setVisible(false);
+        d_objects.push_back(trim);
+      }
+    }
 
-  std::vector<std::shared_ptr<Dx::IShape3d>> shapes{
-    Dx::IShape3d::plane({ GridPointsNumber1, GridPointsNumber1 }, GridResolution1),
-    Dx::IShape3d::planeTesselatedBorder({ GridPointsNumber2, GridPointsNumber2 }, GridResolution2),
-    Dx::IShape3d::planeTesselatedBorder({ GridPointsNumber4, GridPointsNumber4 }, GridResolution4) };
+    d_levels.push_back(std::move(level));
+  }
+}
 
 
-  const auto lods = getLods();
+void OceanLodController::update(const Sdk::Vector3F& i_viewPosition)
+{
+  getPlacements(i_viewPosition, d_placements);
 
-  for (int y = 0; y < Size; ++y)
+  for (int levelIndex = 0; levelIndex < (int)d_levels.size(); ++levelIndex)
   {
-    for (int x = 0; x < Size; ++x)
+    auto& level = d_levels[levelIndex];
+    const auto& placement = d_placements[levelIndex];
+
+    for (int trimIndex = 0; trimIndex < (int)level.trims.size(); ++trimIndex)
     {
-      const auto& shape = *shapes.at(lods.at(x + y * Size));
-      auto obj = Dx::createObjectFromShape(shape, i_renderDevice, true);
-      obj->setPosition(WorldCenter - Sdk::Vector3F{ GridSizeHalf, 0, GridSizeHalf } +
-        Sdk::Vector3F{ GridSize * (x - CenterCoord), 0, GridSize * (y - CenterCoord) });
-      
-      d_objects.push_back(std::move(obj));
+      if (!level.trims[trimIndex])
+        continue;
+      auto& trim = *level.trims[trimIndex];
+      trim.setVisible(trimIndex == placement.visibleTrim);
+      trim.setPosition(placement.origin);
     }
+
+    level.object->setPosition(placement.origin);
   }
 }
@@ -1,15 +1,47 @@
 #pragma once
 
+#include "MeshCache.h"
+
 #include <LaggyDx/IObject3.h>
 
+#include <array>
+
 
+// Geometry clipmap: nested square levels, each twice coarser than the previous one,
+// following the view position. Every level is a single object whose mesh never changes,
+// only the levels' positions are updated when the view moves
 class OceanLodController
 {
 public:
+  struct LevelPlacement
+  {
+    Sdk::Vector3F origin;
+    // The one of the level's trims to show, none for the finest level
+    int visibleTrim = -1;
+  };
+
+  static int getLevelsCount();
+  static int getLevelCellsCount();
+  static float getLevelCellSize(int i_level);
+  // Where the levels go for the view position. Needs no objects, so it runs headless too
+  static void getPlacements(const Sdk::Vector3F& i_viewPosition, std::vector<LevelPlacement>& o_placements);
+
   void createObjects(const Dx::IRenderDevice& i_renderDevice);
+  void update(const Sdk::Vector3F& i_viewPosition);
 
   const std::vector<std::shared_ptr<Dx::IObject3>>& getObjects() const;
+  const MeshCache& getMeshCache() const;
 
 private:
+  struct Level
+  {
+    std::shared_ptr<Dx::IObject3> object;
+    // Fill the one-cell gap between the level and the finer one, one for every side combination
+    std::array<std::shared_ptr<Dx::IObject3>, 4> trims;
+  };
+
+  MeshCache d_meshCache;
+  std::vector<Level> d_levels;
   std::vector<std::shared_ptr<Dx::IObject3>> d_objects;
+  std::vector<LevelPlacement> d_placements;
 };
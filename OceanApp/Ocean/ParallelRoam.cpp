@@ -0,0 +1,441 @@
+#include "stdafx.h"
+#include "ParallelRoam.h"
+
+#include "HeightField.h"
+#include "MeshOptimizer.h"
+#include "RoamErrorPyramid.h"
+#include "ThreadPool.h"
+
+#include <LaggyDx/Shape3d.h>
+
+
+namespace
+{
+  // Nodes above this depth are spawned as separate tasks, deeper ones are processed inline
+  constexpr int SpawnDepth = 8;
+  constexpr int BucketsCount = 1 << (SpawnDepth + 1);
+
+  constexpr std::uint8_t Active = 1 << 0;
+  constexpr std::uint8_t RejectedA = 1 << 1;
+  constexpr std::uint8_t RejectedB = 1 << 2;
+
+  int getGridResolution(const int i_maxDepth)
+  {
+    // Every two bisections halve the grid step
+    return 1 << ((i_maxDepth + 1) / 2);
+  }
+
+} // anonym NS
+
+
+ParallelRoam::ParallelRoam(const float i_size, const int i_maxDepth, const RoamPredicate& i_pred, ThreadPool& i_pool)
+  : d_size(i_size)
+  , d_maxDepth(i_maxDepth)
+{
+  CONTRACT_EXPECT(i_size > 0);
+  CONTRACT_EXPECT(i_maxDepth > 0);
+
+  d_gridSize = getGridResolution(d_maxDepth) + 1;
+  d_heights.assign((size_t)d_gridSize * d_gridSize, 0.0f);
+
+  build(i_pred, i_pool);
+}
+
+ParallelRoam::ParallelRoam(const HeightField& i_heightField, const int i_maxDepth, const RoamPredicate& i_pred, ThreadPool& i_pool,
+  const RoamErrorPyramid* i_errorPyramid)
+  : d_size((float)(i_heightField.getWidth() - 1))
+  , d_maxDepth(i_maxDepth)
+  , d_errorPyramid(i_errorPyramid)
+{
+  CONTRACT_EXPECT(i_heightField.getWidth() > 1);
+  CONTRACT_EXPECT(i_maxDepth > 0);
+
+  d_gridSize = getGridResolution(d_maxDepth) + 1;
+  CONTRACT_EXPECT(!d_errorPyramid || d_errorPyramid->getGridSize() == d_gridSize);
+  d_heights.resize((size_t)d_gridSize * d_gridSize);
+
+  const float step = 1.0f / (d_gridSize - 1);
+  i_pool.parallelFor(0, d_gridSize, [&](const int i_z) {
+    i_heightField.sampleRow(i_z * step, d_gridSize, &d_heights[getIndex(0, i_z)]);
+    });
+
+  build(i_pred, i_pool);
+}
+
+
+const std::vector<Dx::VertexPosNormText>& ParallelRoam::getVerts() const
+{
+  return d_verts;
+}
+
+const std::vector<int>& ParallelRoam::getInds() const
+{
+  return d_inds;
+}
+
+
+int ParallelRoam::getPredicateCallsCount() const
+{
+  return d_predicateCallsCount.load();
+}
+
+int ParallelRoam::getPassesCount() const
+{
+  return d_passesCount;
+}
+
+// One triangle is made per predicate call, so these are not counted on the hot path
+int ParallelRoam::getErrorHeightReadsCount() const
+{
+  return d_errorPyramid ? 0 : getPredicateCallsCount();
+}
+
+int ParallelRoam::getPyramidLookupsCount() const
+{
+  return d_errorPyramid ? getPredicateCallsCount() : 0;
+}
+
+
+std::shared_ptr<Dx::IShape3d> ParallelRoam::createShape() const
+{
+  // Leaves come out in the recursive order, which reuses few vertices
+  auto shape = std::make_shared<Dx::Shape3d>();
+  shape->getVerts() = d_verts;
+  shape->getInds() = d_inds;
+  optimizeMesh(shape->getVerts(), shape->getInds());
+  return shape;
+}
+
+
+void ParallelRoam::build(const RoamPredicate& i_pred, ThreadPool& i_pool)
+{
+  d_flags = std::vector<std::atomic<std::uint8_t>>((size_t)d_gridSize * d_gridSize);
+
+  const int last = d_gridSize - 1;
+  activate(0, 0);
+  activate(last, 0);
+  activate(0, last);
+  activate(last, last);
+
+  // Every pass refines the tree with the predicate and then forces the splits required
+  // to keep the mesh crack-free. The set of split vertices only grows, so the result
+  // is the least fixed point and doesn't depend on the order of evaluation
+  do
+  {
+    d_changed = false;
+    ++d_passesCount;
+
+    for (int rootIndex = 0; rootIndex < 2; ++rootIndex)
+    {
+      i_pool.push([this, rootIndex, &i_pred, &i_pool]() {
+        refine(getRoot(rootIndex), i_pred, i_pool);
+        });
+    }
+    i_pool.wait();
+
+    closeDependencies(i_pool);
+  } while (d_changed);
+
+  createIndices(createVertices(i_pool), i_pool);
+}
+
+
+void ParallelRoam::refine(const Node& i_node, const RoamPredicate& i_pred, ThreadPool& i_pool)
+{
+  if (!canSplit(i_node))
+    return;
+
+  const int middle = getMiddle(i_node);
+  const int apexX = i_node.apex % d_gridSize;
+  const int apexZ = i_node.apex / d_gridSize;
+  const int middleX = middle % d_gridSize;
+  const int middleZ = middle / d_gridSize;
+  const auto rejectedBit = (apexX < middleX || (apexX == middleX && apexZ < middleZ)) ? RejectedA : RejectedB;
+
+  auto& flags = d_flags[middle];
+  const auto currentFlags = flags.load(std::memory_order_relaxed);
+  if (!(currentFlags & Active))
+  {
+    if (currentFlags & rejectedBit)
+      return;
+
+    d_predicateCallsCount.fetch_add(1, std::memory_order_relaxed);
+    if (!i_pred(getTri(i_node)))
+    {
+      flags.fetch_or(rejectedBit, std::memory_order_relaxed);
+      return;
+    }
+
+    if (!(flags.fetch_or(Active, std::memory_order_relaxed) & Active))
+      d_changed = true;
+  }
+
+  const auto [first, second] = split(i_node);
+  if (i_node.depth < SpawnDepth)
+  {
+    i_pool.push([this, first, &i_pred, &i_pool]() { refine(first, i_pred, i_pool); });
+    i_pool.push([this, second, &i_pred, &i_pool]() { refine(second, i_pred, i_pool); });
+  }
+  else
+  {
+    refine(first, i_pred, i_pool);
+    refine(second, i_pred, i_pool);
+  }
+}
+
+
+void ParallelRoam::closeDependencies(ThreadPool& i_pool)
+{
+  // Every split vertex requires both triangles of its diamond to exist, i.e. their apexes
+  // to be split as well. Parents are always coarser, so a single fine-to-coarse sweep is enough
+  const int resolution = d_gridSize - 1;
+  for (int step = 1; step < resolution; step *= 2)
+  {
+    const int rowsCount = resolution / step + 1;
+
+    // Vertices in the middle of horizontal or vertical edges. Parents are at the centers
+    // of the adjacent squares
+    i_pool.parallelFor(0, rowsCount, [&](const int i_row) {
+      const int z = i_row * step;
+      const bool oddRow = i_row % 2;
+      for (int x = oddRow ? 0 : step; x <= resolution; x += 2 * step)
+      {
+        if (!(d_flags[getIndex(x, z)].load(std::memory_order_relaxed) & Active))
+          continue;
+
+        if (oddRow)
+        {
+          if (x - step >= 0)
+            activate(x - step, z);
+          if (x + step <= resolution)
+            activate(x + step, z);
+        }
+        else
+        {
+          if (z - step >= 0)
+            activate(x, z - step);
+          if (z + step <= resolution)
+            activate(x, z + step);
+        }
+      }
+      });
+
+    // Vertices at the centers of squares. Parents are at the ends of the diagonal
+    // that is not the hypotenuse
+    i_pool.parallelFor(0, rowsCount, [&](const int i_row) {
+      if (i_row % 2 == 0)
+        return;
+
+      const int z = i_row * step;
+      for (int x = step; x <= resolution; x += 2 * step)
+      {
+        if (!(d_flags[getIndex(x, z)].load(std::memory_order_relaxed) & Active))
+          continue;
+
+        const int squareX = (x - step) / (2 * step);
+        const int squareZ = (z - step) / (2 * step);
+        if ((squareX + squareZ) % 2 == 0)
+        {
+          activate(x + step, z - step);
+          activate(x - step, z + step);
+        }
+        else
+        {
+          activate(x - step, z - step);
+          activate(x + step, z + step);
+        }
+      }
+      });
+  }
+}
+
+void ParallelRoam::activate(const int i_x, const int i_z)
+{
+  if (!(d_flags[getIndex(i_x, i_z)].fetch_or(Active, std::memory_order_relaxed) & Active))
+    d_changed = true;
+}
+
+
+void ParallelRoam::collectLeaves(const Node& i_node, std::vector<std::vector<int>>& o_buckets) const
+{
+  if (canSplit(i_node) && (d_flags[getMiddle(i_node)].load(std::memory_order_relaxed) & Active))
+  {
+    const auto [first, second] = split(i_node);
+    collectLeaves(first, o_buckets);
+    collectLeaves(second, o_buckets);
+    return;
+  }
+
+  const int bucket = i_node.depth <= SpawnDepth ?
+    i_node.path << (SpawnDepth - i_node.depth) : i_node.path;
+  auto& inds = o_buckets[bucket];
+  inds.push_back(i_node.apex);
+  inds.push_back(i_node.left);
+  inds.push_back(i_node.right);
+}
+
+std::vector<int> ParallelRoam::createVertices(ThreadPool& i_pool)
+{
+  // Vertices are numbered in the row-major order of the grid, which is deterministic
+  std::vector<int> rowCounts(d_gridSize);
+  i_pool.parallelFor(0, d_gridSize, [&](const int i_z) {
+    int count = 0;
+    for (int x = 0; x < d_gridSize; ++x)
+    {
+      if (d_flags[getIndex(x, i_z)].load(std::memory_order_relaxed) & Active)
+        ++count;
+    }
+    rowCounts[i_z] = count;
+    });
+
+  std::vector<int> rowOffsets(d_gridSize + 1, 0);
+  for (int z = 0; z < d_gridSize; ++z)
+    rowOffsets[z + 1] = rowOffsets[z] + rowCounts[z];
+
+  std::vector<int> vertexIndices(d_flags.size(), -1);
+  d_verts.resize(rowOffsets.back());
+
+  const float cellSize = d_size / (d_gridSize - 1);
+  i_pool.parallelFor(0, d_gridSize, [&](const int i_z) {
+    int vertexIndex = rowOffsets[i_z];
+    for (int x = 0; x < d_gridSize; ++x)
+    {
+      const int gridIndex = getIndex(x, i_z);
+      if (!(d_flags[gridIndex].load(std::memory_order_relaxed) & Active))
+        continue;
+
+      const int x0 = std::max(x - 1, 0);
+      const int x1 = std::min(x + 1, d_gridSize - 1);
+      const int z0 = std::max(i_z - 1, 0);
+      const int z1 = std::min(i_z + 1, d_gridSize - 1);
+      const float dx = (d_heights[getIndex(x1, i_z)] - d_heights[getIndex(x0, i_z)]) / ((x1 - x0) * cellSize);
+      const float dz = (d_heights[getIndex(x, z1)] - d_heights[getIndex(x, z0)]) / ((z1 - z0) * cellSize);
+
+      auto& vertex = d_verts[vertexIndex];
+      vertex.position = getPosition(gridIndex);
+      vertex.normal = Sdk::Vector3F{ -dx, 1, -dz }.getNormalized();
+      vertex.texture = { (float)x / (d_gridSize - 1), (float)i_z / (d_gridSize - 1) };
+
+      vertexIndices[gridIndex] = vertexIndex++;
+    }
+    });
+
+  return vertexIndices;
+}
+
+void ParallelRoam::createIndices(const std::vector<int>& i_vertexIndices, ThreadPool& i_pool)
+{
+  std::vector<std::vector<int>> buckets(BucketsCount);
+
+  // Walk the shallow part of the tree on this thread and hand every subtree at the
+  // spawn depth to the pool. Each subtree writes only to its own bucket
+  std::vector<Node> nodes{ getRoot(0), getRoot(1) };
+  std::vector<Node> subtrees;
+  while (!nodes.empty())
+  {
+    const auto node = nodes.back();
+    nodes.pop_back();
+
+    const bool isSplit = canSplit(node) &&
+      (d_flags[getMiddle(node)].load(std::memory_order_relaxed) & Active);
+    if (node.depth >= SpawnDepth || !isSplit)
+    {
+      subtrees.push_back(node);
+      continue;
+    }
+
+    const auto [first, second] = split(node);
+    nodes.push_back(first);
+    nodes.push_back(second);
+  }
+
+  i_pool.parallelFor(0, (int)subtrees.size(), [&](const int i_index) {
+    collectLeaves(subtrees[i_index], buckets);
+    });
+
+  size_t indsCount = 0;
+  for (const auto& bucket : buckets)
+    indsCount += bucket.size();
+
+  d_inds.clear();
+  d_inds.reserve(indsCount);
+  for (const auto& bucket : buckets)
+  {
+    for (const int gridIndex : bucket)
+      d_inds.push_back(i_vertexIndices[gridIndex]);
+  }
+}
+
+
+ParallelRoam::Node ParallelRoam::getRoot(const int i_index) const
+{
+  const int last = d_gridSize - 1;
+  if (i_index == 0)
+    return { getIndex(last, 0), getIndex(0, 0), getIndex(last, last), 0, 0 };
+  return { getIndex(0, last), getIndex(last, last), getIndex(0, 0), 0, 1 };
+}
+
+std::pair<ParallelRoam::Node, ParallelRoam::Node> ParallelRoam::split(const Node& i_node) const
+{
+  // Children keep the clockwise winding of the parent
+  const int middle = getMiddle(i_node);
+  const int depth = i_node.depth + 1;
+  const int path = i_node.depth < SpawnDepth ? i_node.path * 2 : i_node.path;
+  const int pathSecond = i_node.depth < SpawnDepth ? path + 1 : path;
+
+  return {
+    Node{ middle, i_node.apex, i_node.left, depth, path },
+    Node{ middle, i_node.right, i_node.apex, depth, pathSecond } };
+}
+
+bool ParallelRoam::canSplit(const Node& i_node) const
+{
+  return i_node.depth < d_maxDepth;
+}
+
+int ParallelRoam::getMiddle(const Node& i_node) const
+{
+  const int x = (i_node.left % d_gridSize + i_node.right % d_gridSize) / 2;
+  const int z = (i_node.left / d_gridSize + i_node.right / d_gridSize) / 2;
+  return getIndex(x, z);
+}
+
+
+int ParallelRoam::getIndex(const int i_x, const int i_z) const
+{
+  return i_x + i_z * d_gridSize;
+}
+
+Sdk::Vector3F ParallelRoam::getPosition(const int i_index) const
+{
+  const float cellSize = d_size / (d_gridSize - 1);
+  return {
+    (i_index % d_gridSize) * cellSize,
+    d_heights[i_index],
+    (i_index / d_gridSize) * cellSize };
+}
+
+RoamTri ParallelRoam::getTri(const Node& i_node) const
+{
+  RoamTri tri;
+  tri.depth = i_node.depth;
+  tri.apex = getPosition(i_node.apex);
+  tri.left = getPosition(i_node.left);
+  tri.right = getPosition(i_node.right);
+
+  if (d_errorPyramid)
+  {
+    // Bounds of the diamond, they cover both triangles sharing the hypotenuse
+    const int middle = getMiddle(i_node);
+    tri.heightDiff = d_errorPyramid->getError(middle);
+    tri.minHeight = d_errorPyramid->getMinHeight(middle);
+    tri.maxHeight = d_errorPyramid->getMaxHeight(middle);
+    return tri;
+  }
+
+  const float middleHeight = d_heights[getMiddle(i_node)];
+  tri.heightDiff = std::abs(middleHeight - (tri.left.y + tri.right.y) / 2);
+  tri.minHeight = std::min({ tri.apex.y, tri.left.y, tri.right.y });
+  tri.maxHeight = std::max({ tri.apex.y, tri.left.y, tri.right.y });
+  return tri;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <LaggyDx/LaggyDxFwd.h>
+#include <LaggyDx/VertexTypes.h>
+
+#include <LaggySdk/Vector.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+
+class HeightField;
+class RoamErrorPyramid;
+class ThreadPool;
+
+
+struct RoamTri
+{
+  int depth = 0;
+
+  Sdk::Vector3F apex;
+  Sdk::Vector3F left;
+  Sdk::Vector3F right;
+
+  // Difference between the real height in the middle of the hypotenuse and the interpolated one.
+  // With an error pyramid it's the largest difference in the whole subtree of the triangle
+  float heightDiff = 0;
+  // Height range of the triangle, of its whole subtree with an error pyramid
+  float minHeight = 0;
+  float maxHeight = 0;
+};
+
+using RoamPredicate = std::function<bool(const RoamTri&)>;
+
+
+// ROAM bintree over a square regular grid. Split decisions are evaluated in parallel,
+// independent subtrees are distributed over the pool. Crack-free result is guaranteed by
+// closing the set of split vertices over their dependencies (4-8 mesh).
+// The output order does not depend on the threads count, so the same predicate always
+// produces the same mesh.
+class ParallelRoam
+{
+public:
+  // Flat square plane of the given size
+  ParallelRoam(float i_size, int i_maxDepth, const RoamPredicate& i_pred, ThreadPool& i_pool);
+  // Heights are taken from the height field, 1 texel = 1 meter. The error pyramid, if any, has
+  // to be built over the same grid, i.e. a height field of 2^((maxDepth + 1) / 2) + 1 texels
+  ParallelRoam(const HeightField& i_heightField, int i_maxDepth, const RoamPredicate& i_pred, ThreadPool& i_pool,
+    const RoamErrorPyramid* i_errorPyramid = nullptr);
+
+  const std::vector<Dx::VertexPosNormText>& getVerts() const;
+  const std::vector<int>& getInds() const;
+
+  // Number of predicate evaluations and refinement passes used to build the mesh
+  int getPredicateCallsCount() const;
+  int getPassesCount() const;
+  // Heights read only for the split errors, and the error pyramid lookups made instead. The
+  // corners are read for every predicate call either way, so they're not counted
+  int getErrorHeightReadsCount() const;
+  int getPyramidLookupsCount() const;
+
+  std::shared_ptr<Dx::IShape3d> createShape() const;
+
+private:
+  struct Node
+  {
+    int apex = 0;
+    int left = 0;
+    int right = 0;
+    int depth = 0;
+    int path = 0;
+  };
+
+  float d_size = 0;
+  int d_gridSize = 0;
+  int d_maxDepth = 0;
+  std::vector<float> d_heights;
+  const RoamErrorPyramid* d_errorPyramid = nullptr;
+
+  std::vector<std::atomic<std::uint8_t>> d_flags;
+  std::atomic<bool> d_changed = false;
+  std::atomic<int> d_predicateCallsCount = 0;
+  int d_passesCount = 0;
+
+  std::vector<Dx::VertexPosNormText> d_verts;
+  std::vector<int> d_inds;
+
+  void build(const RoamPredicate& i_pred, ThreadPool& i_pool);
+
+  void refine(const Node& i_node, const RoamPredicate& i_pred, ThreadPool& i_pool);
+  void closeDependencies(ThreadPool& i_pool);
+  void activate(int i_x, int i_z);
+
+  void collectLeaves(const Node& i_node, std::vector<std::vector<int>>& o_buckets) const;
+  std::vector<int> createVertices(ThreadPool& i_pool);
+  void createIndices(const std::vector<int>& i_vertexIndices, ThreadPool& i_pool);
+
+  Node getRoot(int i_index) const;
+  std::pair<Node, Node> split(const Node& i_node) const;
+  bool canSplit(const Node& i_node) const;
+  int getMiddle(const Node& i_node) const;
+
+  int getIndex(int i_x, int i_z) const;
+  Sdk::Vector3F getPosition(int i_index) const;
+  RoamTri getTri(const Node& i_node) const;
+};
@@ -0,0 +1,282 @@
+#include "stdafx.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <thread>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define PROFILER_USE_TSC
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+
+namespace
+{
+  void writeJsonString(std::ofstream& io_stream, const char* i_string)
+  {
+    io_stream << '"';
+    for (const char* c = i_string; *c; ++c)
+    {
+      if (*c == '"' || *c == '\\')
+        io_stream << '\\' << *c;
+      else if ((unsigned char)*c < 0x20)
+        io_stream << ' ';
+      else
+        io_stream << *c;
+    }
+    io_stream << '"';
+  }
+
+} // anonym NS
+
+
+std::atomic<bool> Profiler::s_enabled = false;
+
+
+Profiler::Profiler()
+  : d_startTicks(getNowTicks())
+  , d_startTime(std::chrono::steady_clock::now())
+{
+}
+
+
+Profiler& Profiler::get()
+{
+  static Profiler profiler;
+  return profiler;
+}
+
+
+bool Profiler::isEnabled()
+{
+  return s_enabled.load(std::memory_order_relaxed);
+}
+
+void Profiler::setEnabled(const bool i_enabled)
+{
+  s_enabled.store(i_enabled, std::memory_order_relaxed);
+}
+
+
+const char* Profiler::intern(const std::string& i_name)
+{
+  std::lock_guard lock(d_mutex);
+  return d_names.insert(i_name).first->c_str();
+}
+
+
+std::int64_t Profiler::getNowTicks()
+{
+#ifdef PROFILER_USE_TSC
+  return (std::int64_t)__rdtsc();
+#else
+  return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+double Profiler::getNsPerTick() const
+{
+#ifdef PROFILER_USE_TSC
+  const auto ticks = getNowTicks() - d_startTicks;
+  const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - d_startTime).count();
+  return ticks > 0 ? ns / ticks : 1.0;
+#else
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::duration(1)).count();
+#endif
+}
+
+void Profiler::Slot::store(const Event& i_event)
+{
+  name.store(i_event.name, std::memory_order_relaxed);
+  startTicks.store(i_event.startTicks, std::memory_order_relaxed);
+  durationTicks.store(i_event.durationTicks, std::memory_order_relaxed);
+}
+
+Profiler::Event Profiler::Slot::load() const
+{
+  return {
+    name.load(std::memory_order_relaxed),
+    startTicks.load(std::memory_order_relaxed),
+    durationTicks.load(std::memory_order_relaxed) };
+}
+
+
+void Profiler::addEvent(const Event& i_event)
+{
+  auto& buffer = getThreadBuffer();
+
+  // Sequentially consistent, against the same pair in writeChromeTrace(): either the thread
+  // sees the pause, or the trace waits for the thread to finish the event
+  buffer.writing.store(true);
+  if (!d_paused.load())
+  {
+    const auto index = buffer.writtenCount.load(std::memory_order_relaxed);
+    // Pairs with the fence in endFrame(): whoever reads this event over an older one sees
+    // the count up to index at least
+    std::atomic_thread_fence(std::memory_order_release);
+    buffer.events[index % RingSize].store(i_event);
+    buffer.writtenCount.store(index + 1, std::memory_order_release);
+  }
+  buffer.writing.store(false, std::memory_order_release);
+}
+
+Profiler::ThreadBuffer& Profiler::getThreadBuffer()
+{
+  thread_local ThreadBuffer* t_buffer = nullptr;
+  if (t_buffer)
+    return *t_buffer;
+
+  // Once per thread. Buffers stay alive until the end, so the threads that are gone
+  // still show up in the trace
+  auto buffer = std::make_unique<ThreadBuffer>();
+  buffer->events = std::make_unique<Slot[]>(RingSize);
+
+  std::lock_guard lock(d_mutex);
+  buffer->threadId = (int)d_buffers.size();
+  t_buffer = buffer.get();
+  d_buffers.push_back(std::move(buffer));
+  return *t_buffer;
+}
+
+
+void Profiler::endFrame()
+{
+  const double msPerTick = getNsPerTick() * 1e-6;
+  for (auto& stats : d_frameStats)
+  {
+    stats.ms = 0;
+    stats.callsCount = 0;
+  }
+
+  {
+    std::lock_guard lock(d_mutex);
+    for (auto& buffer : d_buffers)
+    {
+      const auto writtenCount = buffer->writtenCount.load(std::memory_order_acquire);
+      const auto firstCount = std::max(buffer->frameStartCount, writtenCount > RingSize ? writtenCount - RingSize : 0);
+
+      d_frameEvents.clear();
+      for (auto index = firstCount; index < writtenCount; ++index)
+        d_frameEvents.push_back(buffer->events[index % RingSize].load());
+
+      // The thread keeps writing, and may have wrapped around onto the slots while they were
+      // copied. An event is intact if its slot's next write hadn't started, the one of the
+      // event RingSize later: the count read now is at most that event's index
+      std::atomic_thread_fence(std::memory_order_acquire);
+      const auto recheckedCount = buffer->writtenCount.load(std::memory_order_relaxed);
+      const auto intactCount = recheckedCount >= RingSize ? recheckedCount - RingSize + 1 : 0;
+
+      for (auto index = std::max(firstCount, intactCount); index < writtenCount; ++index)
+      {
+        const auto& event = d_frameEvents[index - firstCount];
+        auto it = std::find_if(d_frameStats.begin(), d_frameStats.end(), [&](const ScopeStats& i_stats) {
+          return i_stats.name == event.name || std::strcmp(i_stats.name, event.name) == 0;
+          });
+        if (it == d_frameStats.end())
+          it = d_frameStats.insert(d_frameStats.end(), { event.name, 0, 0 });
+
+        it->ms += event.durationTicks * msPerTick;
+        ++it->callsCount;
+      }
+
+      buffer->frameStartCount = writtenCount;
+    }
+  }
+
+  // Scopes are few, and the ones not seen for a frame are dropped
+  d_frameStats.erase(std::remove_if(d_frameStats.begin(), d_frameStats.end(), [](const ScopeStats& i_stats) {
+    return i_stats.callsCount == 0;
+    }), d_frameStats.end());
+  std::sort(d_frameStats.begin(), d_frameStats.end(), [](const ScopeStats& i_left, const ScopeStats& i_right) {
+    return i_left.ms > i_right.ms;
+    });
+}
+
+const std::vector<Profiler::ScopeStats>& Profiler::getFrameStats() const
+{
+  return d_frameStats;
+}
+
+
+bool Profiler::writeChromeTrace(const std::string& i_path)
+{
+  const auto folder = std::filesystem::path(i_path).parent_path();
+  std::error_code error;
+  if (!folder.empty())
+    std::filesystem::create_directories(folder, error);
+
+  std::ofstream stream(i_path, std::ios::trunc);
+  if (!stream)
+    return false;
+
+  const double usPerTick = getNsPerTick() * 1e-3;
+  stream << std::fixed << std::setprecision(1);
+  stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+
+  std::lock_guard lock(d_mutex);
+  d_paused.store(true);
+  for (const auto& buffer : d_buffers)
+  {
+    while (buffer->writing.load())
+      std::this_thread::yield();
+  }
+
+  for (const auto& buffer : d_buffers)
+  {
+    const auto writtenCount = buffer->writtenCount.load(std::memory_order_acquire);
+    const auto firstCount = writtenCount > RingSize ? writtenCount - RingSize : 0;
+
+    for (auto index = firstCount; index < writtenCount; ++index)
+    {
+      const auto event = buffer->events[index % RingSize].load();
+      stream << (first ? "\n" : ",\n");
+      first = false;
+
+      // Complete events, in microseconds from the profiler's start
+      stream << "{\"name\":";
+      writeJsonString(stream, event.name);
+      stream << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId <<
+        ",\"ts\":" << (event.startTicks - d_startTicks) * usPerTick <<
+        ",\"dur\":" << event.durationTicks * usPerTick << "}";
+    }
+  }
+
+  d_paused.store(false, std::memory_order_release);
+
+  stream << "\n]}\n";
+  return (bool)stream;
+}
+
+
+ProfileScope::ProfileScope(const char* i_name)
+{
+  if (!Profiler::isEnabled())
+    return;
+
+  d_name = i_name;
+  d_startTicks = Profiler::getNowTicks();
+}
+
+ProfileScope::ProfileScope(const std::string& i_name)
+  : ProfileScope(Profiler::isEnabled() ? Profiler::get().intern(i_name) : nullptr)
+{
+}
+
+ProfileScope::~ProfileScope()
+{
+  if (!d_name)
+    return;
+
+  // Scopes still open when the profiler is disabled are recorded anyway
+  Profiler::get().addEvent({ d_name, d_startTicks, Profiler::getNowTicks() - d_startTicks });
+}
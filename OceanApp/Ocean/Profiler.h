@@ -0,0 +1,126 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+
+// CPU profiler of named scopes. Every thread writes its finished scopes into a ring buffer
+// of its own, so recording takes no locks. Disabled, a scope costs a relaxed atomic load,
+// and no buffers are allocated
+class Profiler
+{
+public:
+  struct Event
+  {
+    // Names must outlive the profiler: literals or intern()-ed strings
+    const char* name = nullptr;
+    std::int64_t startTicks = 0;
+    std::int64_t durationTicks = 0;
+  };
+
+  struct ScopeStats
+  {
+    const char* name = nullptr;
+    // Inclusive of the nested scopes, summed over the calls and the threads
+    double ms = 0;
+    int callsCount = 0;
+  };
+
+  // Events kept per thread, the trace covers the last ones
+  static constexpr int RingSize = 1 << 15;
+
+  static Profiler& get();
+
+  static bool isEnabled();
+  void setEnabled(bool i_enabled);
+
+  // Strings of a static lifetime for the names built at runtime
+  const char* intern(const std::string& i_name);
+
+  // Called by the scopes. Ticks are the TSC where there is one, it's cheaper to read than
+  // the steady clock. They are converted to time against the steady clock
+  static std::int64_t getNowTicks();
+  void addEvent(const Event& i_event);
+
+  // Called from the main thread once a frame. Sums up the scopes finished since the last call
+  void endFrame();
+  // Sorted by time, the slowest first
+  const std::vector<ScopeStats>& getFrameStats() const;
+
+  // Chrome trace of the events still in the ring buffers, for chrome://tracing or Perfetto.
+  // Recording is paused meanwhile, the scopes finished during the writing are dropped
+  bool writeChromeTrace(const std::string& i_path);
+
+private:
+  // Relaxed atomics, endFrame() reads the slots while their thread may be overwriting them
+  struct Slot
+  {
+    std::atomic<const char*> name = nullptr;
+    std::atomic<std::int64_t> startTicks = 0;
+    std::atomic<std::int64_t> durationTicks = 0;
+
+    void store(const Event& i_event);
+    Event load() const;
+  };
+
+  struct ThreadBuffer
+  {
+    int threadId = 0;
+    std::unique_ptr<Slot[]> events;
+    // Events written in total, the next one goes to writtenCount % RingSize
+    std::atomic<std::uint64_t> writtenCount = 0;
+    // Written before the last endFrame()
+    std::uint64_t frameStartCount = 0;
+    // The thread is in addEvent()
+    std::atomic<bool> writing = false;
+  };
+
+  static std::atomic<bool> s_enabled;
+  // Set while the trace is written, no thread writes to its ring then
+  std::atomic<bool> d_paused = false;
+
+  // Same moment by both clocks
+  const std::int64_t d_startTicks;
+  const std::chrono::steady_clock::time_point d_startTime;
+
+  mutable std::mutex d_mutex;
+  std::vector<std::unique_ptr<ThreadBuffer>> d_buffers;
+  std::unordered_set<std::string> d_names;
+  std::vector<ScopeStats> d_frameStats;
+  // Reused by endFrame()
+  std::vector<Event> d_frameEvents;
+
+  Profiler();
+
+  ThreadBuffer& getThreadBuffer();
+  // Calibrated over the whole time since the start, so it's more precise the longer it runs
+  double getNsPerTick() const;
+};
+
+
+// Records the time from its creation to its destruction, if the profiler is enabled
+class ProfileScope
+{
+public:
+  ProfileScope(const char* i_name);
+  // Interned only when the profiler is enabled
+  ProfileScope(const std::string& i_name);
+  ~ProfileScope();
+
+  ProfileScope(const ProfileScope&) = delete;
+  ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+  const char* d_name = nullptr;
+  std::int64_t d_startTicks = 0;
+};
+
+#define PROFILE_SCOPE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_SCOPE_CONCAT(a, b) PROFILE_SCOPE_CONCAT_IMPL(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_SCOPE_CONCAT(profileScope, __LINE__)(name)
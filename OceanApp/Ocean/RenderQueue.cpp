@@ -0,0 +1,151 @@
+#include "stdafx.h"
+#include "RenderQueue.h"
+
+#include <array>
+#include <cstring>
+
+
+namespace
+{
+  constexpr int PassShift = 60;
+  constexpr int ShaderShift = 56;
+  constexpr int MaterialShift = 32;
+  constexpr std::uint64_t MaterialMask = (1ull << RenderQueue::MaterialBits) - 1;
+
+  // State is everything above the depth
+  std::uint64_t getState(const std::uint64_t i_key)
+  {
+    return i_key >> MaterialShift;
+  }
+
+  int countStateChanges(const std::vector<RenderCommand>& i_commands)
+  {
+    int count = 0;
+    for (int i = 0; i < (int)i_commands.size(); ++i)
+    {
+      const auto state = getState(i_commands[i].key);
+      if (i == 0)
+      {
+        count += 2;
+        continue;
+      }
+
+      const auto previousState = getState(i_commands[i - 1].key);
+      if (RenderQueue::getShader(i_commands[i].key) != RenderQueue::getShader(i_commands[i - 1].key))
+        ++count;
+      if ((state & MaterialMask) != (previousState & MaterialMask))
+        ++count;
+    }
+    return count;
+  }
+
+} // anonym NS
+
+
+std::uint64_t RenderQueue::makeKey(const RenderPass i_pass, const RenderShader i_shader, const int i_materialId, const float i_depth)
+{
+  CONTRACT_EXPECT(i_materialId >= 0 && i_materialId <= (int)MaterialMask);
+
+  // Bits of a non-negative float grow with its value
+  std::uint32_t depthBits = 0;
+  const float depth = std::max(i_depth, 0.0f);
+  std::memcpy(&depthBits, &depth, sizeof(depthBits));
+  if (i_pass == RenderPass::Water)
+    depthBits = ~depthBits;
+
+  return
+    ((std::uint64_t)i_pass << PassShift) |
+    ((std::uint64_t)i_shader << ShaderShift) |
+    ((std::uint64_t)i_materialId << MaterialShift) |
+    depthBits;
+}
+
+RenderPass RenderQueue::getPass(const std::uint64_t i_key)
+{
+  return (RenderPass)(i_key >> PassShift);
+}
+
+RenderShader RenderQueue::getShader(const std::uint64_t i_key)
+{
+  return (RenderShader)((i_key >> ShaderShift) & 0xf);
+}
+
+int RenderQueue::getMaterialId(const std::uint64_t i_key)
+{
+  return (int)((i_key >> MaterialShift) & MaterialMask);
+}
+
+
+void RenderQueue::clear()
+{
+  // Capacities are kept, so recording every frame doesn't allocate
+  d_commands.clear();
+  d_recordedStateChangesCount = 0;
+  d_stateChangesCount = 0;
+}
+
+void RenderQueue::add(const RenderPass i_pass, const RenderShader i_shader, const int i_materialId, const float i_depth, const int i_payload)
+{
+  d_commands.push_back({ makeKey(i_pass, i_shader, i_materialId, i_depth), i_payload });
+}
+
+void RenderQueue::append(const RenderQueue& i_queue, const int i_payloadOffset)
+{
+  for (const auto& command : i_queue.d_commands)
+    d_commands.push_back({ command.key, command.payload + i_payloadOffset });
+}
+
+
+void RenderQueue::sort()
+{
+  d_recordedStateChangesCount = countStateChanges(d_commands);
+
+  const int count = (int)d_commands.size();
+  d_scratch.resize(count);
+
+  // All the histograms in one go
+  std::array<std::array<int, 256>, 8> counts{};
+  for (const auto& command : d_commands)
+  {
+    for (int digit = 0; digit < 8; ++digit)
+      ++counts[digit][(command.key >> (digit * 8)) & 0xff];
+  }
+
+  for (int digit = 0; digit < 8; ++digit)
+  {
+    auto& digitCounts = counts[digit];
+    if (count == 0 || digitCounts[(d_commands.front().key >> (digit * 8)) & 0xff] == count)
+      continue;
+
+    int offset = 0;
+    for (auto& digitCount : digitCounts)
+    {
+      const int bucketCount = digitCount;
+      digitCount = offset;
+      offset += bucketCount;
+    }
+
+    for (const auto& command : d_commands)
+      d_scratch[digitCounts[(command.key >> (digit * 8)) & 0xff]++] = command;
+    d_commands.swap(d_scratch);
+  }
+
+  d_stateChangesCount = countStateChanges(d_commands);
+}
+
+
+const std::vector<RenderCommand>& RenderQueue::getCommands() const
+{
+  return d_commands;
+}
+
+
+int RenderQueue::getRecordedStateChangesCount() const
+{
+  return d_recordedStateChangesCount;
+}
+
+int RenderQueue::getStateChangesCount() const
+{
+  return d_stateChangesCount;
+}
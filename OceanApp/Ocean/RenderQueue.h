@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+
+// Passes are drawn in this order
+enum class RenderPass : std::uint8_t
+{
+  Sky,
+  Opaque,
+  // Transparent, drawn back to front
+  Water,
+  Overlay,
+};
+
+enum class RenderShader : std::uint8_t
+{
+  Skydome,
+  Simple,
+  Ocean,
+};
+
+struct RenderCommand
+{
+  std::uint64_t key = 0;
+  // The caller's id of what to draw
+  int payload = 0;
+};
+
+
+// Draws of a frame as commands with 64-bit sort keys: pass, shader, material, depth from
+// the most significant bits down. After sort() the commands of a pass are grouped by shader
+// and material, opaque ones front to back and transparent ones back to front, so a submitter
+// only has to rebind what differs from the previous command
+class RenderQueue
+{
+public:
+  static constexpr int MaterialBits = 24;
+
+  static std::uint64_t makeKey(RenderPass i_pass, RenderShader i_shader, int i_materialId, float i_depth);
+  static RenderPass getPass(std::uint64_t i_key);
+  static RenderShader getShader(std::uint64_t i_key);
+  static int getMaterialId(std::uint64_t i_key);
+
+  void clear();
+  // Depth is the distance from the camera, or anything growing with it
+  void add(RenderPass i_pass, RenderShader i_shader, int i_materialId, float i_depth, int i_payload);
+  // For queues recorded in parallel. Payloads of the appended commands are offset by i_payloadOffset
+  void append(const RenderQueue& i_queue, int i_payloadOffset);
+
+  // LSD radix sort of the keys, 8 bits a pass. Passes where all the keys have the same
+  // byte are skipped. Stable
+  void sort();
+
+  const std::vector<RenderCommand>& getCommands() const;
+
+  // Shader and material changes between the consecutive commands, the first command included,
+  // as of the last sort(). In the recorded order it's what the frame would cost without the queue
+  int getRecordedStateChangesCount() const;
+  int getStateChangesCount() const;
+
+private:
+  std::vector<RenderCommand> d_commands;
+  std::vector<RenderCommand> d_scratch;
+  int d_recordedStateChangesCount = 0;
+  int d_stateChangesCount = 0;
+};
@@ -0,0 +1,182 @@
+#include "stdafx.h"
+#include "RoamErrorPyramid.h"
+
+#include "HeightField.h"
+#include "MappedFile.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+
+namespace
+{
+  constexpr std::uint32_t FormatVersion = 2;
+  constexpr char Magic[4] = { 'O', 'E', 'R', 'P' };
+
+  struct Header
+  {
+    char magic[4];
+    std::uint32_t version;
+    std::int32_t gridSize;
+    std::int32_t padding;
+  };
+
+} // anonym NS
+
+
+RoamErrorPyramid::RoamErrorPyramid(const HeightField& i_heightField)
+  : d_gridSize(i_heightField.getWidth())
+{
+  const int resolution = d_gridSize - 1;
+  CONTRACT_EXPECT(i_heightField.getHeight() == d_gridSize);
+  CONTRACT_EXPECT(resolution > 0 && (resolution & (resolution - 1)) == 0);
+
+  const auto& heights = i_heightField.getValues();
+  d_errors.assign(heights.size(), 0.0f);
+  d_minHeights = heights;
+  d_maxHeights = heights;
+
+  const auto getIndex = [&](const int i_x, const int i_z) {
+    return i_x + i_z * d_gridSize;
+  };
+
+  // Own error and the corners of both triangles of the diamond. The finer vertices are
+  // propagated already, so they are kept
+  const auto initVertex = [&](const int i_index, const int i_left, const int i_right, const int i_apexA, const int i_apexB) {
+    d_errors[i_index] = std::max(d_errors[i_index], std::abs(heights[i_index] - (heights[i_left] + heights[i_right]) / 2));
+    for (const int corner : { i_left, i_right, i_apexA, i_apexB })
+    {
+      if (corner < 0)
+        continue;
+      d_minHeights[i_index] = std::min(d_minHeights[i_index], heights[corner]);
+      d_maxHeights[i_index] = std::max(d_maxHeights[i_index], heights[corner]);
+    }
+  };
+
+  const auto propagate = [&](const int i_child, const int i_parentX, const int i_parentZ) {
+    if (i_parentX < 0 || i_parentZ < 0 || i_parentX > resolution || i_parentZ > resolution)
+      return;
+    const int parent = getIndex(i_parentX, i_parentZ);
+    d_errors[parent] = std::max(d_errors[parent], d_errors[i_child]);
+    d_minHeights[parent] = std::min(d_minHeights[parent], d_minHeights[i_child]);
+    d_maxHeights[parent] = std::max(d_maxHeights[parent], d_maxHeights[i_child]);
+  };
+
+  const auto getCorner = [&](const int i_x, const int i_z) {
+    return (i_x < 0 || i_z < 0 || i_x > resolution || i_z > resolution) ? -1 : getIndex(i_x, i_z);
+  };
+
+  // Same levels and dependencies as ParallelRoam::closeDependencies(), fine to coarse, so
+  // every vertex is complete before it's propagated to its parents
+  for (int step = 1; step < resolution; step *= 2)
+  {
+    // Middles of horizontal or vertical edges. Parents are the centers of the adjacent squares
+    for (int z = 0; z <= resolution; z += step)
+    {
+      const bool oddRow = (z / step) % 2;
+      for (int x = oddRow ? 0 : step; x <= resolution; x += 2 * step)
+      {
+        const int index = getIndex(x, z);
+        if (oddRow)
+        {
+          initVertex(index, getIndex(x, z - step), getIndex(x, z + step), getCorner(x - step, z), getCorner(x + step, z));
+          propagate(index, x - step, z);
+          propagate(index, x + step, z);
+        }
+        else
+        {
+          initVertex(index, getIndex(x - step, z), getIndex(x + step, z), getCorner(x, z - step), getCorner(x, z + step));
+          propagate(index, x, z - step);
+          propagate(index, x, z + step);
+        }
+      }
+    }
+
+    // Centers of squares. Parents are the ends of the diagonal that is not the hypotenuse
+    for (int z = step; z <= resolution; z += 2 * step)
+    {
+      for (int x = step; x <= resolution; x += 2 * step)
+      {
+        const int index = getIndex(x, z);
+        const int squareX = (x - step) / (2 * step);
+        const int squareZ = (z - step) / (2 * step);
+        if ((squareX + squareZ) % 2 == 0)
+        {
+          initVertex(index, getIndex(x - step, z - step), getIndex(x + step, z + step),
+            getIndex(x + step, z - step), getIndex(x - step, z + step));
+          propagate(index, x + step, z - step);
+          propagate(index, x - step, z + step);
+        }
+        else
+        {
+          initVertex(index, getIndex(x + step, z - step), getIndex(x - step, z + step),
+            getIndex(x - step, z - step), getIndex(x + step, z + step));
+          propagate(index, x - step, z - step);
+          propagate(index, x + step, z + step);
+        }
+      }
+    }
+  }
+}
+
+
+int RoamErrorPyramid::getGridSize() const
+{
+  return d_gridSize;
+}
+
+
+float RoamErrorPyramid::getError(const int i_index) const
+{
+  return d_errors[i_index];
+}
+
+float RoamErrorPyramid::getMinHeight(const int i_index) const
+{
+  return d_minHeights[i_index];
+}
+
+float RoamErrorPyramid::getMaxHeight(const int i_index) const
+{
+  return d_maxHeights[i_index];
+}
+
+
+bool RoamErrorPyramid::load(const std::filesystem::path& i_path, const int i_gridSize)
+{
+  MappedFile file;
+  const std::size_t count = (std::size_t)i_gridSize * i_gridSize;
+  if (!file.open(i_path) || file.getSize() != sizeof(Header) + 3 * count * sizeof(float))
+    return false;
+
+  Header header;
+  std::memcpy(&header, file.getData(), sizeof(Header));
+  if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 ||
+    header.version != FormatVersion ||
+    header.gridSize != i_gridSize)
+  {
+    return false;
+  }
+
+  d_gridSize = i_gridSize;
+  const auto* data = (const float*)(file.getData() + sizeof(Header));
+  d_errors.assign(data, data + count);
+  d_minHeights.assign(data + count, data + 2 * count);
+  d_maxHeights.assign(data + 2 * count, data + 3 * count);
+  return true;
+}
+
+bool RoamErrorPyramid::save(const std::filesystem::path& i_path) const
+{
+  Header header{};
+  std::memcpy(header.magic, Magic, sizeof(Magic));
+  header.version = FormatVersion;
+  header.gridSize = d_gridSize;
+
+  std::ofstream stream(i_path, std::ios::binary | std::ios::trunc);
+  stream.write((const char*)&header, sizeof(header));
+  for (const auto* values : { &d_errors, &d_minHeights, &d_maxHeights })
+    stream.write((const char*)values->data(), values->size() * sizeof(float));
+  return (bool)stream;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <filesystem>
+#include <vector>
+
+
+class HeightField;
+
+
+// Bounds for the ROAM bintree over a square grid, per split vertex, i.e. per diamond: the
+// largest midpoint error and the height range of everything below the diamond. Errors are
+// saturated, a vertex's error is never less than the ones of the vertices it depends on,
+// so split decisions are lookups that never miss a detail deeper in the tree
+class RoamErrorPyramid
+{
+public:
+  RoamErrorPyramid() = default;
+  // The height field is the grid itself: 2^n + 1 texels per side
+  RoamErrorPyramid(const HeightField& i_heightField);
+
+  int getGridSize() const;
+
+  float getError(int i_index) const;
+  float getMinHeight(int i_index) const;
+  float getMaxHeight(int i_index) const;
+
+  // Returns false if the file can't be read or is of another grid size
+  bool load(const std::filesystem::path& i_path, int i_gridSize);
+  bool save(const std::filesystem::path& i_path) const;
+
+private:
+  int d_gridSize = 0;
+  std::vector<float> d_errors;
+  std::vector<float> d_minHeights;
+  std::vector<float> d_maxHeights;
+};
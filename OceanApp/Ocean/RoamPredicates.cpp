@@ -0,0 +1,78 @@
+#include "stdafx.h"
+#include "RoamPredicates.h"
+
+#include <LaggySdk/Math.h>
+
+
+namespace
+{
+  RoamPredicate createSurfacePredicate(const double i_precision)
+  {
+    return [i_precision](const RoamTri& i_tri) {
+      constexpr int MinDepth = 5;
+
+      if (i_tri.depth < MinDepth)
+        return true;
+      if (i_tri.depth >= SurfaceMaxDepth)
+        return false;
+      return i_tri.heightDiff > i_precision;
+    };
+  }
+
+} // anonym NS
+
+
+RoamPredicate getSurfacePredicate()
+{
+  return createSurfacePredicate(0.1);
+}
+
+RoamPredicate getTerrainPagePredicate(const float i_pageSize, const int i_lod)
+{
+  CONTRACT_EXPECT(i_lod >= 0);
+  return [i_pageSize, surfacePredicate = createSurfacePredicate(0.1 * (1 << i_lod))](const RoamTri& i_tri) {
+    // Grid positions are whole meters, so the comparisons are exact
+    const auto isOnBorder = [&](const float i_first, const float i_second, const float i_line) {
+      return i_first == i_line && i_second == i_line;
+    };
+    const auto haveBorderEdge = [&](const Sdk::Vector3F& i_first, const Sdk::Vector3F& i_second) {
+      return
+        isOnBorder(i_first.x, i_second.x, 0) || isOnBorder(i_first.x, i_second.x, i_pageSize) ||
+        isOnBorder(i_first.z, i_second.z, 0) || isOnBorder(i_first.z, i_second.z, i_pageSize);
+    };
+
+    if (haveBorderEdge(i_tri.left, i_tri.right) ||
+      haveBorderEdge(i_tri.apex, i_tri.left) ||
+      haveBorderEdge(i_tri.apex, i_tri.right))
+    {
+      return true;
+    }
+
+    return surfacePredicate(i_tri);
+  };
+}
+
+RoamPredicate getOceanPredicate(const Sdk::Vector3F& i_center)
+{
+  return [i_center, priority = getOceanPriority()](const RoamTri& i_tri) {
+    return priority(i_tri, i_center) > 0;
+  };
+}
+
+RoamPriority getOceanPriority()
+{
+  return [](const RoamTri& i_tri, const Sdk::Vector3F& i_viewPosition) {
+    const auto center = (i_tri.apex + i_tri.left + i_tri.right) / 3;
+    const auto dist = std::max((center - i_viewPosition).length(), 1.0f);
+
+    constexpr int MinLevel = 15;
+    constexpr int MaxLevel = OceanMaxDepth;
+    constexpr float MaxQualityRadius = 10.0f;
+    constexpr float MinQualityRadius = 80.0f;
+
+    const float ratio = Sdk::saturate((dist - MaxQualityRadius) / (MinQualityRadius - MaxQualityRadius));
+    const auto score = MinLevel + (MaxLevel - MinLevel) * (1 - ratio);
+
+    return score - i_tri.depth;
+  };
+}
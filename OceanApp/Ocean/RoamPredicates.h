@@ -0,0 +1,24 @@
+#pragma once
+
+#include "DynamicRoam.h"
+#include "ParallelRoam.h"
+
+
+constexpr int SurfaceMaxDepth = 20;
+// Bump on any change of getSurfacePredicate(), the cached surface meshes are rebuilt then
+constexpr int SurfacePredicateVersion = 1;
+
+// Bump on any change of getTerrainPagePredicate(), the cached page meshes are rebuilt then
+constexpr int TerrainPagePredicateVersion = 4;
+
+constexpr int OceanMaxDepth = 20;
+constexpr float OceanSize = 200;
+
+
+RoamPredicate getSurfacePredicate();
+// Surface predicate for a terrain page. Triangles with an edge on the page's border are
+// always split, so the border gets every vertex of the grid whatever the page's neighbour is.
+// The height error allowed inside the page doubles with every level of detail
+RoamPredicate getTerrainPagePredicate(float i_pageSize, int i_lod);
+RoamPredicate getOceanPredicate(const Sdk::Vector3F& i_center);
+RoamPriority getOceanPriority();
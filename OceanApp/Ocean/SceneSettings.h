@@ -0,0 +1,39 @@
+#pragma once
+
+#include "GerstnerWaves.h"
+
+#include <LaggySdk/Math.h>
+
+#include <array>
+
+
+// Projection of LaggyDx's first person camera. The camera doesn't expose it, so the culling
+// frustum and the picking rays are built from these, keep them in sync with it
+constexpr float CameraFovY = (float)Sdk::Pi / 4;
+constexpr float CameraNear = 0.01f;
+constexpr float CameraFar = 100000.0f;
+
+// Length of the rays picking the objects under the cursor
+constexpr float PickingDistance = 1000.0f;
+
+// Water heights are baked with the cells of this clipmap level, around the camera
+constexpr int WaterHeightQueryLevel = 2;
+
+// Reinsertions make the objects' BVH worse than a built one, it's rebuilt once this part of
+// the objects were reinserted since the last build
+constexpr float ObjectsBvhRebuildFraction = 0.25f;
+
+struct WaveSettings
+{
+  // Of the wind, in degrees from the X axis
+  double direction = 0;
+  double steepness = 0;
+  double length = 0;
+};
+
+// The waves the game starts with, set by the waves controls
+constexpr std::array<WaveSettings, GerstnerWaves::WavesCount> DefaultWaves{ {
+  { 20, 0.15, 15 },
+  { 0, 0.15, 7 },
+  { 40, 0.15, 3 },
+} };
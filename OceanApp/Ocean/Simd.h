@@ -0,0 +1,183 @@
+#pragma once
+
+#include <immintrin.h>
+
+#include <algorithm>
+
+
+// Thin wrappers over SSE2 and AVX2 float vectors, so the kernels can be written once.
+// SSE2 is always there on x64, AVX2 is used when the project is compiled with /arch:AVX2
+namespace Simd
+{
+  struct Sse
+  {
+    using Float = __m128;
+    using Int = __m128i;
+    static constexpr int Width = 4;
+
+    static Float load(const float* i_ptr) { return _mm_loadu_ps(i_ptr); }
+    static void store(float* o_ptr, Float i_value) { _mm_storeu_ps(o_ptr, i_value); }
+    static Float set(float i_value) { return _mm_set1_ps(i_value); }
+    static Float zero() { return _mm_setzero_ps(); }
+
+    static Float add(Float i_left, Float i_right) { return _mm_add_ps(i_left, i_right); }
+    static Float sub(Float i_left, Float i_right) { return _mm_sub_ps(i_left, i_right); }
+    static Float mul(Float i_left, Float i_right) { return _mm_mul_ps(i_left, i_right); }
+    static Float div(Float i_left, Float i_right) { return _mm_div_ps(i_left, i_right); }
+    static Float min(Float i_left, Float i_right) { return _mm_min_ps(i_left, i_right); }
+    static Float max(Float i_left, Float i_right) { return _mm_max_ps(i_left, i_right); }
+    static Float sqrt(Float i_value) { return _mm_sqrt_ps(i_value); }
+    static Float neg(Float i_value) { return _mm_xor_ps(i_value, _mm_set1_ps(-0.0f)); }
+    static Float abs(Float i_value) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), i_value); }
+    // All bits set where i_left < i_right
+    static Float less(Float i_left, Float i_right) { return _mm_cmplt_ps(i_left, i_right); }
+    static Float orMask(Float i_left, Float i_right) { return _mm_or_ps(i_left, i_right); }
+    // One bit per lane, from the sign bits
+    static int moveMask(Float i_mask) { return _mm_movemask_ps(i_mask); }
+
+    static Float select(Float i_mask, Float i_true, Float i_false)
+    {
+      return _mm_or_ps(_mm_and_ps(i_mask, i_true), _mm_andnot_ps(i_mask, i_false));
+    }
+
+    static Int roundToInt(Float i_value) { return _mm_cvtps_epi32(i_value); }
+    static Float toFloat(Int i_value) { return _mm_cvtepi32_ps(i_value); }
+    static Int truncToInt(Float i_value) { return _mm_cvttps_epi32(i_value); }
+    static Int addInt(Int i_left, Int i_right) { return _mm_add_epi32(i_left, i_right); }
+    static Int setInt(int i_value) { return _mm_set1_epi32(i_value); }
+    static Int loadInt(const void* i_ptr) { return _mm_loadu_si128((const __m128i*)i_ptr); }
+    static Int andInt(Int i_left, Int i_right) { return _mm_and_si128(i_left, i_right); }
+
+    static Float gather(const float* i_base, Int i_indices)
+    {
+      alignas(16) int indices[Width];
+      _mm_store_si128((__m128i*)indices, i_indices);
+      return _mm_setr_ps(i_base[indices[0]], i_base[indices[1]], i_base[indices[2]], i_base[indices[3]]);
+    }
+    // { l0 + l1, l2 + l3, h0 + h1, h2 + h3 }
+    static Float addPairs(Float i_low, Float i_high)
+    {
+      return _mm_add_ps(
+        _mm_shuffle_ps(i_low, i_high, _MM_SHUFFLE(2, 0, 2, 0)),
+        _mm_shuffle_ps(i_low, i_high, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+    // All bits set where (i_value & i_bit) != 0
+    static Float bitMask(Int i_value, int i_bit)
+    {
+      const auto bit = _mm_set1_epi32(i_bit);
+      return _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(i_value, bit), bit));
+    }
+  };
+
+#ifdef __AVX2__
+  struct Avx
+  {
+    using Float = __m256;
+    using Int = __m256i;
+    static constexpr int Width = 8;
+
+    static Float load(const float* i_ptr) { return _mm256_loadu_ps(i_ptr); }
+    static void store(float* o_ptr, Float i_value) { _mm256_storeu_ps(o_ptr, i_value); }
+    static Float set(float i_value) { return _mm256_set1_ps(i_value); }
+    static Float zero() { return _mm256_setzero_ps(); }
+
+    static Float add(Float i_left, Float i_right) { return _mm256_add_ps(i_left, i_right); }
+    static Float sub(Float i_left, Float i_right) { return _mm256_sub_ps(i_left, i_right); }
+    static Float mul(Float i_left, Float i_right) { return _mm256_mul_ps(i_left, i_right); }
+    static Float div(Float i_left, Float i_right) { return _mm256_div_ps(i_left, i_right); }
+    static Float min(Float i_left, Float i_right) { return _mm256_min_ps(i_left, i_right); }
+    static Float max(Float i_left, Float i_right) { return _mm256_max_ps(i_left, i_right); }
+    static Float sqrt(Float i_value) { return _mm256_sqrt_ps(i_value); }
+    static Float neg(Float i_value) { return _mm256_xor_ps(i_value, _mm256_set1_ps(-0.0f)); }
+    static Float abs(Float i_value) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), i_value); }
+    static Float less(Float i_left, Float i_right) { return _mm256_cmp_ps(i_left, i_right, _CMP_LT_OQ); }
+    static Float orMask(Float i_left, Float i_right) { return _mm256_or_ps(i_left, i_right); }
+    static int moveMask(Float i_mask) { return _mm256_movemask_ps(i_mask); }
+
+    static Float select(Float i_mask, Float i_true, Float i_false)
+    {
+      return _mm256_blendv_ps(i_false, i_true, i_mask);
+    }
+
+    static Int roundToInt(Float i_value) { return _mm256_cvtps_epi32(i_value); }
+    static Float toFloat(Int i_value) { return _mm256_cvtepi32_ps(i_value); }
+    static Int truncToInt(Float i_value) { return _mm256_cvttps_epi32(i_value); }
+    static Int addInt(Int i_left, Int i_right) { return _mm256_add_epi32(i_left, i_right); }
+    static Int setInt(int i_value) { return _mm256_set1_epi32(i_value); }
+    static Int loadInt(const void* i_ptr) { return _mm256_loadu_si256((const __m256i*)i_ptr); }
+    static Int andInt(Int i_left, Int i_right) { return _mm256_and_si256(i_left, i_right); }
+
+    static Float gather(const float* i_base, Int i_indices) { return _mm256_i32gather_ps(i_base, i_indices, 4); }
+    static Float addPairs(Float i_low, Float i_high)
+    {
+      // Shuffles work within 128-bit halves, the permute puts the halves in order
+      const auto sums = _mm256_add_ps(
+        _mm256_shuffle_ps(i_low, i_high, _MM_SHUFFLE(2, 0, 2, 0)),
+        _mm256_shuffle_ps(i_low, i_high, _MM_SHUFFLE(3, 1, 3, 1)));
+      return _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(sums), _MM_SHUFFLE(3, 1, 2, 0)));
+    }
+    static Float bitMask(Int i_value, int i_bit)
+    {
+      const auto bit = _mm256_set1_epi32(i_bit);
+      return _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(i_value, bit), bit));
+    }
+  };
+
+  using Native = Avx;
+#else
+  using Native = Sse;
+#endif
+
+
+  template <typename T>
+  float reduceMin(const typename T::Float i_value)
+  {
+    alignas(32) float values[T::Width];
+    T::store(values, i_value);
+    return *std::min_element(values, values + T::Width);
+  }
+
+  template <typename T>
+  float reduceMax(const typename T::Float i_value)
+  {
+    alignas(32) float values[T::Width];
+    T::store(values, i_value);
+    return *std::max_element(values, values + T::Width);
+  }
+
+
+  // Max error is about 1e-7 for |x| < 1e4, the same as for std::sin/std::cos in floats
+  template <typename T>
+  void sinCos(const typename T::Float i_x, typename T::Float& o_sin, typename T::Float& o_cos)
+  {
+    constexpr float TwoOverPi = 0.636619772f;
+    // Pi / 2 split in two, so x - q * Pi / 2 stays exact for the larger q
+    constexpr float PiHalfHigh = 1.5703125f;
+    constexpr float PiHalfLow = 4.83826794897e-4f;
+
+    const auto quadrant = T::roundToInt(T::mul(i_x, T::set(TwoOverPi)));
+    const auto q = T::toFloat(quadrant);
+    const auto r = T::sub(T::sub(i_x, T::mul(q, T::set(PiHalfHigh))), T::mul(q, T::set(PiHalfLow)));
+    const auto r2 = T::mul(r, r);
+
+    // Minimax polynomials on [-Pi/4, Pi/4]
+    auto sinR = T::add(T::mul(r2, T::set(-1.9515295891e-4f)), T::set(8.3321608736e-3f));
+    sinR = T::add(T::mul(sinR, r2), T::set(-1.6666654611e-1f));
+    sinR = T::add(T::mul(T::mul(sinR, r2), r), r);
+
+    auto cosR = T::add(T::mul(r2, T::set(2.443315711809948e-5f)), T::set(-1.388731625493765e-3f));
+    cosR = T::add(T::mul(cosR, r2), T::set(4.166664568298827e-2f));
+    cosR = T::add(T::sub(T::mul(T::mul(cosR, r2), r2), T::mul(r2, T::set(0.5f))), T::set(1));
+
+    // Odd quadrants swap sin and cos, quadrants 2 and 3 negate sin, 1 and 2 negate cos
+    const auto swap = T::bitMask(quadrant, 1);
+    const auto sinValue = T::select(swap, cosR, sinR);
+    const auto cosValue = T::select(swap, sinR, cosR);
+
+    const auto sinNeg = T::bitMask(quadrant, 2);
+    const auto cosNeg = T::bitMask(T::addInt(quadrant, T::setInt(1)), 2);
+    o_sin = T::select(sinNeg, T::neg(sinValue), sinValue);
+    o_cos = T::select(cosNeg, T::neg(cosValue), cosValue);
+  }
+
+} // ns Simd
@@ -0,0 +1,444 @@
+#include "stdafx.h"
+#include "TerrainPager.h"
+
+#include "HeightField.h"
+#include "MappedFile.h"
+#include "MeshFileCache.h"
+#include "ParallelRoam.h"
+#include "Profiler.h"
+#include "RoamErrorPyramid.h"
+#include "RoamPredicates.h"
+
+#include <LaggyDx/IShape3d.h>
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <tuple>
+
+
+namespace
+{
+  // Bump on any change of the files layout below
+  constexpr std::uint32_t FormatVersion = 3;
+  constexpr char InfoMagic[4] = { 'O', 'T', 'R', 'N' };
+  constexpr char PageMagic[4] = { 'O', 'T', 'P', 'G' };
+  const std::string InfoFileName = "terrain.info";
+
+  // Deep enough for the page's grid to match its texels
+  constexpr int PageMaxDepth = 14;
+
+  // A page that failed to load is queued again after this many frames
+  constexpr int RetryFramesCount = 60;
+  static_assert(1 << ((PageMaxDepth + 1) / 2) == TerrainPager::PageSize);
+
+  // Page side, in samples. The last row and column repeat the first ones of the next page
+  constexpr int PageSamplesCount = TerrainPager::PageSize + 1;
+
+  struct InfoHeader
+  {
+    char magic[4];
+    std::uint32_t version;
+    std::uint64_t key;
+    std::int32_t pageSize;
+    std::int32_t pagesCountX;
+    std::int32_t pagesCountZ;
+    std::int32_t padding;
+  };
+
+  struct PageHeader
+  {
+    char magic[4];
+    std::uint32_t version;
+    std::int32_t samplesCount;
+    std::int32_t padding;
+  };
+
+  std::filesystem::path getPagePath(const std::filesystem::path& i_folder, const int i_x, const int i_z)
+  {
+    return i_folder / (std::to_string(i_x) + "_" + std::to_string(i_z) + ".page");
+  }
+
+  std::filesystem::path getErrorsPath(const std::filesystem::path& i_folder, const int i_x, const int i_z)
+  {
+    return i_folder / (std::to_string(i_x) + "_" + std::to_string(i_z) + ".errors");
+  }
+
+  bool readInfo(const std::filesystem::path& i_folder, InfoHeader& o_info)
+  {
+    MappedFile file;
+    if (!file.open(i_folder / InfoFileName) || file.getSize() != sizeof(InfoHeader))
+      return false;
+
+    std::memcpy(&o_info, file.getData(), sizeof(InfoHeader));
+    return
+      std::memcmp(o_info.magic, InfoMagic, sizeof(InfoMagic)) == 0 &&
+      o_info.version == FormatVersion &&
+      o_info.pageSize == TerrainPager::PageSize;
+  }
+
+  template <typename THeader>
+  bool writeFile(const std::filesystem::path& i_path, const THeader& i_header, const float* i_values, const int i_valuesCount)
+  {
+    std::ofstream stream(i_path, std::ios::binary | std::ios::trunc);
+    stream.write((const char*)&i_header, sizeof(i_header));
+    if (i_valuesCount > 0)
+      stream.write((const char*)i_values, i_valuesCount * sizeof(float));
+    return (bool)stream;
+  }
+
+  float getSquaredDistance(const float i_x, const float i_z, const int i_pageX, const int i_pageZ)
+  {
+    const float minX = (float)i_pageX * TerrainPager::PageSize;
+    const float minZ = (float)i_pageZ * TerrainPager::PageSize;
+    const float dx = std::max({ minX - i_x, 0.0f, i_x - (minX + TerrainPager::PageSize) });
+    const float dz = std::max({ minZ - i_z, 0.0f, i_z - (minZ + TerrainPager::PageSize) });
+    return dx * dx + dz * dz;
+  }
+
+} // anonym NS
+
+
+bool TerrainPager::hasPages(const std::filesystem::path& i_folder, const std::uint64_t i_sourceKey)
+{
+  InfoHeader info;
+  return readInfo(i_folder, info) && info.key == i_sourceKey;
+}
+
+bool TerrainPager::writePages(
+  const HeightField& i_heightField, const std::uint64_t i_sourceKey, const std::filesystem::path& i_folder)
+{
+  // The page size and the format are checked by readInfo(), so the source is all the key is about
+  if (hasPages(i_folder, i_sourceKey))
+    return true;
+
+  InfoHeader info;
+
+  std::error_code error;
+  std::filesystem::create_directories(i_folder, error);
+
+  const int width = i_heightField.getWidth();
+  const int height = i_heightField.getHeight();
+  const int pagesCountX = std::max((width - 1 + PageSize - 1) / PageSize, 1);
+  const int pagesCountZ = std::max((height - 1 + PageSize - 1) / PageSize, 1);
+
+  PageHeader pageHeader{};
+  std::memcpy(pageHeader.magic, PageMagic, sizeof(PageMagic));
+  pageHeader.version = FormatVersion;
+  pageHeader.samplesCount = PageSamplesCount;
+
+  HeightField page(PageSamplesCount, PageSamplesCount);
+  auto& samples = page.getValues();
+  for (int pageZ = 0; pageZ < pagesCountZ; ++pageZ)
+  {
+    for (int pageX = 0; pageX < pagesCountX; ++pageX)
+    {
+      // Pages sticking out of the height field repeat its last texels
+      for (int z = 0; z < PageSamplesCount; ++z)
+      {
+        const int sourceZ = std::min(pageZ * PageSize + z, height - 1);
+        for (int x = 0; x < PageSamplesCount; ++x)
+        {
+          const int sourceX = std::min(pageX * PageSize + x, width - 1);
+          samples[x + z * PageSamplesCount] = i_heightField.getValue(sourceX, sourceZ);
+        }
+      }
+
+      if (!writeFile(getPagePath(i_folder, pageX, pageZ), pageHeader, samples.data(), (int)samples.size()))
+        return false;
+      if (!RoamErrorPyramid(page).save(getErrorsPath(i_folder, pageX, pageZ)))
+        return false;
+    }
+  }
+
+  // Written last, so the pages of an interrupted write are never taken as valid
+  info = {};
+  std::memcpy(info.magic, InfoMagic, sizeof(InfoMagic));
+  info.version = FormatVersion;
+  info.key = i_sourceKey;
+  info.pageSize = PageSize;
+  info.pagesCountX = pagesCountX;
+  info.pagesCountZ = pagesCountZ;
+  return writeFile(i_folder / InfoFileName, info, nullptr, 0);
+}
+
+std::int64_t TerrainPager::getPageKey(const int i_x, const int i_z)
+{
+  return ((std::int64_t)i_z << 32) | (std::uint32_t)i_x;
+}
+
+
+TerrainPager::TerrainPager(TerrainPagerSettings i_settings)
+  : d_settings(std::move(i_settings))
+  , d_pool(d_settings.tessellationThreadsCount)
+{
+  CONTRACT_EXPECT(d_settings.maxResidentPagesCount > 0);
+  CONTRACT_EXPECT(d_settings.tessellationThreadsCount > 0);
+  CONTRACT_EXPECT(d_settings.lodDistance > 0);
+
+  InfoHeader info;
+  if (readInfo(d_settings.pagesFolder, info))
+  {
+    d_pagesCountX = info.pagesCountX;
+    d_pagesCountZ = info.pagesCountZ;
+  }
+
+  d_thread = std::thread([this]() { loadingLoop(); });
+}
+
+TerrainPager::~TerrainPager()
+{
+  {
+    std::lock_guard lock(d_mutex);
+    d_stop = true;
+  }
+  d_queueChanged.notify_all();
+  d_thread.join();
+}
+
+
+void TerrainPager::update(const Sdk::Vector3F& i_viewPosition)
+{
+  ++d_frame;
+
+  const float distance = d_settings.loadDistance;
+  const float squaredDistance = distance * distance;
+  const int minX = std::max((int)std::floor((i_viewPosition.x - distance) / PageSize), 0);
+  const int minZ = std::max((int)std::floor((i_viewPosition.z - distance) / PageSize), 0);
+  const int maxX = std::min((int)std::floor((i_viewPosition.x + distance) / PageSize), d_pagesCountX - 1);
+  const int maxZ = std::min((int)std::floor((i_viewPosition.z + distance) / PageSize), d_pagesCountZ - 1);
+
+  for (int z = minZ; z <= maxZ; ++z)
+  {
+    for (int x = minX; x <= maxX; ++x)
+    {
+      const float pageSquaredDistance = getSquaredDistance(i_viewPosition.x, i_viewPosition.z, x, z);
+      if (pageSquaredDistance > squaredDistance)
+        continue;
+
+      auto& resident = d_residents[getPageKey(x, z)];
+      resident.x = x;
+      resident.z = z;
+      resident.wantedLod = getLod(pageSquaredDistance);
+      resident.lastWantedFrame = d_frame;
+    }
+  }
+
+  // Only the pages not wanted any more are evicted, the budget is exceeded rather than
+  // pages in view are dropped
+  if ((int)d_residents.size() > d_settings.maxResidentPagesCount)
+  {
+    std::vector<std::pair<std::uint64_t, std::int64_t>> candidates;
+    for (const auto& [key, resident] : d_residents)
+    {
+      if (resident.lastWantedFrame != d_frame)
+        candidates.push_back({ resident.lastWantedFrame, key });
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    const int evictionsCount = std::min(
+      (int)d_residents.size() - d_settings.maxResidentPagesCount, (int)candidates.size());
+    for (int i = 0; i < evictionsCount; ++i)
+    {
+      const auto it = d_residents.find(candidates[i].second);
+      if (it->second.lod >= 0)
+      {
+        d_evicted.push_back({ it->second.x, it->second.z, it->second.lod, nullptr });
+        ++d_evictionsCount;
+      }
+      d_residents.erase(it);
+    }
+  }
+
+  // Pages of the wrong level of detail are loaded again, after the missing ones
+  std::vector<std::tuple<bool, float, std::int64_t>> missing;
+  for (const auto& [key, resident] : d_residents)
+  {
+    if (resident.lod != resident.wantedLod && resident.retryFrame <= d_frame)
+    {
+      missing.push_back({
+        resident.lod >= 0, getSquaredDistance(i_viewPosition.x, i_viewPosition.z, resident.x, resident.z), key });
+    }
+  }
+  std::sort(missing.begin(), missing.end());
+
+  {
+    std::lock_guard lock(d_mutex);
+    d_queue.clear();
+    for (const auto& [reload, squaredDistance, key] : missing)
+    {
+      if (key != d_loadingPage)
+        d_queue.push_back({ key, d_residents.at(key).wantedLod });
+    }
+  }
+  d_queueChanged.notify_one();
+}
+
+
+std::vector<TerrainPager::Page> TerrainPager::takeLoadedPages()
+{
+  std::vector<Page> loaded;
+  {
+    std::lock_guard lock(d_mutex);
+    loaded.swap(d_loaded);
+  }
+
+  // Pages evicted while being loaded are dropped, the ones that failed are queued again later
+  std::vector<Page> pages;
+  for (auto& page : loaded)
+  {
+    const auto it = d_residents.find(getPageKey(page.x, page.z));
+    if (it == d_residents.end() || it->second.lod == page.lod)
+      continue;
+
+    if (!page.shape)
+    {
+      it->second.retryFrame = d_frame + RetryFramesCount;
+      ++d_failedLoadsCount;
+      continue;
+    }
+
+    it->second.lod = page.lod;
+    ++d_loadsCount;
+    pages.push_back(std::move(page));
+  }
+
+  return pages;
+}
+
+std::vector<TerrainPager::Page> TerrainPager::takeEvictedPages()
+{
+  std::vector<Page> evicted;
+  evicted.swap(d_evicted);
+  return evicted;
+}
+
+
+int TerrainPager::getPagesCountX() const
+{
+  return d_pagesCountX;
+}
+
+int TerrainPager::getPagesCountZ() const
+{
+  return d_pagesCountZ;
+}
+
+int TerrainPager::getResidentPagesCount() const
+{
+  return (int)std::count_if(d_residents.begin(), d_residents.end(), [](const auto& i_pair) {
+    return i_pair.second.lod >= 0;
+    });
+}
+
+int TerrainPager::getQueuedPagesCount() const
+{
+  std::lock_guard lock(d_mutex);
+  return (int)d_queue.size();
+}
+
+int TerrainPager::getLoadsCount() const
+{
+  return d_loadsCount;
+}
+
+int TerrainPager::getEvictionsCount() const
+{
+  return d_evictionsCount;
+}
+
+int TerrainPager::getFailedLoadsCount() const
+{
+  return d_failedLoadsCount;
+}
+
+double TerrainPager::getAveragePageMs() const
+{
+  std::lock_guard lock(d_mutex);
+  return d_pagesProcessedCount > 0 ? d_pagesMs / d_pagesProcessedCount : 0;
+}
+
+
+void TerrainPager::loadingLoop()
+{
+  while (true)
+  {
+    Request request;
+    {
+      std::unique_lock lock(d_mutex);
+      d_queueChanged.wait(lock, [&]() { return d_stop || !d_queue.empty(); });
+      if (d_stop)
+        return;
+
+      request = d_queue.front();
+      d_queue.pop_front();
+      d_loadingPage = request.key;
+    }
+
+    const int x = (int)(std::uint32_t)(request.key & 0xFFFFFFFF);
+    const int z = (int)(request.key >> 32);
+
+    const auto start = std::chrono::steady_clock::now();
+    auto shape = loadPage(x, z, request.lod);
+    const auto end = std::chrono::steady_clock::now();
+
+    std::lock_guard lock(d_mutex);
+    d_loaded.push_back({ x, z, request.lod, std::move(shape) });
+    d_loadingPage = -1;
+    d_pagesMs += std::chrono::duration<double, std::milli>(end - start).count();
+    ++d_pagesProcessedCount;
+  }
+}
+
+int TerrainPager::getLod(const float i_squaredDistance) const
+{
+  return std::min((int)(std::sqrt(i_squaredDistance) / d_settings.lodDistance), LodsCount - 1);
+}
+
+std::shared_ptr<Dx::IShape3d> TerrainPager::loadPage(const int i_x, const int i_z, const int i_lod)
+{
+  PROFILE_SCOPE("TerrainPager::loadPage");
+
+  MappedFile file;
+  if (!file.open(getPagePath(d_settings.pagesFolder, i_x, i_z)))
+    return nullptr;
+
+  constexpr std::size_t SamplesBytes = PageSamplesCount * PageSamplesCount * sizeof(float);
+  PageHeader header;
+  if (file.getSize() != sizeof(PageHeader) + SamplesBytes)
+    return nullptr;
+  std::memcpy(&header, file.getData(), sizeof(PageHeader));
+  if (std::memcmp(header.magic, PageMagic, sizeof(PageMagic)) != 0 ||
+    header.version != FormatVersion ||
+    header.samplesCount != PageSamplesCount)
+  {
+    return nullptr;
+  }
+
+  HeightField heightField(PageSamplesCount, PageSamplesCount);
+  std::memcpy(heightField.getValues().data(), file.getData() + sizeof(PageHeader), SamplesBytes);
+
+  std::unique_ptr<MeshFileCache> meshFileCache;
+  std::uint64_t meshKey = 0;
+  if (!d_settings.meshesFolder.empty())
+  {
+    meshFileCache = std::make_unique<MeshFileCache>(d_settings.meshesFolder);
+    // The level of detail is a parameter of the predicate, so it's a part of its version
+    meshKey = MeshFileCache::getKey(heightField, PageMaxDepth, TerrainPagePredicateVersion * LodsCount + i_lod);
+
+    MeshFileMaterial material;
+    if (auto shape = meshFileCache->load(meshKey, material))
+      return shape;
+  }
+
+  RoamErrorPyramid errorPyramid;
+  if (!errorPyramid.load(getErrorsPath(d_settings.pagesFolder, i_x, i_z), PageSamplesCount))
+    errorPyramid = RoamErrorPyramid(heightField);
+
+  const ParallelRoam roam(heightField, PageMaxDepth, getTerrainPagePredicate((float)PageSize, i_lod), d_pool, &errorPyramid);
+  auto shape = roam.createShape();
+
+  if (meshFileCache)
+    meshFileCache->save(meshKey, *shape, {});
+  return shape;
+}
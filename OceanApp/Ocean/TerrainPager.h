@@ -0,0 +1,145 @@
+#pragma once
+
+#include "ThreadPool.h"
+
+#include <LaggyDx/LaggyDxFwd.h>
+#include <LaggySdk/Vector.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+
+class HeightField;
+
+
+struct TerrainPagerSettings
+{
+  std::filesystem::path pagesFolder;
+  // Tessellated pages are cached here, empty for no cache
+  std::filesystem::path meshesFolder;
+  // Pages closer than this to the view position are kept loaded
+  float loadDistance = 400;
+  // Pages are tessellated a level of detail coarser every this many meters away from the view position
+  float lodDistance = 128;
+  // LRU budget: the least recently wanted pages are evicted above it
+  int maxResidentPagesCount = 64;
+  // Of the pool the loading thread tessellates a page with. A page takes about a millisecond,
+  // too little for the ROAM's fork-join to pay off, and the pages are loaded ahead of the view
+  // anyway. More threads would compete with the game's pool for the cores during the frames
+  int tessellationThreadsCount = 1;
+};
+
+
+// Terrain split into square pages of heights on disk, loaded around the view position.
+// A background thread reads and tessellates the pages, nearest first; the caller uploads
+// them and drops the evicted ones. Neighbouring pages share their border samples and the
+// borders are always tessellated at full resolution, so the pages meet without cracks
+// whatever their levels of detail are. A page whose level changes is loaded again
+class TerrainPager
+{
+public:
+  // Texels per page side, 1 texel = 1 meter
+  static constexpr int PageSize = 128;
+  static constexpr int LodsCount = 4;
+
+  // Whether the folder holds the pages written for this key
+  static bool hasPages(const std::filesystem::path& i_folder, std::uint64_t i_sourceKey);
+  // Splits the height field into pages, unless the folder already holds them. i_sourceKey
+  // identifies what the height field is made from, see MeshFileCache::getFileKey(), so the
+  // pages can be recognized without making the height field. Returns false if the pages
+  // can't be written
+  static bool writePages(const HeightField& i_heightField, std::uint64_t i_sourceKey,
+    const std::filesystem::path& i_folder);
+  static std::int64_t getPageKey(int i_x, int i_z);
+
+  TerrainPager(TerrainPagerSettings i_settings);
+  ~TerrainPager();
+
+  TerrainPager(const TerrainPager&) = delete;
+  TerrainPager& operator=(const TerrainPager&) = delete;
+
+  struct Page
+  {
+    int x = 0;
+    int z = 0;
+    int lod = 0;
+    // In the page's local space, the page's origin is at { x, 0, z } * PageSize
+    std::shared_ptr<Dx::IShape3d> shape;
+  };
+
+  // Queues the missing pages around the position and evicts the ones over the budget
+  void update(const Sdk::Vector3F& i_viewPosition);
+
+  // Pages tessellated since the last call, and pages the caller has to drop. A loaded page
+  // replaces the one of another level of detail the caller may have
+  std::vector<Page> takeLoadedPages();
+  std::vector<Page> takeEvictedPages();
+
+  int getPagesCountX() const;
+  int getPagesCountZ() const;
+  int getResidentPagesCount() const;
+  int getQueuedPagesCount() const;
+  int getLoadsCount() const;
+  int getEvictionsCount() const;
+  // Page loads that failed and were queued again
+  int getFailedLoadsCount() const;
+  // Time the loading thread spends on a page, tessellated or taken from the meshes cache
+  double getAveragePageMs() const;
+
+private:
+  struct Resident
+  {
+    int x = 0;
+    int z = 0;
+    int wantedLod = 0;
+    // Of the loaded page, -1 if none
+    int lod = -1;
+    std::uint64_t lastWantedFrame = 0;
+    // Not queued before this frame, after a failed load
+    std::uint64_t retryFrame = 0;
+  };
+
+  struct Request
+  {
+    std::int64_t key = 0;
+    int lod = 0;
+  };
+
+  TerrainPagerSettings d_settings;
+  int d_pagesCountX = 0;
+  int d_pagesCountZ = 0;
+
+  std::uint64_t d_frame = 0;
+  // Loaded, being loaded or queued, by page key
+  std::unordered_map<std::int64_t, Resident> d_residents;
+  std::vector<Page> d_evicted;
+  int d_loadsCount = 0;
+  int d_evictionsCount = 0;
+  int d_failedLoadsCount = 0;
+
+  // Shared with the loading thread
+  mutable std::mutex d_mutex;
+  std::condition_variable d_queueChanged;
+  std::deque<Request> d_queue;
+  std::vector<Page> d_loaded;
+  std::int64_t d_loadingPage = -1;
+  double d_pagesMs = 0;
+  int d_pagesProcessedCount = 0;
+  bool d_stop = false;
+
+  // ParallelRoam has to be driven from outside of the pool it uses, hence a thread of its own.
+  // Sized by TerrainPagerSettings::tessellationThreadsCount
+  ThreadPool d_pool;
+  std::thread d_thread;
+
+  void loadingLoop();
+  int getLod(float i_squaredDistance) const;
+  // Null if the page can't be read
+  std::shared_ptr<Dx::IShape3d> loadPage(int i_x, int i_z, int i_lod);
+};
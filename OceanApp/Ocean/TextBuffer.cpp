@@ -0,0 +1,40 @@
+#include "stdafx.h"
+#include "TextBuffer.h"
+
+#include <algorithm>
+#include <charconv>
+
+
+void TextBuffer::clear()
+{
+  d_size = 0;
+}
+
+
+void TextBuffer::append(const std::string_view i_text)
+{
+  const int count = std::min((int)i_text.size(), Capacity - d_size);
+  std::copy_n(i_text.data(), count, d_chars.data() + d_size);
+  d_size += count;
+}
+
+void TextBuffer::appendInt(const long long i_value)
+{
+  const auto result = std::to_chars(d_chars.data() + d_size, d_chars.data() + Capacity, i_value);
+  if (result.ec == std::errc())
+    d_size = (int)(result.ptr - d_chars.data());
+}
+
+void TextBuffer::appendFloat(const double i_value, const int i_precision)
+{
+  const auto result = std::to_chars(d_chars.data() + d_size, d_chars.data() + Capacity,
+    i_value, std::chars_format::fixed, i_precision);
+  if (result.ec == std::errc())
+    d_size = (int)(result.ptr - d_chars.data());
+}
+
+
+std::string_view TextBuffer::getText() const
+{
+  return { d_chars.data(), (std::size_t)d_size };
+}
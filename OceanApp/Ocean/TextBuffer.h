@@ -0,0 +1,25 @@
+#pragma once
+
+#include <array>
+#include <string_view>
+
+
+// Text formatted into a fixed buffer that is reused from frame to frame, so formatting never
+// allocates. Whatever doesn't fit is cut off
+class TextBuffer
+{
+public:
+  static constexpr int Capacity = 4096;
+
+  void clear();
+
+  void append(std::string_view i_text);
+  void appendInt(long long i_value);
+  void appendFloat(double i_value, int i_precision);
+
+  std::string_view getText() const;
+
+private:
+  std::array<char, Capacity> d_chars;
+  int d_size = 0;
+};
@@ -0,0 +1,164 @@
+#include "stdafx.h"
+#include "ThreadPool.h"
+
+
+namespace
+{
+  thread_local const ThreadPool* t_pool = nullptr;
+  thread_local int t_workerIndex = -1;
+
+} // anonym NS
+
+
+ThreadPool::ThreadPool(const int i_threadsCount)
+{
+  CONTRACT_EXPECT(i_threadsCount > 0);
+
+  for (int i = 0; i < i_threadsCount; ++i)
+    d_queues.push_back(std::make_unique<Queue>());
+
+  for (int i = 0; i < i_threadsCount; ++i)
+    d_threads.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+  wait();
+
+  {
+    std::lock_guard lock(d_mutex);
+    d_stop = true;
+  }
+  d_workAvailable.notify_all();
+
+  for (auto& thread : d_threads)
+    thread.join();
+}
+
+
+int ThreadPool::getThreadsCount() const
+{
+  // Not d_threads: workers ask for it while the later threads are still being added
+  return (int)d_queues.size();
+}
+
+
+void ThreadPool::push(Task i_task)
+{
+  const int queueIndex = t_pool == this ?
+    t_workerIndex : d_nextQueue.fetch_add(1) % getThreadsCount();
+
+  d_pendingCount.fetch_add(1);
+
+  {
+    auto& queue = *d_queues.at(queueIndex);
+    std::lock_guard lock(queue.mutex);
+    queue.tasks.push_back(std::move(i_task));
+  }
+
+  d_queuedCount.fetch_add(1);
+  {
+    // Makes sure a worker can't miss the notification between checking the counter and going to sleep
+    std::lock_guard lock(d_mutex);
+  }
+  d_workAvailable.notify_one();
+}
+
+void ThreadPool::wait()
+{
+  std::unique_lock lock(d_mutex);
+  d_allDone.wait(lock, [&]() { return d_pendingCount.load() == 0; });
+}
+
+
+void ThreadPool::parallelFor(const int i_begin, const int i_end, const std::function<void(int)>& i_func)
+{
+  if (i_begin >= i_end)
+    return;
+
+  constexpr int ChunksPerThread = 4;
+  const int count = i_end - i_begin;
+  const int chunksCount = std::min(count, getThreadsCount() * ChunksPerThread);
+
+  for (int chunk = 0; chunk < chunksCount; ++chunk)
+  {
+    const int begin = i_begin + (int)((long long)count * chunk / chunksCount);
+    const int end = i_begin + (int)((long long)count * (chunk + 1) / chunksCount);
+    push([begin, end, &i_func]() {
+      for (int i = begin; i < end; ++i)
+        i_func(i);
+      });
+  }
+
+  wait();
+}
+
+
+void ThreadPool::workerLoop(const int i_index)
+{
+  t_pool = this;
+  t_workerIndex = i_index;
+
+  while (true)
+  {
+    Task task;
+    if (tryPop(i_index, task) || trySteal(i_index, task))
+    {
+      task();
+      finishTask();
+      continue;
+    }
+
+    std::unique_lock lock(d_mutex);
+    d_workAvailable.wait(lock, [&]() { return d_stop || d_queuedCount > 0; });
+    if (d_stop)
+      return;
+  }
+}
+
+bool ThreadPool::tryPop(const int i_index, Task& o_task)
+{
+  auto& queue = *d_queues.at(i_index);
+  {
+    std::lock_guard lock(queue.mutex);
+    if (queue.tasks.empty())
+      return false;
+
+    o_task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+  }
+
+  d_queuedCount.fetch_sub(1);
+  return true;
+}
+
+bool ThreadPool::trySteal(const int i_index, Task& o_task)
+{
+  const int count = getThreadsCount();
+  for (int offset = 1; offset < count; ++offset)
+  {
+    auto& queue = *d_queues.at((i_index + offset) % count);
+    {
+      std::lock_guard lock(queue.mutex);
+      if (queue.tasks.empty())
+        continue;
+
+      o_task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+    }
+
+    d_queuedCount.fetch_sub(1);
+    return true;
+  }
+
+  return false;
+}
+
+void ThreadPool::finishTask()
+{
+  if (d_pendingCount.fetch_sub(1) != 1)
+    return;
+
+  std::lock_guard lock(d_mutex);
+  d_allDone.notify_all();
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// Work-stealing pool. Each worker owns a deque: it pops its own tasks from the back
+// and steals from the front of the others' deques when it runs out of work.
+class ThreadPool
+{
+public:
+  using Task = std::function<void()>;
+
+  ThreadPool(int i_threadsCount);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  int getThreadsCount() const;
+
+  // Can be called both from the outside and from within a running task
+  void push(Task i_task);
+  // Blocks until every pushed task (including the ones pushed by tasks) is done.
+  // Must not be called from within a task
+  void wait();
+
+  // Splits [i_begin, i_end) into chunks and runs them on the pool, blocks until done.
+  // Must not be called from within a task
+  void parallelFor(int i_begin, int i_end, const std::function<void(int)>& i_func);
+
+private:
+  struct Queue
+  {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  std::vector<std::unique_ptr<Queue>> d_queues;
+  std::vector<std::thread> d_threads;
+
+  std::atomic<int> d_pendingCount = 0;
+  std::atomic<int> d_nextQueue = 0;
+  std::atomic<int> d_queuedCount = 0;
+  bool d_stop = false;
+
+  std::mutex d_mutex;
+  std::condition_variable d_workAvailable;
+  std::condition_variable d_allDone;
+
+  void workerLoop(int i_index);
+  bool tryPop(int i_index, Task& o_task);
+  bool trySteal(int i_index, Task& o_task);
+  void finishTask();
+};
@@ -0,0 +1,345 @@
+#include "stdafx.h"
+#include "VisibilityCuller.h"
+
+#include "Simd.h"
+
+#include <LaggySdk/Math.h>
+
+#include <limits>
+#include <numeric>
+
+
+namespace
+{
+  // Horizontal extent of a box as seen from the eye
+  struct Footprint
+  {
+    bool containsEye = false;
+    float nearest = 0;
+    float farthest = 0;
+    float minAngle = 0;
+    float maxAngle = 0;
+  };
+
+  Footprint getFootprint(const BoundingBox& i_box, const Sdk::Vector3F& i_eye)
+  {
+    Footprint footprint;
+    footprint.containsEye =
+      i_eye.x >= i_box.min.x && i_eye.x <= i_box.max.x &&
+      i_eye.z >= i_box.min.z && i_eye.z <= i_box.max.z;
+    if (footprint.containsEye)
+      return footprint;
+
+    const float dx = std::max({ i_box.min.x - i_eye.x, 0.0f, i_eye.x - i_box.max.x });
+    const float dz = std::max({ i_box.min.z - i_eye.z, 0.0f, i_eye.z - i_box.max.z });
+    footprint.nearest = std::sqrt(dx * dx + dz * dz);
+
+    // The eye is outside, so the box spans less than a half turn around the center's direction
+    const auto center = i_box.getCenter();
+    const float centerAngle = std::atan2(center.z - i_eye.z, center.x - i_eye.x);
+    float minDelta = 0;
+    float maxDelta = 0;
+    for (const float x : { i_box.min.x, i_box.max.x })
+    {
+      for (const float z : { i_box.min.z, i_box.max.z })
+      {
+        const float cornerX = x - i_eye.x;
+        const float cornerZ = z - i_eye.z;
+        footprint.farthest = std::max(footprint.farthest, std::sqrt(cornerX * cornerX + cornerZ * cornerZ));
+
+        float delta = std::atan2(cornerZ, cornerX) - centerAngle;
+        if (delta > (float)Sdk::Pi)
+          delta -= (float)Sdk::Pi2;
+        else if (delta < -(float)Sdk::Pi)
+          delta += (float)Sdk::Pi2;
+        minDelta = std::min(minDelta, delta);
+        maxDelta = std::max(maxDelta, delta);
+      }
+    }
+
+    footprint.minAngle = centerAngle + minDelta;
+    footprint.maxAngle = centerAngle + maxDelta;
+    return footprint;
+  }
+
+  int getBin(const int i_index, const int i_binsCount)
+  {
+    return ((i_index % i_binsCount) + i_binsCount) % i_binsCount;
+  }
+
+} // anonym NS
+
+
+FrustumPlanes getFrustumPlanes(const Matrix4& i_viewProjection)
+{
+  // Planes from the columns of the matrix
+  const auto& m = i_viewProjection;
+  const auto getColumn = [&](const int i_column) {
+    return std::array<float, 4>{ m[i_column], m[4 + i_column], m[8 + i_column], m[12 + i_column] };
+  };
+  const auto c0 = getColumn(0);
+  const auto c1 = getColumn(1);
+  const auto c2 = getColumn(2);
+  const auto c3 = getColumn(3);
+
+  FrustumPlanes planes;
+  for (int i = 0; i < 4; ++i)
+  {
+    planes[0][i] = c3[i] + c0[i];
+    planes[1][i] = c3[i] - c0[i];
+    planes[2][i] = c3[i] + c1[i];
+    planes[3][i] = c3[i] - c1[i];
+    planes[4][i] = c2[i];
+    planes[5][i] = c3[i] - c2[i];
+  }
+  return planes;
+}
+
+Matrix4 createViewProjection(const Sdk::Vector3F& i_eye, const Sdk::Vector3F& i_lookAt,
+  const float i_fovY, const float i_aspect, const float i_near, const float i_far)
+{
+  CONTRACT_EXPECT(i_fovY > 0 && i_aspect > 0);
+  CONTRACT_EXPECT(i_near > 0 && i_far > i_near);
+
+  const auto cross = [](const Sdk::Vector3F& i_left, const Sdk::Vector3F& i_right) {
+    return Sdk::Vector3F{
+      i_left.y * i_right.z - i_left.z * i_right.y,
+      i_left.z * i_right.x - i_left.x * i_right.z,
+      i_left.x * i_right.y - i_left.y * i_right.x };
+  };
+  const auto dot = [](const Sdk::Vector3F& i_left, const Sdk::Vector3F& i_right) {
+    return i_left.x * i_right.x + i_left.y * i_right.y + i_left.z * i_right.z;
+  };
+
+  const auto zAxis = (i_lookAt - i_eye).getNormalized();
+  auto xAxis = cross({ 0, 1, 0 }, zAxis);
+  // Looking straight up or down, any horizontal axis does
+  xAxis = xAxis.length() > 0 ? xAxis.getNormalized() : Sdk::Vector3F{ 1, 0, 0 };
+  const auto yAxis = cross(zAxis, xAxis);
+
+  const Matrix4 view = {
+    xAxis.x, yAxis.x, zAxis.x, 0,
+    xAxis.y, yAxis.y, zAxis.y, 0,
+    xAxis.z, yAxis.z, zAxis.z, 0,
+    -dot(xAxis, i_eye), -dot(yAxis, i_eye), -dot(zAxis, i_eye), 1 };
+
+  const float height = 1.0f / std::tan(i_fovY / 2);
+  const float width = height / i_aspect;
+  const float depth = i_far / (i_far - i_near);
+  const Matrix4 projection = {
+    width, 0, 0, 0,
+    0, height, 0, 0,
+    0, 0, depth, 1,
+    0, 0, -i_near * depth, 0 };
+
+  Matrix4 result{};
+  for (int row = 0; row < 4; ++row)
+  {
+    for (int column = 0; column < 4; ++column)
+    {
+      for (int i = 0; i < 4; ++i)
+        result[row * 4 + column] += view[row * 4 + i] * projection[i * 4 + column];
+    }
+  }
+  return result;
+}
+
+
+void VisibilityCuller::begin(const Matrix4& i_viewProjection, const Sdk::Vector3F& i_eye)
+{
+  d_planes = getFrustumPlanes(i_viewProjection);
+  d_eye = i_eye;
+
+  d_centerX.clear();
+  d_centerY.clear();
+  d_centerZ.clear();
+  d_extentX.clear();
+  d_extentY.clear();
+  d_extentZ.clear();
+  d_boxes.clear();
+  d_occluders.clear();
+  d_visible.clear();
+
+  d_frustumCulledCount = 0;
+  d_horizonCulledCount = 0;
+}
+
+
+int VisibilityCuller::add(const BoundingBox& i_box)
+{
+  const auto center = i_box.getCenter();
+  const auto extents = i_box.getExtents();
+  d_centerX.push_back(center.x);
+  d_centerY.push_back(center.y);
+  d_centerZ.push_back(center.z);
+  d_extentX.push_back(extents.x);
+  d_extentY.push_back(extents.y);
+  d_extentZ.push_back(extents.z);
+  d_boxes.push_back(i_box);
+  return (int)d_boxes.size() - 1;
+}
+
+void VisibilityCuller::addOccluder(const BoundingBox& i_box)
+{
+  d_occluders.push_back(i_box);
+}
+
+
+void VisibilityCuller::cull()
+{
+  d_visible.assign(d_boxes.size(), 1);
+  cullFrustum();
+  cullHorizon();
+}
+
+
+bool VisibilityCuller::isVisible(const int i_id) const
+{
+  return d_visible[i_id] != 0;
+}
+
+
+int VisibilityCuller::getTestedCount() const
+{
+  return (int)d_boxes.size();
+}
+
+int VisibilityCuller::getFrustumCulledCount() const
+{
+  return d_frustumCulledCount;
+}
+
+int VisibilityCuller::getHorizonCulledCount() const
+{
+  return d_horizonCulledCount;
+}
+
+
+void VisibilityCuller::cullFrustum()
+{
+  using T = Simd::Native;
+
+  // Padding boxes are at the origin and never looked at
+  const int count = (int)d_boxes.size();
+  const int paddedCount = (count + T::Width - 1) / T::Width * T::Width;
+  for (auto* values : { &d_centerX, &d_centerY, &d_centerZ, &d_extentX, &d_extentY, &d_extentZ })
+    values->resize(paddedCount, 0.0f);
+
+  for (int i = 0; i < paddedCount; i += T::Width)
+  {
+    const auto centerX = T::load(d_centerX.data() + i);
+    const auto centerY = T::load(d_centerY.data() + i);
+    const auto centerZ = T::load(d_centerZ.data() + i);
+    const auto extentX = T::load(d_extentX.data() + i);
+    const auto extentY = T::load(d_extentY.data() + i);
+    const auto extentZ = T::load(d_extentZ.data() + i);
+
+    // A box is out if it's entirely behind any of the planes
+    auto outside = T::zero();
+    for (const auto& plane : d_planes)
+    {
+      const auto a = T::set(plane[0]);
+      const auto b = T::set(plane[1]);
+      const auto c = T::set(plane[2]);
+
+      const auto distance = T::add(
+        T::add(T::mul(a, centerX), T::mul(b, centerY)),
+        T::add(T::mul(c, centerZ), T::set(plane[3])));
+      const auto radius = T::add(
+        T::add(T::mul(T::abs(a), extentX), T::mul(T::abs(b), extentY)),
+        T::mul(T::abs(c), extentZ));
+
+      outside = T::orMask(outside, T::less(T::add(distance, radius), T::zero()));
+    }
+
+    const int outsideBits = T::moveMask(outside);
+    for (int lane = 0; lane < T::Width && i + lane < count; ++lane)
+    {
+      if (outsideBits & (1 << lane))
+      {
+        d_visible[i + lane] = 0;
+        ++d_frustumCulledCount;
+      }
+    }
+  }
+}
+
+void VisibilityCuller::cullHorizon()
+{
+  if (d_occluders.empty())
+    return;
+
+  d_horizon.fill(-std::numeric_limits<float>::infinity());
+  const float binAngle = (float)Sdk::Pi2 / HorizonBinsCount;
+
+  // Boxes are tested nearest first against the horizon of the occluders entirely nearer
+  // than them, so an occluder never hides what's in front of it
+  std::vector<Footprint> occluderFootprints;
+  occluderFootprints.reserve(d_occluders.size());
+  std::vector<int> occluderOrder;
+  for (int i = 0; i < (int)d_occluders.size(); ++i)
+  {
+    occluderFootprints.push_back(getFootprint(d_occluders[i], d_eye));
+    if (!occluderFootprints.back().containsEye)
+      occluderOrder.push_back(i);
+  }
+  std::sort(occluderOrder.begin(), occluderOrder.end(), [&](const int i_left, const int i_right) {
+    return occluderFootprints[i_left].farthest < occluderFootprints[i_right].farthest;
+    });
+
+  std::vector<Footprint> footprints(d_boxes.size());
+  std::vector<int> order;
+  for (int i = 0; i < (int)d_boxes.size(); ++i)
+  {
+    if (!d_visible[i])
+      continue;
+    footprints[i] = getFootprint(d_boxes[i], d_eye);
+    if (!footprints[i].containsEye)
+      order.push_back(i);
+  }
+  std::sort(order.begin(), order.end(), [&](const int i_left, const int i_right) {
+    return footprints[i_left].nearest < footprints[i_right].nearest;
+    });
+
+  int nextOccluder = 0;
+  for (const int index : order)
+  {
+    const auto& footprint = footprints[index];
+
+    for (; nextOccluder < (int)occluderOrder.size(); ++nextOccluder)
+    {
+      const int occluderIndex = occluderOrder[nextOccluder];
+      const auto& occluderFootprint = occluderFootprints[occluderIndex];
+      if (occluderFootprint.farthest >= footprint.nearest)
+        break;
+
+      // The lowest slope that is blocked at every azimuth the occluder fully covers
+      const float height = d_occluders[occluderIndex].min.y - d_eye.y;
+      const float slope = height / (height >= 0 ? occluderFootprint.farthest : std::max(occluderFootprint.nearest, 1e-3f));
+
+      const int firstBin = (int)std::ceil(occluderFootprint.minAngle / binAngle);
+      const int lastBin = (int)std::floor(occluderFootprint.maxAngle / binAngle) - 1;
+      for (int bin = firstBin; bin <= lastBin; ++bin)
+      {
+        auto& horizon = d_horizon[getBin(bin, HorizonBinsCount)];
+        horizon = std::max(horizon, slope);
+      }
+    }
+
+    // The highest slope the box reaches, over every bin it touches
+    const float height = d_boxes[index].max.y - d_eye.y;
+    const float slope = height / (height >= 0 ? std::max(footprint.nearest, 1e-3f) : footprint.farthest);
+
+    bool occluded = true;
+    const int firstBin = (int)std::floor(footprint.minAngle / binAngle);
+    const int lastBin = (int)std::floor(footprint.maxAngle / binAngle);
+    for (int bin = firstBin; bin <= lastBin && occluded; ++bin)
+      occluded = slope < d_horizon[getBin(bin, HorizonBinsCount)];
+
+    if (occluded)
+    {
+      d_visible[index] = 0;
+      ++d_horizonCulledCount;
+    }
+  }
+}
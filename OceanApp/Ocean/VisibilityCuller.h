@@ -0,0 +1,64 @@
+#pragma once
+
+#include "BoundingBox.h"
+
+#include <array>
+#include <vector>
+
+
+// Row-major, for row vectors (v * M) and the D3D clip space, z from 0 to 1
+using Matrix4 = std::array<float, 16>;
+
+// Inside is where a * x + b * y + c * z + d >= 0: left, right, bottom, top, near, far
+using FrustumPlanes = std::array<std::array<float, 4>, 6>;
+
+FrustumPlanes getFrustumPlanes(const Matrix4& i_viewProjection);
+
+// Same as a left-handed look-at view times a perspective projection
+Matrix4 createViewProjection(const Sdk::Vector3F& i_eye, const Sdk::Vector3F& i_lookAt,
+  float i_fovY, float i_aspect, float i_near, float i_far);
+
+
+// Per-frame visibility of bounding boxes. Boxes are tested against the frustum planes taken
+// from the view-projection matrix, a SIMD vector of boxes at a time, and the ones left are
+// tested against the horizon of the occluders: terrain pages, i.e. boxes solid from their
+// minimum height down. Everything is conservative, a visible box is never culled
+class VisibilityCuller
+{
+public:
+  void begin(const Matrix4& i_viewProjection, const Sdk::Vector3F& i_eye);
+
+  // Returns the id to ask isVisible() about
+  int add(const BoundingBox& i_box);
+  void addOccluder(const BoundingBox& i_box);
+
+  void cull();
+
+  bool isVisible(int i_id) const;
+
+  int getTestedCount() const;
+  int getFrustumCulledCount() const;
+  int getHorizonCulledCount() const;
+
+private:
+  static constexpr int HorizonBinsCount = 256;
+
+  FrustumPlanes d_planes;
+  Sdk::Vector3F d_eye;
+
+  // Structure of arrays, padded to the SIMD width in cull()
+  std::vector<float> d_centerX, d_centerY, d_centerZ;
+  std::vector<float> d_extentX, d_extentY, d_extentZ;
+  std::vector<BoundingBox> d_boxes;
+  std::vector<BoundingBox> d_occluders;
+  std::vector<char> d_visible;
+
+  // Highest slope below which the view is blocked, per azimuth
+  std::array<float, HorizonBinsCount> d_horizon;
+
+  int d_frustumCulledCount = 0;
+  int d_horizonCulledCount = 0;
+
+  void cullFrustum();
+  void cullHorizon();
+};
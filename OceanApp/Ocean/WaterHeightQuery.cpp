@@ -0,0 +1,200 @@
+#include "stdafx.h"
+#include "WaterHeightQuery.h"
+
+#include "FftOcean.h"
+
+
+namespace
+{
+  // Gerstner waves move the surface sideways, so the point of the plane that ends up over the
+  // queried one has to be searched for. Converges quickly while the total steepness is below 1
+  constexpr int DisplacementIterations = 3;
+
+} // anonym NS
+
+
+WaterHeightQuery::WaterHeightQuery(const int i_cellsCount, const float i_cellSize)
+  : d_cellsCount(i_cellsCount)
+  , d_cellSize(i_cellSize)
+  , d_heights((i_cellsCount + 1) * (i_cellsCount + 1))
+{
+  CONTRACT_EXPECT(i_cellsCount > 0);
+  CONTRACT_EXPECT(i_cellSize > 0);
+}
+
+
+void WaterHeightQuery::update(const GerstnerWaves& i_waves, const Sdk::Vector3F& i_center)
+{
+  d_waves = i_waves;
+  d_fftOcean = nullptr;
+  d_center = i_center;
+  d_baked = false;
+  d_hitsCount = 0;
+  d_missesCount = 0;
+}
+
+void WaterHeightQuery::update(const FftOcean& i_ocean, const Sdk::Vector3F& i_center)
+{
+  d_fftOcean = &i_ocean;
+  d_center = i_center;
+  d_baked = false;
+  d_hitsCount = 0;
+  d_missesCount = 0;
+}
+
+
+void WaterHeightQuery::bake()
+{
+  d_baked = true;
+  ++d_totalBakesCount;
+
+  // Snapped to the cells, so the baked points don't swim when the center moves
+  const float halfSize = d_cellsCount * d_cellSize / 2;
+  d_originX = std::floor((d_center.x - halfSize) / d_cellSize) * d_cellSize;
+  d_originZ = std::floor((d_center.z - halfSize) / d_cellSize) * d_cellSize;
+
+  const int size = d_cellsCount + 1;
+  d_gridX.resize(size * size);
+  d_gridZ.resize(size * size);
+  for (int i = 0; i < size * size; ++i)
+  {
+    d_gridX[i] = d_originX + (i % size) * d_cellSize;
+    d_gridZ[i] = d_originZ + (i / size) * d_cellSize;
+  }
+
+  evaluate(size * size, d_gridX.data(), d_gridZ.data(), d_heights.data());
+}
+
+
+float WaterHeightQuery::getHeight(const float i_x, const float i_z)
+{
+  float height = 0;
+  getHeights(1, &i_x, &i_z, &height);
+  return height;
+}
+
+void WaterHeightQuery::getHeights(const int i_count, const float* i_x, const float* i_z, float* o_heights)
+{
+  if (!d_baked)
+    bake();
+
+  d_missIndices.clear();
+  for (int i = 0; i < i_count; ++i)
+  {
+    if (!tryGetBaked(i_x[i], i_z[i], o_heights[i]))
+      d_missIndices.push_back(i);
+  }
+
+  const int missesCount = (int)d_missIndices.size();
+  d_hitsCount += i_count - missesCount;
+  d_missesCount += missesCount;
+  d_totalHitsCount += i_count - missesCount;
+  d_totalMissesCount += missesCount;
+  if (missesCount == 0)
+    return;
+
+  d_x.resize(missesCount);
+  d_z.resize(missesCount);
+  d_heightsScratch.resize(missesCount);
+  for (int i = 0; i < missesCount; ++i)
+  {
+    d_x[i] = i_x[d_missIndices[i]];
+    d_z[i] = i_z[d_missIndices[i]];
+  }
+
+  evaluate(missesCount, d_x.data(), d_z.data(), d_heightsScratch.data());
+
+  for (int i = 0; i < missesCount; ++i)
+    o_heights[d_missIndices[i]] = d_heightsScratch[i];
+}
+
+
+int WaterHeightQuery::getHitsCount() const
+{
+  return d_hitsCount;
+}
+
+int WaterHeightQuery::getMissesCount() const
+{
+  return d_missesCount;
+}
+
+long long WaterHeightQuery::getTotalHitsCount() const
+{
+  return d_totalHitsCount;
+}
+
+long long WaterHeightQuery::getTotalMissesCount() const
+{
+  return d_totalMissesCount;
+}
+
+long long WaterHeightQuery::getTotalBakesCount() const
+{
+  return d_totalBakesCount;
+}
+
+
+bool WaterHeightQuery::tryGetBaked(const float i_x, const float i_z, float& o_height) const
+{
+  const float u = (i_x - d_originX) / d_cellSize;
+  const float v = (i_z - d_originZ) / d_cellSize;
+  if (!(u >= 0 && v >= 0 && u <= d_cellsCount && v <= d_cellsCount))
+    return false;
+
+  const int x0 = std::min((int)u, d_cellsCount - 1);
+  const int z0 = std::min((int)v, d_cellsCount - 1);
+  const float tx = u - x0;
+  const float tz = v - z0;
+
+  const int size = d_cellsCount + 1;
+  const float* row0 = d_heights.data() + z0 * size + x0;
+  const float* row1 = row0 + size;
+
+  const float h0 = row0[0] + (row0[1] - row0[0]) * tx;
+  const float h1 = row1[0] + (row1[1] - row1[0]) * tx;
+  o_height = h0 + (h1 - h0) * tz;
+  return true;
+}
+
+void WaterHeightQuery::evaluate(const int i_count, const float* i_x, const float* i_z, float* o_heights)
+{
+  for (auto* scratch : { &d_sourceX, &d_sourceZ, &d_displacedX, &d_displacedZ,
+    &d_normalX, &d_normalY, &d_normalZ })
+  {
+    if ((int)scratch->size() < i_count)
+      scratch->resize(i_count);
+  }
+
+  std::copy(i_x, i_x + i_count, d_sourceX.begin());
+  std::copy(i_z, i_z + i_count, d_sourceZ.begin());
+
+  for (int iteration = 0; iteration < DisplacementIterations; ++iteration)
+  {
+    if (d_fftOcean)
+    {
+      for (int i = 0; i < i_count; ++i)
+      {
+        const auto displacement = d_fftOcean->getDisplacement(d_sourceX[i], d_sourceZ[i]);
+        d_displacedX[i] = d_sourceX[i] + displacement.x;
+        o_heights[i] = displacement.y;
+        d_displacedZ[i] = d_sourceZ[i] + displacement.z;
+      }
+    }
+    else
+    {
+      d_waves.evaluate(i_count, d_sourceX.data(), d_sourceZ.data(),
+        d_displacedX.data(), o_heights, d_displacedZ.data(),
+        d_normalX.data(), d_normalY.data(), d_normalZ.data());
+    }
+
+    if (iteration == DisplacementIterations - 1)
+      break;
+
+    for (int i = 0; i < i_count; ++i)
+    {
+      d_sourceX[i] += i_x[i] - d_displacedX[i];
+      d_sourceZ[i] += i_z[i] - d_displacedZ[i];
+    }
+  }
+}
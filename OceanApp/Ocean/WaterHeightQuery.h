@@ -0,0 +1,65 @@
+#pragma once
+
+#include "GerstnerWaves.h"
+
+#include <vector>
+
+
+class FftOcean;
+
+
+// Water height at a point, with the horizontal displacement of the waves taken into account.
+// The first query after an update bakes the heights into a grid around the given center, so
+// nothing is baked while nobody asks; queries inside the grid are bilinear lookups, the ones
+// outside are evaluated exactly
+class WaterHeightQuery
+{
+public:
+  WaterHeightQuery(int i_cellsCount, float i_cellSize);
+
+  void update(const GerstnerWaves& i_waves, const Sdk::Vector3F& i_center);
+  // The same for the FFT ocean, which is read by the queries until the next update
+  void update(const FftOcean& i_ocean, const Sdk::Vector3F& i_center);
+
+  float getHeight(float i_x, float i_z);
+  void getHeights(int i_count, const float* i_x, const float* i_z, float* o_heights);
+
+  // Queries answered from the grid and evaluated exactly since the last update
+  int getHitsCount() const;
+  int getMissesCount() const;
+  // The same since the query was created, whatever reads them and whenever
+  long long getTotalHitsCount() const;
+  long long getTotalMissesCount() const;
+  long long getTotalBakesCount() const;
+
+private:
+  int d_cellsCount = 0;
+  float d_cellSize = 0;
+
+  GerstnerWaves d_waves;
+  // Used instead of the waves if set
+  const FftOcean* d_fftOcean = nullptr;
+  Sdk::Vector3F d_center;
+  bool d_baked = false;
+  float d_originX = 0;
+  float d_originZ = 0;
+  std::vector<float> d_heights;
+  std::vector<float> d_gridX, d_gridZ;
+
+  int d_hitsCount = 0;
+  int d_missesCount = 0;
+  long long d_totalHitsCount = 0;
+  long long d_totalMissesCount = 0;
+  long long d_totalBakesCount = 0;
+
+  // Scratch for the exact evaluation
+  std::vector<float> d_x, d_z, d_heightsScratch;
+  std::vector<float> d_sourceX, d_sourceZ;
+  std::vector<float> d_displacedX, d_displacedZ;
+  std::vector<float> d_normalX, d_normalY, d_normalZ;
+  std::vector<int> d_missIndices;
+
+  void bake();
+  bool tryGetBaked(float i_x, float i_z, float& o_height) const;
+  void evaluate(int i_count, const float* i_x, const float* i_z, float* o_heights);
+};
@@ -1,10 +1,20 @@
 #include "stdafx.h"
 
 #include "Game.h"
+#include "Profiler.h"
 
 
 int WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow)
 {
-  Game().run();
+  // "-fft" switches the ocean from the Gerstner waves to the FFT one
+  const bool useFft = lpCmdLine && std::string(lpCmdLine).find("-fft") != std::string::npos;
+  // "-roam" meshes the Gerstner ocean with the dynamic ROAM instead of the clipmap rings
+  const bool useRoam = lpCmdLine && std::string(lpCmdLine).find("-roam") != std::string::npos;
+  // "-profile" enables the profiler from the start, so that the loading is recorded too
+  if (lpCmdLine && std::string(lpCmdLine).find("-profile") != std::string::npos)
+    Profiler::get().setEnabled(true);
+  Game(
+    useFft ? WaveModel::Fft : WaveModel::Gerstner,
+    useRoam ? OceanMeshType::Roam : OceanMeshType::Clipmap).run();
   return 0;
 }
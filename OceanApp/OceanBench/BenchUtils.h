@@ -0,0 +1,106 @@
+#pragma once
+
+#include "GerstnerWaves.h"
+#include "HeightField.h"
+#include "SceneSettings.h"
+
+#include <LaggyDx/IShape3d.h>
+
+#include <LaggySdk/Math.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+
+// Runs the function i_repeats times and returns the best time in milliseconds
+template <typename TFunc>
+double measureMs(TFunc&& i_func, const int i_repeats = 3)
+{
+  double best = 0;
+  for (int i = 0; i < i_repeats; ++i)
+  {
+    const auto start = std::chrono::steady_clock::now();
+    i_func();
+    const auto end = std::chrono::steady_clock::now();
+
+    const double ms = std::chrono::duration<double, std::milli>(end - start).count();
+    if (i == 0 || ms < best)
+      best = ms;
+  }
+  return best;
+}
+
+// Byte-wise: the meshes are expected to be exactly the same, not just close
+inline bool areSameVerts(const std::vector<Dx::VertexPosNormText>& i_left, const std::vector<Dx::VertexPosNormText>& i_right)
+{
+  return i_left.size() == i_right.size() &&
+    (i_left.empty() || std::memcmp(i_left.data(), i_right.data(), i_left.size() * sizeof(i_left[0])) == 0);
+}
+
+// Peak resident memory of the process so far, 0 if unknown
+inline std::size_t getPeakMemoryBytes()
+{
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS counters{};
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    return 0;
+  return counters.PeakWorkingSetSize;
+#else
+  rusage usage{};
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0;
+  // Kilobytes on Linux
+  return (std::size_t)usage.ru_maxrss * 1024;
+#endif
+}
+
+// Stands in for height_map.png, which can't be decoded without a render device.
+// Same value range as the normalized one in Game::createTerrainPages
+inline HeightField createTestHeightField()
+{
+  constexpr int Size = 1024;
+  constexpr float MinHeight = -30;
+  constexpr float MaxHeight = 10;
+
+  HeightField heightField(Size, Size);
+  for (int y = 0; y < Size; ++y)
+  {
+    for (int x = 0; x < Size; ++x)
+    {
+      const float u = (float)x / Size;
+      const float v = (float)y / Size;
+      const float value =
+        std::sin(u * 7.1f) * std::cos(v * 5.3f) +
+        0.5f * std::sin(u * 23.0f + v * 17.0f) +
+        0.25f * std::cos(u * 61.0f - v * 47.0f);
+
+      heightField.setValue(x, y, MinHeight + (MaxHeight - MinHeight) * (value + 1.75f) / 3.5f);
+    }
+  }
+
+  return heightField;
+}
+
+// The game's starting waves, as its waves controls set them
+inline GerstnerWaves createDefaultWaves()
+{
+  GerstnerWaves waves;
+  for (int i = 0; i < (int)DefaultWaves.size(); ++i)
+  {
+    Sdk::Vector2D direction{ 1, 0 };
+    direction.rotate(Sdk::degToRad(DefaultWaves[i].direction));
+
+    waves.setWindDirection(i, direction);
+    waves.setWavesSteepness(i, DefaultWaves[i].steepness);
+    waves.setWavesLength(i, DefaultWaves[i].length);
+  }
+  return waves;
+}
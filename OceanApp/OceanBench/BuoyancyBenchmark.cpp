@@ -0,0 +1,67 @@
+#include "stdafx.h"
+#include "BuoyancyBenchmark.h"
+
+#include "BenchUtils.h"
+
+#include "BuoyancySystem.h"
+#include "GerstnerWaves.h"
+
+
+namespace
+{
+  const std::vector<int> BodiesCounts{ 100, 1000, 10000 };
+  constexpr int StepsCount = 60;
+
+  GerstnerWaves createWaves()
+  {
+    GerstnerWaves waves;
+    waves.setWindDirection(0, { 1, 0 });
+    waves.setWavesSteepness(0, 0.15);
+    waves.setWavesLength(0, 15);
+    waves.setWindDirection(1, { 0.6, 0.8 });
+    waves.setWavesSteepness(1, 0.15);
+    waves.setWavesLength(1, 7);
+    return waves;
+  }
+
+} // anonym NS
+
+
+void runBuoyancyBenchmark()
+{
+  // Boat-like bodies, 8 hull samples each, scattered over the ocean
+  std::vector<Sdk::Vector3F> hullSamples;
+  for (const float x : { -0.4f, 0.4f })
+  {
+    for (const float z : { -1.5f, -0.5f, 0.5f, 1.5f })
+      hullSamples.push_back({ x, 0, z });
+  }
+
+  std::printf("Buoyancy (%d samples per body, %d steps)\n", (int)hullSamples.size(), StepsCount);
+  std::printf("   bodies  ms/step  us/body\n");
+
+  for (const int bodiesCount : BodiesCounts)
+  {
+    BuoyancySystem buoyancy;
+    for (int i = 0; i < bodiesCount; ++i)
+    {
+      const Sdk::Vector3F position{ (float)(i % 100) * 2, 0, (float)(i / 100) * 4 };
+      buoyancy.addBody(150, 1, position, hullSamples, 0.25f);
+    }
+
+    auto waves = createWaves();
+    waves.setGlobalTime(0);
+    buoyancy.update(waves);
+
+    double totalMs = 0;
+    for (int step = 1; step <= StepsCount; ++step)
+    {
+      waves.setGlobalTime(step * BuoyancySystem::FixedDt);
+      buoyancy.update(waves);
+      totalMs += buoyancy.getLastStepMs() * buoyancy.getLastStepsCount();
+    }
+
+    const double stepMs = totalMs / StepsCount;
+    std::printf("  %7d %8.3f %8.3f\n", bodiesCount, stepMs, stepMs * 1e3 / bodiesCount);
+  }
+}
@@ -0,0 +1,181 @@
+#include "stdafx.h"
+#include "CullingBenchmark.h"
+
+#include "BenchUtils.h"
+
+#include "VisibilityCuller.h"
+
+#include <LaggySdk/Math.h>
+
+#include <random>
+
+
+namespace
+{
+  constexpr int BoxesCount = 10000;
+  constexpr int PageSize = 128;
+  // Per box edge, for the dense check of the horizon culling
+  constexpr int BoxSamplesCount = 6;
+
+  // Scalar reference: the box is out if all of its corners are out of the same clip plane
+  bool isOutsideFrustum(const BoundingBox& i_box, const Matrix4& i_viewProjection)
+  {
+    int outsideMasks = 0x3f;
+    for (int corner = 0; corner < 8; ++corner)
+    {
+      const float x = corner & 1 ? i_box.max.x : i_box.min.x;
+      const float y = corner & 2 ? i_box.max.y : i_box.min.y;
+      const float z = corner & 4 ? i_box.max.z : i_box.min.z;
+
+      float clip[4];
+      for (int i = 0; i < 4; ++i)
+        clip[i] = x * i_viewProjection[i] + y * i_viewProjection[4 + i] + z * i_viewProjection[8 + i] + i_viewProjection[12 + i];
+
+      int mask = 0;
+      mask |= clip[0] < -clip[3] ? 1 : 0;
+      mask |= clip[0] > clip[3] ? 2 : 0;
+      mask |= clip[1] < -clip[3] ? 4 : 0;
+      mask |= clip[1] > clip[3] ? 8 : 0;
+      mask |= clip[2] < 0 ? 16 : 0;
+      mask |= clip[2] > clip[3] ? 32 : 0;
+      outsideMasks &= mask;
+    }
+    return outsideMasks != 0;
+  }
+
+  // Marches from the eye to the point, looking for the solid part of an occluder
+  bool isHidden(const Sdk::Vector3F& i_eye, const Sdk::Vector3F& i_point, const std::vector<BoundingBox>& i_occluders)
+  {
+    constexpr int StepsCount = 512;
+    for (int step = 1; step < StepsCount; ++step)
+    {
+      const float t = (float)step / StepsCount;
+      const auto sample = i_eye + (i_point - i_eye) * t;
+      for (const auto& occluder : i_occluders)
+      {
+        if (sample.x >= occluder.min.x && sample.x <= occluder.max.x &&
+          sample.z >= occluder.min.z && sample.z <= occluder.max.z &&
+          sample.y < occluder.min.y)
+        {
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  // Some point of the box can be seen. Checks the corners only, or a grid over the faces too:
+  // a box can have its corners hidden and the middle of a face above the horizon
+  bool isPartlyVisible(const BoundingBox& i_box, const Sdk::Vector3F& i_eye,
+    const std::vector<BoundingBox>& i_occluders, const int i_samplesPerEdge)
+  {
+    const int last = i_samplesPerEdge - 1;
+    for (int i = 0; i < i_samplesPerEdge; ++i)
+    {
+      for (int j = 0; j < i_samplesPerEdge; ++j)
+      {
+        for (int k = 0; k < i_samplesPerEdge; ++k)
+        {
+          // Inside points can't be seen if the faces can't
+          if (i != 0 && i != last && j != 0 && j != last && k != 0 && k != last)
+            continue;
+
+          const Sdk::Vector3F point = {
+            i_box.min.x + (i_box.max.x - i_box.min.x) * i / last,
+            i_box.min.y + (i_box.max.y - i_box.min.y) * j / last,
+            i_box.min.z + (i_box.max.z - i_box.min.z) * k / last };
+          if (!isHidden(i_eye, point, i_occluders))
+            return true;
+        }
+      }
+    }
+    return false;
+  }
+
+} // anonym NS
+
+
+void runCullingBenchmark()
+{
+  const auto heightField = createTestHeightField();
+
+  // Terrain pages of the test height field, a hill in front of the camera
+  std::vector<BoundingBox> pages;
+  for (int pageZ = 0; pageZ + PageSize < heightField.getHeight(); pageZ += PageSize)
+  {
+    for (int pageX = 0; pageX + PageSize < heightField.getWidth(); pageX += PageSize)
+    {
+      const float height = heightField.getValue(pageX, pageZ);
+      BoundingBox page{ { (float)pageX, height, (float)pageZ }, { (float)pageX, height, (float)pageZ } };
+      for (int z = pageZ; z <= pageZ + PageSize; ++z)
+      {
+        for (int x = pageX; x <= pageX + PageSize; ++x)
+          page.expand(Sdk::Vector3F{ (float)x, heightField.getValue(x, z), (float)z });
+      }
+      pages.push_back(page);
+    }
+  }
+  pages.push_back({ { 300, -30, 300 }, { 400, 40, 400 } });
+
+  std::mt19937 random(1);
+  std::uniform_real_distribution<float> position(0, (float)heightField.getWidth());
+  std::uniform_real_distribution<float> height(-30, 15);
+  std::uniform_real_distribution<float> size(0.5f, 4);
+  std::vector<BoundingBox> boxes;
+  for (int i = 0; i < BoxesCount; ++i)
+  {
+    const Sdk::Vector3F min = { position(random), height(random), position(random) };
+    boxes.push_back({ min, min + Sdk::Vector3F{ size(random), size(random), size(random) } });
+  }
+
+  const Sdk::Vector3F eye = { 200, 5, 200 };
+  const auto viewProjection = createViewProjection(eye, { 600, 5, 600 }, (float)Sdk::Pi / 3, 16.0f / 9, 0.1f, 2000);
+
+  std::printf("Visibility culling (%d boxes, %d occluders)\n", BoxesCount, (int)pages.size());
+  std::printf("  pass        ms  frustum  horizon  visible  mismatches  sampled\n");
+
+  // Frustum only, against the scalar reference
+  VisibilityCuller culler;
+  const double frustumMs = measureMs([&]() {
+    culler.begin(viewProjection, eye);
+    for (const auto& box : boxes)
+      culler.add(box);
+    culler.cull();
+    });
+
+  int frustumMismatches = 0;
+  for (int i = 0; i < BoxesCount; ++i)
+  {
+    if (culler.isVisible(i) == isOutsideFrustum(boxes[i], viewProjection))
+      ++frustumMismatches;
+  }
+  std::printf("  %-8s %6.3f %8d %8d %8d %11d %8s\n", "frustum", frustumMs, culler.getFrustumCulledCount(),
+    culler.getHorizonCulledCount(), BoxesCount - culler.getFrustumCulledCount(), frustumMismatches, "-");
+
+  // With the horizon. Mismatches are boxes culled while some of their corners can be seen,
+  // sampled ones while some point of a grid over their faces can
+  const double horizonMs = measureMs([&]() {
+    culler.begin(viewProjection, eye);
+    for (const auto& box : boxes)
+      culler.add(box);
+    for (const auto& page : pages)
+      culler.addOccluder(page);
+    culler.cull();
+    });
+
+  int horizonMismatches = 0;
+  int sampledMismatches = 0;
+  for (int i = 0; i < BoxesCount; ++i)
+  {
+    if (culler.isVisible(i) || isOutsideFrustum(boxes[i], viewProjection))
+      continue;
+
+    if (isPartlyVisible(boxes[i], eye, pages, 2))
+      ++horizonMismatches;
+    if (isPartlyVisible(boxes[i], eye, pages, BoxSamplesCount))
+      ++sampledMismatches;
+  }
+  const int visibleCount = BoxesCount - culler.getFrustumCulledCount() - culler.getHorizonCulledCount();
+  std::printf("  %-8s %6.3f %8d %8d %8d %11d %8d\n", "horizon", horizonMs, culler.getFrustumCulledCount(),
+    culler.getHorizonCulledCount(), visibleCount, horizonMismatches, sampledMismatches);
+}
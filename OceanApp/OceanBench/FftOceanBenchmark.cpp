@@ -0,0 +1,53 @@
+#include "stdafx.h"
+#include "FftOceanBenchmark.h"
+
+#include "BenchUtils.h"
+
+#include "FftOcean.h"
+#include "ThreadPool.h"
+
+#include <LaggyDx/Shape3d.h>
+
+#include <thread>
+
+
+namespace
+{
+  const std::vector<int> Resolutions{ 128, 256, 512 };
+
+} // anonym NS
+
+
+void runFftOceanBenchmark()
+{
+  const int maxThreadsCount = std::max((int)std::thread::hardware_concurrency(), 1);
+  std::vector<int> threadsCounts{ 1 };
+  if (maxThreadsCount > 1)
+    threadsCounts.push_back(maxThreadsCount);
+
+  std::printf("FFT ocean (JONSWAP, 64 m tile, per frame)\n");
+  std::printf("  resolution  threads  update ms  mesh ms\n");
+
+  for (const int resolution : Resolutions)
+  {
+    FftOceanSettings settings;
+    settings.resolution = resolution;
+    FftOcean ocean(settings);
+
+    for (const int threadsCount : threadsCounts)
+    {
+      ThreadPool pool(threadsCount);
+
+      double time = 0;
+      const double updateMs = measureMs([&]() {
+        time += 1.0 / 60;
+        ocean.update(time, pool);
+        }, 10);
+      // The mesh is created once and rewritten in place every frame
+      const auto shape = ocean.createShape();
+      const double meshMs = measureMs([&]() { ocean.updateShape(*shape); });
+
+      std::printf("  %10d %8d %10.2f %8.2f\n", resolution, threadsCount, updateMs, meshMs);
+    }
+  }
+}
@@ -0,0 +1,68 @@
+#include "stdafx.h"
+#include "FrameTimeBenchmark.h"
+
+#include "BenchUtils.h"
+
+#include "FrameTimeStats.h"
+
+#include <algorithm>
+#include <random>
+
+
+namespace
+{
+  constexpr int FramesCount = 100000;
+  // A stutter every so many frames, on top of the jitter
+  constexpr int HitchPeriod = 997;
+
+  std::vector<double> createFrameTimes()
+  {
+    std::mt19937 random(42);
+    std::normal_distribution<double> jitterDist(0, 0.8);
+    std::uniform_real_distribution<double> hitchDist(60, 250);
+
+    std::vector<double> frameTimes(FramesCount);
+    for (int i = 0; i < FramesCount; ++i)
+    {
+      frameTimes[i] = std::max(1000.0 / 60 + jitterDist(random), 1.0);
+      if (i % HitchPeriod == HitchPeriod - 1)
+        frameTimes[i] = hitchDist(random);
+    }
+    return frameTimes;
+  }
+
+  // Nearest rank, as FrameTimeStats does
+  double getExactPercentile(std::vector<double> i_values, const double i_percentile)
+  {
+    std::sort(i_values.begin(), i_values.end());
+    const int rank = std::max((int)std::ceil(i_percentile / 100 * i_values.size()), 1);
+    return i_values[rank - 1];
+  }
+
+} // anonym NS
+
+
+void runFrameTimeBenchmark()
+{
+  const auto frameTimes = createFrameTimes();
+
+  FrameTimeStats stats;
+  const double ms = measureMs([&]() {
+    for (const double frameMs : frameTimes)
+      stats.addFrame(frameMs);
+    }, 1);
+
+  std::printf("Frame time stats (%d frames, window %d)\n", FramesCount, FrameTimeStats::WindowSize);
+  std::printf("  add ns %.1f, hitches %d of %d\n",
+    ms * 1e6 / FramesCount, stats.getHitchesCount(), FramesCount / HitchPeriod);
+  std::printf("  percentile  histogram ms  exact ms  error %%\n");
+
+  const std::vector<double> window(frameTimes.end() - FrameTimeStats::WindowSize, frameTimes.end());
+  for (const double percentile : { 50.0, 95.0, 99.0, 100.0 })
+  {
+    const double histogramMs = stats.getPercentileMs(percentile);
+    const double exactMs = getExactPercentile(window, percentile);
+    std::printf("  %10.0f %13.3f %9.3f %8.2f\n",
+      percentile, histogramMs, exactMs, 100 * std::abs(histogramMs - exactMs) / exactMs);
+  }
+}
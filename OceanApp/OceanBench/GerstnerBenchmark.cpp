@@ -0,0 +1,86 @@
+#include "stdafx.h"
+#include "GerstnerBenchmark.h"
+
+#include "BenchUtils.h"
+
+#include "GerstnerWaves.h"
+
+
+namespace
+{
+  constexpr int GridSize = 1024;
+  constexpr double Time = 1234.5;
+
+  struct Points
+  {
+    std::vector<float> x, y, z;
+    std::vector<float> normalX, normalY, normalZ;
+
+    Points(const int i_count)
+      : x(i_count), y(i_count), z(i_count), normalX(i_count), normalY(i_count), normalZ(i_count)
+    {
+    }
+  };
+
+} // anonym NS
+
+
+void runGerstnerBenchmark()
+{
+  auto waves = createDefaultWaves();
+  waves.setGlobalTime(Time);
+
+  // A 200 x 200 m patch around the world center, as the ocean in the game
+  constexpr int Count = GridSize * GridSize;
+  std::vector<float> inputX(Count);
+  std::vector<float> inputZ(Count);
+  for (int i = 0; i < Count; ++i)
+  {
+    inputX[i] = (float)(i % GridSize) * 200.0f / GridSize;
+    inputZ[i] = (float)(i / GridSize) * 200.0f / GridSize;
+  }
+
+  Points reference(Count);
+  const double scalarMs = measureMs([&]() {
+    for (int i = 0; i < Count; ++i)
+    {
+      Sdk::Vector3F position;
+      Sdk::Vector3F normal;
+      waves.evaluate(inputX[i], inputZ[i], position, normal);
+
+      reference.x[i] = position.x;
+      reference.y[i] = position.y;
+      reference.z[i] = position.z;
+      reference.normalX[i] = normal.x;
+      reference.normalY[i] = normal.y;
+      reference.normalZ[i] = normal.z;
+    }
+    });
+
+  Points result(Count);
+  const double simdMs = measureMs([&]() {
+    waves.evaluate(Count, inputX.data(), inputZ.data(),
+      result.x.data(), result.y.data(), result.z.data(),
+      result.normalX.data(), result.normalY.data(), result.normalZ.data());
+    });
+
+  float maxPositionError = 0;
+  float maxNormalError = 0;
+  for (int i = 0; i < Count; ++i)
+  {
+    maxPositionError = std::max({ maxPositionError,
+      std::abs(result.x[i] - reference.x[i]),
+      std::abs(result.y[i] - reference.y[i]),
+      std::abs(result.z[i] - reference.z[i]) });
+    maxNormalError = std::max({ maxNormalError,
+      std::abs(result.normalX[i] - reference.normalX[i]),
+      std::abs(result.normalY[i] - reference.normalY[i]),
+      std::abs(result.normalZ[i] - reference.normalZ[i]) });
+  }
+
+  std::printf("Gerstner waves (%d points, %d waves)\n", Count, GerstnerWaves::WavesCount);
+  std::printf("  evaluator       ms  Mpoints/s\n");
+  std::printf("  scalar    %8.2f %10.1f\n", scalarMs, Count / scalarMs / 1e3);
+  std::printf("  simd      %8.2f %10.1f\n", simdMs, Count / simdMs / 1e3);
+  std::printf("  max difference from scalar: position %.2e m, normal %.2e\n", maxPositionError, maxNormalError);
+}
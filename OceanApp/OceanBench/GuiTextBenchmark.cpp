@@ -0,0 +1,115 @@
+#include "stdafx.h"
+#include "GuiTextBenchmark.h"
+
+#include "BenchUtils.h"
+
+#include "AllocationCounter.h"
+#include "TextBuffer.h"
+
+#include <string>
+
+
+namespace
+{
+  constexpr int FramesCount = 10000;
+  // GuiController refreshes the overlay at 4 Hz, every 15th frame at 60 FPS
+  constexpr int RefreshFramesCount = 15;
+
+  // Values like the ones of the overlay, changing every frame
+  struct Overlay
+  {
+    int fps = 0;
+    double p50Ms = 0;
+    double p99Ms = 0;
+    float x = 0, y = 0, z = 0;
+    int culled = 0;
+    int tested = 0;
+    double recordMs = 0;
+  };
+
+  Overlay getOverlay(const int i_frame)
+  {
+    return { 60 + i_frame % 3, 16.6 + i_frame % 7 * 0.1, 20.1 + i_frame % 5,
+      100.5f + i_frame * 0.01f, 3.25f, -40.75f - i_frame * 0.02f,
+      i_frame % 100, 1200, 0.25 + i_frame % 11 * 0.01 };
+  }
+
+  // The way the overlay was built before
+  std::string formatConcatenated(const Overlay& i_overlay)
+  {
+    return "FPS: " + std::to_string(i_overlay.fps) + "\n" +
+      "Frame: p50 " + std::to_string(i_overlay.p50Ms) + ", p99 " + std::to_string(i_overlay.p99Ms) + " ms\n" +
+      "Pos: " + std::to_string(i_overlay.x) + ", " + std::to_string(i_overlay.y) + ", " + std::to_string(i_overlay.z) + "\n" +
+      "Culled: " + std::to_string(i_overlay.culled) + " of " + std::to_string(i_overlay.tested) + "\n" +
+      "Recording: " + std::to_string(i_overlay.recordMs) + " ms";
+  }
+
+  void formatInPlace(const Overlay& i_overlay, TextBuffer& io_text)
+  {
+    io_text.clear();
+    io_text.append("FPS: ");
+    io_text.appendInt(i_overlay.fps);
+    io_text.append("\nFrame: p50 ");
+    io_text.appendFloat(i_overlay.p50Ms, 1);
+    io_text.append(", p99 ");
+    io_text.appendFloat(i_overlay.p99Ms, 1);
+    io_text.append(" ms\nPos: ");
+    io_text.appendFloat(i_overlay.x, 2);
+    io_text.append(", ");
+    io_text.appendFloat(i_overlay.y, 2);
+    io_text.append(", ");
+    io_text.appendFloat(i_overlay.z, 2);
+    io_text.append("\nCulled: ");
+    io_text.appendInt(i_overlay.culled);
+    io_text.append(" of ");
+    io_text.appendInt(i_overlay.tested);
+    io_text.append("\nRecording: ");
+    io_text.appendFloat(i_overlay.recordMs, 2);
+    io_text.append(" ms");
+  }
+
+} // anonym NS
+
+
+void runGuiTextBenchmark()
+{
+  std::printf("GUI text (%d frames)\n", FramesCount);
+  std::printf("  path          ns/frame  allocations/frame\n");
+
+  std::size_t totalSize = 0;
+  auto allocationsCount = getThreadAllocationsCount();
+  const double concatenatedMs = measureMs([&]() {
+    for (int frame = 0; frame < FramesCount; ++frame)
+      totalSize += formatConcatenated(getOverlay(frame)).size();
+    }, 1);
+  const auto concatenatedAllocations = getThreadAllocationsCount() - allocationsCount;
+
+  // As GuiController keeps them, refreshed every few frames
+  TextBuffer text;
+  std::string labelText;
+  int changesCount = 0;
+  allocationsCount = getThreadAllocationsCount();
+  const double inPlaceMs = measureMs([&]() {
+    for (int frame = 0; frame < FramesCount; ++frame)
+    {
+      if (frame % RefreshFramesCount != 0)
+        continue;
+
+      formatInPlace(getOverlay(frame), text);
+      if (text.getText() != labelText)
+      {
+        labelText.assign(text.getText());
+        ++changesCount;
+      }
+      totalSize += text.getText().size();
+    }
+    }, 1);
+  const auto inPlaceAllocations = getThreadAllocationsCount() - allocationsCount;
+
+  std::printf("  %-12s %9.1f %18.2f\n", "concatenated",
+    concatenatedMs * 1e6 / FramesCount, (double)concatenatedAllocations / FramesCount);
+  std::printf("  %-12s %9.1f %18.2f\n", "in place",
+    inPlaceMs * 1e6 / FramesCount, (double)inPlaceAllocations / FramesCount);
+  std::printf("  label set %d times of %d, %d allocations in total (%zu chars)\n",
+    changesCount, FramesCount, (int)inPlaceAllocations, totalSize);
+}
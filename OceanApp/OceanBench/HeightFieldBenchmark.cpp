@@ -0,0 +1,212 @@
+#include "stdafx.h"
+#include "HeightFieldBenchmark.h"
+
+#include "BenchUtils.h"
+
+#include "HeightField.h"
+
+
+namespace
+{
+  const std::vector<int> Sizes{ 1024, 4096, 16384 };
+  // Normals of a larger map take 3 GB twice
+  constexpr int MaxNormalsSize = 4096;
+
+  float getMaxDifference(const std::vector<float>& i_left, const std::vector<float>& i_right)
+  {
+    float maxDifference = 0;
+    for (std::size_t i = 0; i < i_left.size(); ++i)
+      maxDifference = std::max(maxDifference, std::abs(i_left[i] - i_right[i]));
+    return maxDifference;
+  }
+
+  void printRow(const char* i_kernel, const int i_size, const double i_scalarMs, const double i_simdMs, const float i_maxDifference)
+  {
+    std::printf("  %-10s %6d %10.2f %8.2f %8.2f %10.1e\n",
+      i_kernel, i_size, i_scalarMs, i_simdMs, i_scalarMs / i_simdMs, i_maxDifference);
+  }
+
+
+  // The plain per-texel loops the kernels replace
+
+  HeightField fromPixelsScalar(const std::vector<std::uint8_t>& i_pixels, const int i_size)
+  {
+    HeightField heightField(i_size, i_size);
+    for (int y = 0; y < i_size; ++y)
+    {
+      for (int x = 0; x < i_size; ++x)
+        heightField.setValue(x, y, i_pixels[((std::size_t)y * i_size + x) * 4] / 255.0f);
+    }
+    return heightField;
+  }
+
+  void getMinMaxScalar(const HeightField& i_heightField, float& o_min, float& o_max)
+  {
+    o_min = i_heightField.getValues().front();
+    o_max = o_min;
+    for (const float value : i_heightField.getValues())
+    {
+      o_min = std::min(o_min, value);
+      o_max = std::max(o_max, value);
+    }
+  }
+
+  void normalizeScalar(HeightField& io_heightField, const float i_min, const float i_max)
+  {
+    float min = 0;
+    float max = 0;
+    getMinMaxScalar(io_heightField, min, max);
+
+    for (float& value : io_heightField.getValues())
+      value = i_min + (value - min) / (max - min) * (i_max - i_min);
+  }
+
+  HeightField resampleScalar(const HeightField& i_heightField, const int i_size)
+  {
+    HeightField heightField(i_size, i_size);
+    const float step = 1.0f / (i_size - 1);
+    for (int y = 0; y < i_size; ++y)
+    {
+      for (int x = 0; x < i_size; ++x)
+        heightField.setValue(x, y, i_heightField.sample(x * step, y * step));
+    }
+    return heightField;
+  }
+
+  std::vector<HeightField> createMipsScalar(const HeightField& i_heightField)
+  {
+    std::vector<HeightField> mips;
+    const HeightField* source = &i_heightField;
+    while (source->getWidth() > 1 || source->getHeight() > 1)
+    {
+      HeightField mip((source->getWidth() + 1) / 2, (source->getHeight() + 1) / 2);
+      for (int y = 0; y < mip.getHeight(); ++y)
+      {
+        for (int x = 0; x < mip.getWidth(); ++x)
+        {
+          const int x1 = std::min(2 * x + 1, source->getWidth() - 1);
+          const int y1 = std::min(2 * y + 1, source->getHeight() - 1);
+          mip.setValue(x, y, (source->getValue(2 * x, 2 * y) + source->getValue(x1, 2 * y) +
+            source->getValue(2 * x, y1) + source->getValue(x1, y1)) * 0.25f);
+        }
+      }
+      mips.push_back(std::move(mip));
+      source = &mips.back();
+    }
+    return mips;
+  }
+
+  std::vector<Sdk::Vector3F> createNormalsScalar(const HeightField& i_heightField, const float i_cellSize)
+  {
+    const int width = i_heightField.getWidth();
+    const int height = i_heightField.getHeight();
+
+    std::vector<Sdk::Vector3F> normals((std::size_t)width * height);
+    for (int y = 0; y < height; ++y)
+    {
+      for (int x = 0; x < width; ++x)
+      {
+        const int x0 = std::max(x - 1, 0);
+        const int x1 = std::min(x + 1, width - 1);
+        const int y0 = std::max(y - 1, 0);
+        const int y1 = std::min(y + 1, height - 1);
+        const float dx = (i_heightField.getValue(x1, y) - i_heightField.getValue(x0, y)) / ((x1 - x0) * i_cellSize);
+        const float dz = (i_heightField.getValue(x, y1) - i_heightField.getValue(x, y0)) / ((y1 - y0) * i_cellSize);
+        normals[(std::size_t)y * width + x] = Sdk::Vector3F{ -dx, 1, -dz }.getNormalized();
+      }
+    }
+    return normals;
+  }
+
+
+  void runSize(const int i_size)
+  {
+    // The large maps are slow enough to be measured once
+    const int repeats = i_size > 4096 ? 1 : 3;
+
+    HeightField heightField;
+    {
+      const auto reference = createTestHeightField();
+      std::vector<std::uint8_t> pixels((std::size_t)i_size * i_size * 4);
+      for (int y = 0; y < i_size; ++y)
+      {
+        for (int x = 0; x < i_size; ++x)
+        {
+          const float value = reference.sample((float)x / (i_size - 1), (float)y / (i_size - 1));
+          pixels[((std::size_t)y * i_size + x) * 4] = (std::uint8_t)((value + 30) / 40 * 255);
+        }
+      }
+
+      HeightField scalar;
+      const double scalarMs = measureMs([&]() { scalar = fromPixelsScalar(pixels, i_size); }, repeats);
+      const double simdMs = measureMs([&]() {
+        heightField = HeightField::fromPixels(pixels.data(), i_size, i_size, 4, i_size * 4);
+        }, repeats);
+      printRow("pixels", i_size, scalarMs, simdMs, getMaxDifference(scalar.getValues(), heightField.getValues()));
+    }
+
+    {
+      float scalarMin = 0, scalarMax = 0, simdMin = 0, simdMax = 0;
+      const double scalarMs = measureMs([&]() { getMinMaxScalar(heightField, scalarMin, scalarMax); }, repeats);
+      const double simdMs = measureMs([&]() { heightField.getMinMax(simdMin, simdMax); }, repeats);
+      printRow("min/max", i_size, scalarMs, simdMs, std::max(std::abs(scalarMin - simdMin), std::abs(scalarMax - simdMax)));
+    }
+
+    {
+      auto scalar = heightField;
+      auto simd = heightField;
+      const double scalarMs = measureMs([&]() { normalizeScalar(scalar, -30, 10); }, repeats);
+      const double simdMs = measureMs([&]() { simd.normalize(-30, 10); }, repeats);
+      printRow("normalize", i_size, scalarMs, simdMs, getMaxDifference(scalar.getValues(), simd.getValues()));
+      heightField = std::move(simd);
+    }
+
+    {
+      const int size = i_size * 3 / 4 + 1;
+      HeightField scalar;
+      HeightField simd;
+      const double scalarMs = measureMs([&]() { scalar = resampleScalar(heightField, size); }, repeats);
+      const double simdMs = measureMs([&]() { simd = heightField.resample(size, size); }, repeats);
+      printRow("resample", i_size, scalarMs, simdMs, getMaxDifference(scalar.getValues(), simd.getValues()));
+    }
+
+    {
+      std::vector<HeightField> scalar;
+      std::vector<HeightField> simd;
+      const double scalarMs = measureMs([&]() { scalar = createMipsScalar(heightField); }, repeats);
+      const double simdMs = measureMs([&]() { simd = heightField.createMips(); }, repeats);
+
+      float maxDifference = 0;
+      for (std::size_t level = 0; level < scalar.size(); ++level)
+        maxDifference = std::max(maxDifference, getMaxDifference(scalar[level].getValues(), simd[level].getValues()));
+      printRow("mips", i_size, scalarMs, simdMs, maxDifference);
+    }
+
+    if (i_size <= MaxNormalsSize)
+    {
+      std::vector<Sdk::Vector3F> scalar;
+      std::vector<Sdk::Vector3F> simd;
+      const double scalarMs = measureMs([&]() { scalar = createNormalsScalar(heightField, 1); }, repeats);
+      const double simdMs = measureMs([&]() { simd = heightField.createNormals(1); }, repeats);
+
+      float maxDifference = 0;
+      for (std::size_t i = 0; i < scalar.size(); ++i)
+      {
+        maxDifference = std::max({ maxDifference,
+          std::abs(scalar[i].x - simd[i].x), std::abs(scalar[i].y - simd[i].y), std::abs(scalar[i].z - simd[i].z) });
+      }
+      printRow("normals", i_size, scalarMs, simdMs, maxDifference);
+    }
+  }
+
+} // anonym NS
+
+
+void runHeightFieldBenchmark()
+{
+  std::printf("Height field kernels\n");
+  std::printf("  kernel       size  scalar ms  simd ms  speedup  max diff\n");
+
+  for (const int size : Sizes)
+    runSize(size);
+}
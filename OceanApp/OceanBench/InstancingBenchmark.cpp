@@ -0,0 +1,65 @@
+#include "stdafx.h"
+#include "InstancingBenchmark.h"
+
+#include "BenchUtils.h"
+
+#include "AllocationCounter.h"
+#include "InstanceBatcher.h"
+
+#include <random>
+
+
+namespace
+{
+  constexpr int ModelsCount = 256;
+  const std::vector<int> ObjectsCounts{ 1000, 10000, 100000 };
+
+  struct Object
+  {
+    int modelId = 0;
+  };
+
+  // Buoys and debris scattered over the ocean, in no particular order
+  std::vector<Object> createObjects(const int i_count)
+  {
+    std::mt19937 random(42);
+    std::uniform_int_distribution<int> modelDist(0, ModelsCount - 1);
+
+    std::vector<Object> objects(i_count);
+    for (auto& object : objects)
+    {
+      object.modelId = modelDist(random);
+    }
+
+    return objects;
+  }
+
+} // anonym NS
+
+
+void runInstancingBenchmark()
+{
+  std::printf("Instance batching (%d models)\n", ModelsCount);
+  std::printf("  objects  batches       ms  ns/object  allocations\n");
+
+  for (const int objectsCount : ObjectsCounts)
+  {
+    const auto objects = createObjects(objectsCount);
+
+    // Warm up once, so the batcher's buffers are allocated as they would be after the first frame
+    InstanceBatcher batcher;
+    const auto build = [&]() {
+      batcher.clear();
+      for (int i = 0; i < (int)objects.size(); ++i)
+        batcher.add(objects[i].modelId, i);
+      batcher.build();
+    };
+    build();
+
+    const auto allocationsCount = getThreadAllocationsCount();
+    const double ms = measureMs(build, 10);
+    const auto allocations = getThreadAllocationsCount() - allocationsCount;
+    std::printf("  %7d %8d %8.3f %10.1f %12d\n",
+      objectsCount, (int)batcher.getBatches().size(), ms, ms * 1e6 / objectsCount, (int)allocations);
+  }
+}
@@ -0,0 +1,58 @@
+#include "stdafx.h"
+#include "MeshFileBenchmark.h"
+
+#include "BenchUtils.h"
+
+#include "MeshFileCache.h"
+#include "ParallelRoam.h"
+#include "RoamPredicates.h"
+#include "ThreadPool.h"
+
+#include <LaggyDx/IShape3d.h>
+
+#include <thread>
+
+
+void runMeshFileBenchmark()
+{
+  const auto heightField = createTestHeightField();
+  ThreadPool pool(std::max((int)std::thread::hardware_concurrency(), 1));
+
+  const MeshFileCache cache(std::filesystem::temp_directory_path() / "OceanBench");
+  const auto key = MeshFileCache::getKey(heightField, SurfaceMaxDepth, SurfacePredicateVersion);
+  const double keyMs = measureMs([&]() {
+    MeshFileCache::getKey(heightField, SurfaceMaxDepth, SurfacePredicateVersion);
+    });
+
+  // Cold: nothing cached, the mesh is built and written
+  std::shared_ptr<Dx::IShape3d> builtShape;
+  const double coldMs = measureMs([&]() {
+    std::error_code error;
+    std::filesystem::remove(cache.getPath(key), error);
+
+    const ParallelRoam surf(heightField, SurfaceMaxDepth, getSurfacePredicate(), pool);
+    builtShape = surf.createShape();
+    cache.save(key, *builtShape, {});
+    });
+
+  // Warm: the file written by the last cold run is mapped
+  std::shared_ptr<Dx::IShape3d> loadedShape;
+  const double warmMs = measureMs([&]() {
+    MeshFileMaterial material;
+    loadedShape = cache.load(key, material);
+    });
+
+  const bool identical = loadedShape &&
+    loadedShape->getInds() == builtShape->getInds() &&
+    areSameVerts(loadedShape->getVerts(), builtShape->getVerts());
+
+  std::error_code error;
+  const auto fileSize = std::filesystem::file_size(cache.getPath(key), error);
+  std::filesystem::remove(cache.getPath(key), error);
+
+  std::printf("Surface mesh cache (%d tris, %d KB file)\n",
+    (int)builtShape->getInds().size() / 3, (int)(fileSize / 1024));
+  std::printf("  key ms  cold ms  warm ms  speedup  identical\n");
+  std::printf("  %6.2f %8.2f %8.2f %8.2f %10s\n",
+    keyMs, keyMs + coldMs, keyMs + warmMs, (keyMs + coldMs) / (keyMs + warmMs), identical ? "yes" : "NO");
+}
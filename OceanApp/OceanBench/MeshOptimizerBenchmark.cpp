@@ -0,0 +1,124 @@
+#include "stdafx.h"
+#include "MeshOptimizerBenchmark.h"
+
+#include "BenchUtils.h"
+
+#include "DynamicRoam.h"
+#include "MeshOptimizer.h"
+#include "ParallelRoam.h"
+#include "RoamPredicates.h"
+#include "ThreadPool.h"
+
+#include <LaggyDx/IShape3d.h>
+
+#include <algorithm>
+#include <array>
+
+
+namespace
+{
+  const Sdk::Vector3F WorldCenter = { 100, 0, 100 };
+
+  using Tri = std::array<float, 9>;
+
+  // Triangles by their positions, rotated to start with the smallest corner, so the winding
+  // is compared too
+  std::vector<Tri> getSortedTris(const std::vector<Dx::VertexPosNormText>& i_verts, const std::vector<int>& i_inds)
+  {
+    std::vector<Tri> tris;
+    tris.reserve(i_inds.size() / 3);
+    for (int i = 0; i < (int)i_inds.size(); i += 3)
+    {
+      std::array<std::array<float, 3>, 3> corners;
+      for (int corner = 0; corner < 3; ++corner)
+      {
+        const auto& position = i_verts[i_inds[i + corner]].position;
+        corners[corner] = { position.x, position.y, position.z };
+      }
+      std::rotate(corners.begin(), std::min_element(corners.begin(), corners.end()), corners.end());
+
+      Tri tri;
+      for (int corner = 0; corner < 3; ++corner)
+        std::copy(corners[corner].begin(), corners[corner].end(), tri.begin() + corner * 3);
+      tris.push_back(tri);
+    }
+
+    std::sort(tris.begin(), tris.end());
+    return tris;
+  }
+
+  // Row-major grid, the order plane shapes are usually generated in
+  std::pair<std::vector<Dx::VertexPosNormText>, std::vector<int>> createGrid(const int i_cellsCount)
+  {
+    std::vector<Dx::VertexPosNormText> verts;
+    std::vector<int> inds;
+    const int rowSize = i_cellsCount + 1;
+    for (int z = 0; z <= i_cellsCount; ++z)
+    {
+      for (int x = 0; x <= i_cellsCount; ++x)
+      {
+        Dx::VertexPosNormText vertex;
+        vertex.position = { (float)x, 0, (float)z };
+        verts.push_back(vertex);
+      }
+    }
+    for (int z = 0; z < i_cellsCount; ++z)
+    {
+      for (int x = 0; x < i_cellsCount; ++x)
+      {
+        const int corner = x + z * rowSize;
+        inds.insert(inds.end(), { corner, corner + rowSize, corner + 1, corner + 1, corner + rowSize, corner + rowSize + 1 });
+      }
+    }
+    return { verts, inds };
+  }
+
+  void runCase(const std::string& i_name, const std::vector<Dx::VertexPosNormText>& i_verts, const std::vector<int>& i_inds)
+  {
+    auto verts = i_verts;
+    auto inds = i_inds;
+    const double ms = measureMs([&]() {
+      verts = i_verts;
+      inds = i_inds;
+      optimizeMesh(verts, inds);
+      });
+
+    const auto before = getVertexCacheStats(i_inds);
+    const auto after = getVertexCacheStats(inds);
+    const auto before32 = getVertexCacheStats(i_inds, 32);
+    const auto after32 = getVertexCacheStats(inds, 32);
+    const bool identical = getSortedTris(i_verts, i_inds) == getSortedTris(verts, inds);
+
+    std::printf("  %-22s %8d %7.2f %6.3f %6.3f %6.3f %6.3f %6.3f %6.3f %10s\n",
+      i_name.c_str(), (int)i_inds.size() / 3, ms,
+      before.acmr, after.acmr, before.atvr, after.atvr, before32.acmr, after32.acmr,
+      identical ? "yes" : "NO");
+  }
+
+} // anonym NS
+
+
+void runMeshOptimizerBenchmark()
+{
+  const auto heightField = createTestHeightField();
+  ThreadPool pool(4);
+
+  std::printf("Vertex cache optimization (FIFO of %d, and of 32)\n", VertexCacheSize);
+  std::printf("  mesh                       tris      ms   ACMR  after   ATVR  after ACMR32  after  identical\n");
+
+  // Generation order, before createShape() optimizes it
+  const ParallelRoam surface(heightField, SurfaceMaxDepth, getSurfacePredicate(), pool);
+  runCase("Surface (ParallelRoam)", surface.getVerts(), surface.getInds());
+
+  const ParallelRoam ocean(OceanSize, OceanMaxDepth, getOceanPredicate(WorldCenter), pool);
+  runCase("Ocean (ParallelRoam)", ocean.getVerts(), ocean.getInds());
+
+  DynamicRoam dynamicOcean(OceanSize, OceanMaxDepth, getOceanPriority());
+  dynamicOcean.setMaxTrisCount(100000);
+  dynamicOcean.reset(WorldCenter);
+  const auto dynamicShape = dynamicOcean.createShape();
+  runCase("Ocean (DynamicRoam)", dynamicShape->getVerts(), dynamicShape->getInds());
+
+  const auto [gridVerts, gridInds] = createGrid(256);
+  runCase("Grid 256x256", gridVerts, gridInds);
+}
@@ -0,0 +1,234 @@
+#include "stdafx.h"
+#include "ObjectBvhBenchmark.h"
+
+#include "BenchUtils.h"
+
+#include "ObjectBvh.h"
+
+#include <LaggySdk/Math.h>
+
+#include <random>
+
+
+namespace
+{
+  constexpr int ObjectsCount = 100000;
+  constexpr int QueriesCount = 1000;
+  constexpr float WorldSize = 4096;
+
+  bool overlaps(const BoundingBox& i_left, const BoundingBox& i_right)
+  {
+    return
+      i_left.min.x <= i_right.max.x && i_left.max.x >= i_right.min.x &&
+      i_left.min.y <= i_right.max.y && i_left.max.y >= i_right.min.y &&
+      i_left.min.z <= i_right.max.z && i_left.max.z >= i_right.min.z;
+  }
+
+  float raycastBox(const BoundingBox& i_box, const Sdk::Vector3F& i_origin, const Sdk::Vector3F& i_direction, const float i_maxDistance)
+  {
+    float enter = 0;
+    float exit = i_maxDistance;
+    const float origin[3] = { i_origin.x, i_origin.y, i_origin.z };
+    const float direction[3] = { i_direction.x, i_direction.y, i_direction.z };
+    const float min[3] = { i_box.min.x, i_box.min.y, i_box.min.z };
+    const float max[3] = { i_box.max.x, i_box.max.y, i_box.max.z };
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      if (direction[axis] == 0)
+      {
+        if (origin[axis] < min[axis] || origin[axis] > max[axis])
+          return -1;
+        continue;
+      }
+
+      const float t1 = (min[axis] - origin[axis]) / direction[axis];
+      const float t2 = (max[axis] - origin[axis]) / direction[axis];
+      enter = std::max(enter, std::min(t1, t2));
+      exit = std::min(exit, std::max(t1, t2));
+    }
+    return enter <= exit ? enter : -1;
+  }
+
+  void printRow(const char* i_name, const double i_bvhMs, const double i_scanMs, const int i_mismatches)
+  {
+    std::printf("  %-14s %9.3f %9.3f %8.1f %11d\n", i_name, i_bvhMs, i_scanMs, i_scanMs / i_bvhMs, i_mismatches);
+  }
+
+} // anonym NS
+
+
+void runObjectBvhBenchmark()
+{
+  std::mt19937 random(1);
+  std::uniform_real_distribution<float> position(0, WorldSize);
+  std::uniform_real_distribution<float> height(-20, 20);
+  std::uniform_real_distribution<float> size(0.5f, 4);
+  std::uniform_real_distribution<float> unit(-1, 1);
+
+  std::vector<BoundingBox> boxes;
+  for (int i = 0; i < ObjectsCount; ++i)
+  {
+    const Sdk::Vector3F min = { position(random), height(random), position(random) };
+    boxes.push_back({ min, min + Sdk::Vector3F{ size(random), size(random), size(random) } });
+  }
+
+  ObjectBvh bvh;
+  std::vector<int> proxies(ObjectsCount);
+  const double insertMs = measureMs([&]() {
+    bvh = ObjectBvh();
+    for (int i = 0; i < ObjectsCount; ++i)
+      proxies[i] = bvh.insert(boxes[i], i);
+    }, 1);
+  const int insertHeight = bvh.getHeight();
+  const float insertRatio = bvh.getAreaRatio();
+
+  // A frame of floating objects: all of them drift a little, a few jump far
+  int reinsertedCount = 0;
+  const double updateMs = measureMs([&]() {
+    for (int i = 0; i < ObjectsCount; ++i)
+    {
+      const float distance = i % 100 == 0 ? 50.0f : 0.1f;
+      const Sdk::Vector3F offset = { unit(random) * distance, unit(random) * distance * 0.1f, unit(random) * distance };
+      boxes[i] = { boxes[i].min + offset, boxes[i].max + offset };
+      reinsertedCount += bvh.update(proxies[i], boxes[i]) ? 1 : 0;
+    }
+    }, 1);
+
+  const double rebuildMs = measureMs([&]() { bvh.rebuild(); }, 1);
+
+  std::printf("Object BVH (%d objects)\n", ObjectsCount);
+  std::printf("  insert %.1f ms (height %d, SAH %.1f), update %.1f ms (%d reinserted), rebuild %.1f ms (height %d, SAH %.1f)\n",
+    insertMs, insertHeight, insertRatio, updateMs, reinsertedCount, rebuildMs, bvh.getHeight(), bvh.getAreaRatio());
+  std::printf("  %d queries       BVH ms   scan ms  speedup  mismatches\n", QueriesCount);
+
+  // Rays from above the world down at a slant, the first hit against the scan. Every fourth
+  // one goes straight down along a side of a box, in the planes of its slabs
+  std::vector<std::pair<Sdk::Vector3F, Sdk::Vector3F>> rays;
+  for (int i = 0; i < QueriesCount; ++i)
+  {
+    if (i % 4 == 0)
+    {
+      const auto& box = boxes[i * (ObjectsCount / QueriesCount)];
+      rays.push_back({ { box.min.x, 50, box.getCenter().z }, { 0, -1, 0 } });
+    }
+    else
+      rays.push_back({ { position(random), 50, position(random) }, Sdk::Vector3F{ unit(random), -1, unit(random) }.getNormalized() });
+  }
+
+  std::vector<RayHit> bvhHits(QueriesCount);
+  const double rayBvhMs = measureMs([&]() {
+    for (int i = 0; i < QueriesCount; ++i)
+      bvhHits[i] = bvh.raycast(rays[i].first, rays[i].second, 1000);
+    });
+  std::vector<float> scanDistances(QueriesCount);
+  const double rayScanMs = measureMs([&]() {
+    for (int i = 0; i < QueriesCount; ++i)
+    {
+      float nearest = -1;
+      for (const auto& box : boxes)
+      {
+        const float distance = raycastBox(box, rays[i].first, rays[i].second, 1000);
+        if (distance >= 0 && (nearest < 0 || distance < nearest))
+          nearest = distance;
+      }
+      scanDistances[i] = nearest;
+    }
+    });
+  int rayMismatches = 0;
+  for (int i = 0; i < QueriesCount; ++i)
+  {
+    const bool bvhHit = bvhHits[i].tag >= 0;
+    if (bvhHit != (scanDistances[i] >= 0) || (bvhHit && std::abs(bvhHits[i].distance - scanDistances[i]) > 1e-3f))
+      ++rayMismatches;
+  }
+  printRow("ray", rayBvhMs, rayScanMs, rayMismatches);
+
+  // Volumes: the counts of the found objects against the scan
+  std::vector<BoundingBox> queryBoxes;
+  for (int i = 0; i < QueriesCount; ++i)
+  {
+    const Sdk::Vector3F min = { position(random), -10, position(random) };
+    queryBoxes.push_back({ min, min + Sdk::Vector3F{ 40, 20, 40 } });
+  }
+
+  std::vector<int> bvhCounts(QueriesCount);
+  std::vector<int> scanCounts(QueriesCount);
+  const auto countMismatches = [&]() {
+    int mismatches = 0;
+    for (int i = 0; i < QueriesCount; ++i)
+      mismatches += bvhCounts[i] != scanCounts[i] ? 1 : 0;
+    return mismatches;
+  };
+
+  const double boxBvhMs = measureMs([&]() {
+    for (int i = 0; i < QueriesCount; ++i)
+    {
+      bvhCounts[i] = 0;
+      bvh.queryBox(queryBoxes[i], [&](int) { ++bvhCounts[i]; });
+    }
+    });
+  const double boxScanMs = measureMs([&]() {
+    for (int i = 0; i < QueriesCount; ++i)
+      scanCounts[i] = (int)std::count_if(boxes.begin(), boxes.end(), [&](const auto& i_box) { return overlaps(i_box, queryBoxes[i]); });
+    });
+  printRow("box", boxBvhMs, boxScanMs, countMismatches());
+
+  const double sphereBvhMs = measureMs([&]() {
+    for (int i = 0; i < QueriesCount; ++i)
+    {
+      bvhCounts[i] = 0;
+      bvh.querySphere(queryBoxes[i].getCenter(), 20, [&](int) { ++bvhCounts[i]; });
+    }
+    });
+  const double sphereScanMs = measureMs([&]() {
+    for (int i = 0; i < QueriesCount; ++i)
+    {
+      const auto center = queryBoxes[i].getCenter();
+      scanCounts[i] = (int)std::count_if(boxes.begin(), boxes.end(), [&](const auto& i_box) {
+        const float dx = std::max({ i_box.min.x - center.x, 0.0f, center.x - i_box.max.x });
+        const float dy = std::max({ i_box.min.y - center.y, 0.0f, center.y - i_box.max.y });
+        const float dz = std::max({ i_box.min.z - center.z, 0.0f, center.z - i_box.max.z });
+        return dx * dx + dy * dy + dz * dz <= 400.0f;
+        });
+    }
+    });
+  printRow("sphere", sphereBvhMs, sphereScanMs, countMismatches());
+
+  // Frustums are bigger, fewer of them
+  constexpr int FrustumsCount = 20;
+  std::vector<FrustumPlanes> frustums;
+  for (int i = 0; i < FrustumsCount; ++i)
+  {
+    const Sdk::Vector3F eye = { position(random), 10, position(random) };
+    frustums.push_back(getFrustumPlanes(createViewProjection(eye, eye + Sdk::Vector3F{ unit(random), 0, unit(random) },
+      (float)Sdk::Pi / 3, 16.0f / 9, 0.1f, 500)));
+  }
+  const double frustumBvhMs = measureMs([&]() {
+    for (int i = 0; i < FrustumsCount; ++i)
+    {
+      bvhCounts[i] = 0;
+      bvh.queryFrustum(frustums[i], [&](int) { ++bvhCounts[i]; });
+    }
+    });
+  const double frustumScanMs = measureMs([&]() {
+    for (int i = 0; i < FrustumsCount; ++i)
+    {
+      scanCounts[i] = (int)std::count_if(boxes.begin(), boxes.end(), [&](const auto& i_box) {
+        const auto center = i_box.getCenter();
+        const auto extents = i_box.getExtents();
+        for (const auto& plane : frustums[i])
+        {
+          if (plane[0] * center.x + plane[1] * center.y + plane[2] * center.z + plane[3] +
+            std::abs(plane[0]) * extents.x + std::abs(plane[1]) * extents.y + std::abs(plane[2]) * extents.z < 0)
+          {
+            return false;
+          }
+        }
+        return true;
+        });
+    }
+    });
+  std::fill(bvhCounts.begin() + FrustumsCount, bvhCounts.end(), 0);
+  std::fill(scanCounts.begin() + FrustumsCount, scanCounts.end(), 0);
+  printRow("frustum (20)", frustumBvhMs, frustumScanMs, countMismatches());
+}
@@ -0,0 +1,105 @@
+#include "stdafx.h"
+#include "ProfilerBenchmark.h"
+
+#include "BenchUtils.h"
+
+#include "Profiler.h"
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+
+namespace
+{
+  constexpr int ScopesCount = 1000000;
+  const std::string TracePath = "OceanBench_trace.json";
+
+  // Keeps the loop from being optimized away
+  volatile int g_sink = 0;
+
+  void runScopes(const int i_count)
+  {
+    for (int i = 0; i < i_count; ++i)
+    {
+      PROFILE_SCOPE("Bench scope");
+      g_sink = g_sink + 1;
+    }
+  }
+
+} // anonym NS
+
+
+void runProfilerBenchmark()
+{
+  std::printf("Profiler (%d scopes)\n", ScopesCount);
+  std::printf("  mode          ms  ns/scope\n");
+
+  auto& profiler = Profiler::get();
+  const auto run = [&](const char* i_mode, const bool i_enabled, const bool i_withScopes) {
+    profiler.setEnabled(i_enabled);
+    const double ms = measureMs([&]() {
+      if (i_withScopes)
+        runScopes(ScopesCount);
+      else
+      {
+        for (int i = 0; i < ScopesCount; ++i)
+          g_sink = g_sink + 1;
+      }
+      });
+    std::printf("  %-10s %6.2f %9.2f\n", i_mode, ms, ms * 1e6 / ScopesCount);
+  };
+
+  run("no scopes", false, false);
+  run("disabled", false, true);
+  run("enabled", true, true);
+
+  // A frame's worth of scopes on the pool threads too, then the trace of all of them
+  ThreadPool pool(std::max((int)std::thread::hardware_concurrency(), 1));
+  profiler.endFrame();
+  pool.parallelFor(0, 64, [](int) { runScopes(100); });
+  profiler.endFrame();
+  profiler.setEnabled(false);
+
+  const auto& frameStats = profiler.getFrameStats();
+  const int frameCalls = frameStats.empty() ? 0 : frameStats.front().callsCount;
+
+  const double traceMs = measureMs([&]() { profiler.writeChromeTrace(TracePath); }, 1);
+  const auto traceBytes = std::filesystem::file_size(TracePath);
+  std::filesystem::remove(TracePath);
+
+  // Again with a thread recording all along, it's paused for the writing
+  profiler.setEnabled(true);
+  std::atomic<bool> stop = false;
+  std::thread recorder([&]() {
+    while (!stop)
+      runScopes(100);
+    });
+  const double recordingTraceMs = measureMs([&]() { profiler.writeChromeTrace(TracePath); }, 1);
+
+  // Frames long enough for the recording thread to wrap its ring around while they're summed,
+  // a torn event would show up as a scope of another name or crash
+  constexpr int RecordingFramesCount = 50;
+  int foreignScopesCount = 0;
+  for (int frame = 0; frame < RecordingFramesCount; ++frame)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    profiler.endFrame();
+    for (const auto& stats : profiler.getFrameStats())
+      foreignScopesCount += std::strcmp(stats.name, "Bench scope") != 0 ? 1 : 0;
+  }
+
+  stop = true;
+  recorder.join();
+  profiler.setEnabled(false);
+  std::filesystem::remove(TracePath);
+
+  std::printf("  frame scopes %d (6400 expected), trace %.1f ms, %.1f MB, %.1f ms while recording\n",
+    frameCalls, traceMs, traceBytes / (1024.0 * 1024.0), recordingTraceMs);
+  std::printf("  %d frames summed while recording, %d foreign scopes (0 expected)\n",
+    RecordingFramesCount, foreignScopesCount);
+}
@@ -0,0 +1,246 @@
+#include "stdafx.h"
+#include "RenderQueueBenchmark.h"
+
+#include "BenchUtils.h"
+
+#include "InstanceBatcher.h"
+#include "RenderQueue.h"
+#include "ThreadPool.h"
+
+#include <LaggySdk/Vector.h>
+
+#include <algorithm>
+#include <random>
+#include <thread>
+
+
+namespace
+{
+  constexpr int MaterialsCount = 64;
+  const std::vector<int> CommandsCounts{ 1000, 10000, 100000 };
+
+  struct Draw
+  {
+    RenderPass pass = RenderPass::Opaque;
+    RenderShader shader = RenderShader::Simple;
+    int materialId = 0;
+    float depth = 0;
+  };
+
+  // Mostly opaque objects and some water tiles, recorded in scene order
+  std::vector<Draw> createDraws(const int i_count)
+  {
+    std::mt19937 random(42);
+    std::uniform_int_distribution<int> materialDist(0, MaterialsCount - 1);
+    std::uniform_int_distribution<int> kindDist(0, 9);
+    std::uniform_real_distribution<float> depthDist(0, 5000);
+
+    std::vector<Draw> draws(i_count);
+    for (auto& draw : draws)
+    {
+      if (kindDist(random) == 0)
+      {
+        draw.pass = RenderPass::Water;
+        draw.shader = RenderShader::Ocean;
+      }
+      draw.materialId = materialDist(random);
+      draw.depth = depthDist(random);
+    }
+
+    return draws;
+  }
+
+
+  constexpr int ModelsCount = 64;
+  constexpr int SceneObjectsCount = 10000;
+  constexpr int MinObjectsPerJob = 512;
+
+  struct SceneObject
+  {
+    int modelId = 0;
+    bool visible = true;
+    Sdk::Vector3F position;
+  };
+
+  std::vector<SceneObject> createSceneObjects()
+  {
+    std::mt19937 random(42);
+    std::uniform_int_distribution<int> modelDist(0, ModelsCount - 1);
+    std::uniform_int_distribution<int> visibleDist(0, 9);
+    std::uniform_real_distribution<float> positionDist(-2000, 2000);
+
+    std::vector<SceneObject> objects(SceneObjectsCount);
+    for (auto& object : objects)
+    {
+      object.modelId = modelDist(random);
+      object.visible = visibleDist(random) > 0;
+      object.position = { positionDist(random), 0, positionDist(random) };
+    }
+
+    return objects;
+  }
+
+  // Same as Game::recordDraws does with d_objects: a range of objects per job, batched and
+  // recorded into the job's own queue, then the queues are merged in the jobs order
+  class SceneRecorder
+  {
+  public:
+    SceneRecorder(const std::vector<SceneObject>& i_objects)
+      : d_objects(i_objects)
+    {
+    }
+
+    void record(ThreadPool& i_pool)
+    {
+      const int objectsCount = (int)d_objects.size();
+      const int jobsCount = std::clamp(
+        (objectsCount + MinObjectsPerJob - 1) / MinObjectsPerJob, 1, i_pool.getThreadsCount());
+      if ((int)d_jobs.size() < jobsCount)
+        d_jobs.resize(jobsCount);
+
+      i_pool.parallelFor(0, jobsCount, [&](const int i_job) {
+        recordJob(d_jobs[i_job], objectsCount * i_job / jobsCount, objectsCount * (i_job + 1) / jobsCount);
+        });
+
+      d_queue.clear();
+      d_batches.clear();
+      for (int jobIndex = 0; jobIndex < jobsCount; ++jobIndex)
+      {
+        const auto& job = d_jobs[jobIndex];
+        d_queue.append(job.queue, (int)d_batches.size());
+        for (int batchIndex = 0; batchIndex < (int)job.batcher.getBatches().size(); ++batchIndex)
+          d_batches.push_back({ jobIndex, batchIndex });
+      }
+      d_queue.sort();
+    }
+
+    // Objects in the order they would be drawn
+    std::vector<int> getDrawOrder() const
+    {
+      std::vector<int> order;
+      for (const auto& command : d_queue.getCommands())
+      {
+        const auto [jobIndex, batchIndex] = d_batches[command.payload];
+        const auto& batcher = d_jobs[jobIndex].batcher;
+        const auto& batch = batcher.getBatches()[batchIndex];
+        for (int i = batch.firstInstance; i < batch.firstInstance + batch.instancesCount; ++i)
+          order.push_back(batcher.getTags()[i]);
+      }
+      return order;
+    }
+
+  private:
+    struct Job
+    {
+      InstanceBatcher batcher;
+      RenderQueue queue;
+    };
+
+    const std::vector<SceneObject>& d_objects;
+    std::vector<Job> d_jobs;
+    RenderQueue d_queue;
+    std::vector<std::pair<int, int>> d_batches;
+
+    void recordJob(Job& io_job, const int i_begin, const int i_end) const
+    {
+      io_job.batcher.clear();
+      for (int i = i_begin; i < i_end; ++i)
+      {
+        if (d_objects[i].visible)
+          io_job.batcher.add(d_objects[i].modelId, i);
+      }
+      io_job.batcher.build();
+
+      io_job.queue.clear();
+      const auto& batches = io_job.batcher.getBatches();
+      for (int batchIndex = 0; batchIndex < (int)batches.size(); ++batchIndex)
+      {
+        const auto& batch = batches[batchIndex];
+        float depth = std::numeric_limits<float>::max();
+        for (int i = batch.firstInstance; i < batch.firstInstance + batch.instancesCount; ++i)
+          depth = std::min(depth, d_objects[io_job.batcher.getTags()[i]].position.length());
+        io_job.queue.add(RenderPass::Opaque, RenderShader::Simple, batch.modelId, depth, batchIndex);
+      }
+    }
+  };
+
+
+  void runParallelRecordingBenchmark()
+  {
+    const int maxThreadsCount = std::max((int)std::thread::hardware_concurrency(), 1);
+    std::vector<int> threadsCounts;
+    for (int threadsCount = 1; threadsCount < maxThreadsCount && threadsCount <= 8; threadsCount *= 2)
+      threadsCounts.push_back(threadsCount);
+    threadsCounts.push_back(maxThreadsCount);
+
+    std::printf("Parallel recording (%d objects, %d models)\n", SceneObjectsCount, ModelsCount);
+    std::printf("  threads  record ms  speedup  deterministic\n");
+
+    const auto objects = createSceneObjects();
+    double singleThreadMs = 0;
+
+    for (const int threadsCount : threadsCounts)
+    {
+      ThreadPool pool(threadsCount);
+      SceneRecorder recorder(objects);
+      recorder.record(pool);
+      const auto order = recorder.getDrawOrder();
+
+      const double ms = measureMs([&]() { recorder.record(pool); }, 20);
+      if (threadsCount == 1)
+        singleThreadMs = ms;
+
+      // Scheduling differs from run to run, the result must not
+      std::printf("  %7d %10.3f %8.2f %14s\n",
+        threadsCount, ms, singleThreadMs / ms, recorder.getDrawOrder() == order ? "yes" : "NO");
+    }
+  }
+
+} // anonym NS
+
+
+void runRenderQueueBenchmark()
+{
+  std::printf("Render queue (%d materials)\n", MaterialsCount);
+  std::printf("  commands  radix ms  std::sort ms  mismatches  state changes\n");
+
+  for (const int commandsCount : CommandsCounts)
+  {
+    const auto draws = createDraws(commandsCount);
+
+    // Warm up once, so the queue's buffers are allocated as they would be after the first frame
+    RenderQueue queue;
+    const auto record = [&]() {
+      queue.clear();
+      for (int i = 0; i < (int)draws.size(); ++i)
+        queue.add(draws[i].pass, draws[i].shader, draws[i].materialId, draws[i].depth, i);
+      queue.sort();
+    };
+    record();
+    const double radixMs = measureMs(record, 10);
+
+    std::vector<RenderCommand> reference;
+    const auto recordReference = [&]() {
+      reference.clear();
+      for (int i = 0; i < (int)draws.size(); ++i)
+        reference.push_back({ RenderQueue::makeKey(draws[i].pass, draws[i].shader, draws[i].materialId, draws[i].depth), i });
+      std::stable_sort(reference.begin(), reference.end(), [](const auto& i_left, const auto& i_right) {
+        return i_left.key < i_right.key;
+      });
+    };
+    const double referenceMs = measureMs(recordReference, 10);
+
+    int mismatches = 0;
+    for (int i = 0; i < commandsCount; ++i)
+    {
+      if (queue.getCommands()[i].payload != reference[i].payload)
+        ++mismatches;
+    }
+
+    std::printf("  %8d %9.3f %13.3f %11d %7d -> %d\n",
+      commandsCount, radixMs, referenceMs, mismatches,
+      queue.getRecordedStateChangesCount(), queue.getStateChangesCount());
+  }
+
+  runParallelRecordingBenchmark();
+}
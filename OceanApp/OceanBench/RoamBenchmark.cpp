@@ -0,0 +1,203 @@
+#include "stdafx.h"
+#include "RoamBenchmark.h"
+
+#include "BenchUtils.h"
+
+#include "DynamicRoam.h"
+#include "HeightField.h"
+#include "ParallelRoam.h"
+#include "RoamErrorPyramid.h"
+#include "RoamPredicates.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <array>
+#include <functional>
+
+
+namespace
+{
+  const Sdk::Vector3F WorldCenter = { 100, 0, 100 };
+  const std::vector<int> ThreadsCounts{ 1, 2, 4, 8, 16 };
+
+  template <typename TBuild>
+  void runCase(const std::string& i_name, TBuild&& i_build)
+  {
+    std::printf("%s\n", i_name.c_str());
+    std::printf("  threads       ms  speedup     tris  identical\n");
+
+    std::vector<Dx::VertexPosNormText> referenceVerts;
+    std::vector<int> referenceInds;
+    double referenceMs = 0;
+
+    for (const int threadsCount : ThreadsCounts)
+    {
+      ThreadPool pool(threadsCount);
+
+      std::unique_ptr<ParallelRoam> roam;
+      const double ms = measureMs([&]() { roam = i_build(pool); });
+
+      if (referenceInds.empty())
+      {
+        referenceVerts = roam->getVerts();
+        referenceInds = roam->getInds();
+        referenceMs = ms;
+      }
+
+      std::printf("  %7d %8.2f %8.2f %8d %10s\n",
+        threadsCount, ms, referenceMs / ms, (int)roam->getInds().size() / 3,
+        areSameVerts(roam->getVerts(), referenceVerts) && roam->getInds() == referenceInds ? "yes" : "NO");
+    }
+  }
+
+  // Whether the bounds of every split vertex hold the ones of the split vertices of both its
+  // children, walking the bintree from the two root triangles. Grid coordinates
+  bool isSaturated(const RoamErrorPyramid& i_pyramid)
+  {
+    const int last = i_pyramid.getGridSize() - 1;
+    const auto getIndex = [&](const int i_x, const int i_z) { return i_x + i_z * i_pyramid.getGridSize(); };
+
+    const std::function<bool(int, int, int, int, int, int)> walk = [&](
+      const int i_apexX, const int i_apexZ, const int i_leftX, const int i_leftZ, const int i_rightX, const int i_rightZ)
+    {
+      if (std::abs(i_leftX - i_rightX) <= 1 && std::abs(i_leftZ - i_rightZ) <= 1)
+        return true;
+
+      const int middleX = (i_leftX + i_rightX) / 2;
+      const int middleZ = (i_leftZ + i_rightZ) / 2;
+      const int middle = getIndex(middleX, middleZ);
+
+      // The children's hypotenuses are the legs, too short to be split at the last level
+      const auto holdsChild = [&](const int i_firstX, const int i_firstZ, const int i_secondX, const int i_secondZ) {
+        if (std::abs(i_firstX - i_secondX) <= 1 && std::abs(i_firstZ - i_secondZ) <= 1)
+          return true;
+        const int child = getIndex((i_firstX + i_secondX) / 2, (i_firstZ + i_secondZ) / 2);
+        return
+          i_pyramid.getError(child) <= i_pyramid.getError(middle) &&
+          i_pyramid.getMinHeight(child) >= i_pyramid.getMinHeight(middle) &&
+          i_pyramid.getMaxHeight(child) <= i_pyramid.getMaxHeight(middle);
+      };
+      if (!holdsChild(i_apexX, i_apexZ, i_leftX, i_leftZ) || !holdsChild(i_rightX, i_rightZ, i_apexX, i_apexZ))
+        return false;
+
+      return
+        walk(middleX, middleZ, i_apexX, i_apexZ, i_leftX, i_leftZ) &&
+        walk(middleX, middleZ, i_rightX, i_rightZ, i_apexX, i_apexZ);
+    };
+
+    return walk(0, last, last, last, 0, 0) && walk(last, 0, 0, 0, last, last);
+  }
+
+  void runErrorPyramidCase(const HeightField& i_heightField)
+  {
+    // The pyramid is built over the ROAM grid itself
+    const int gridSize = (1 << ((SurfaceMaxDepth + 1) / 2)) + 1;
+    const auto gridField = i_heightField.resample(gridSize, gridSize);
+
+    std::unique_ptr<RoamErrorPyramid> errorPyramid;
+    const double pyramidMs = measureMs([&]() { errorPyramid = std::make_unique<RoamErrorPyramid>(gridField); });
+
+    std::printf("Surface split errors (%dx%d grid, pyramid built in %.2f ms, saturated: %s)\n",
+      gridSize, gridSize, pyramidMs, isSaturated(*errorPyramid) ? "yes" : "NO");
+    std::printf("  errors          ms     tris  pred calls  error reads  lookups\n");
+
+    ThreadPool pool(4);
+    for (const auto* pyramid : { (const RoamErrorPyramid*)nullptr, (const RoamErrorPyramid*)errorPyramid.get() })
+    {
+      std::unique_ptr<ParallelRoam> roam;
+      const double ms = measureMs([&]() {
+        roam = std::make_unique<ParallelRoam>(gridField, SurfaceMaxDepth, getSurfacePredicate(), pool, pyramid);
+        });
+
+      std::printf("  %-8s %9.2f %8d %11d %12d %8d\n",
+        pyramid ? "pyramid" : "local", ms, (int)roam->getInds().size() / 3, roam->getPredicateCallsCount(),
+        roam->getErrorHeightReadsCount(), roam->getPyramidLookupsCount());
+    }
+  }
+
+  // Triangles as sorted position triples, whatever the vertex numbering and the triangles order
+  std::vector<std::array<float, 9>> getSortedTris(const Dx::IShape3d& i_shape)
+  {
+    const auto& verts = i_shape.getVerts();
+    const auto& inds = i_shape.getInds();
+
+    std::vector<std::array<float, 9>> tris;
+    for (int i = 0; i + 2 < (int)inds.size(); i += 3)
+    {
+      if (inds[i] == inds[i + 1])
+        continue;
+
+      std::array<float, 9> tri;
+      for (int corner = 0; corner < 3; ++corner)
+      {
+        const auto& position = verts[inds[i + corner]].position;
+        tri[corner * 3 + 0] = position.x;
+        tri[corner * 3 + 1] = position.y;
+        tri[corner * 3 + 2] = position.z;
+      }
+      tris.push_back(tri);
+    }
+
+    std::sort(tris.begin(), tris.end());
+    return tris;
+  }
+
+  void runDynamicCase()
+  {
+    constexpr int MaxTrisCount = 100000;
+    constexpr int OperationsBudget = 256;
+    constexpr int FramesCount = 600;
+    // 1.5 m a frame, faster than the camera runs
+    constexpr float Speed = 1.5f;
+
+    DynamicRoam roam(OceanSize, OceanMaxDepth, getOceanPriority());
+    roam.setMaxTrisCount(MaxTrisCount);
+    roam.setOperationsBudget(OperationsBudget);
+    roam.setRefreshBudget(4000);
+    roam.reset(WorldCenter);
+
+    int maxTrisCount = 0;
+    int maxOperationsCount = 0;
+    int changedFramesCount = 0;
+    const double ms = measureMs([&]() {
+      for (int frame = 0; frame < FramesCount; ++frame)
+      {
+        const float angle = frame * Speed / 60;
+        const Sdk::Vector3F viewPosition{ WorldCenter.x + 60 * std::cos(angle), 2, WorldCenter.z + 60 * std::sin(angle) };
+        if (roam.update(viewPosition))
+          ++changedFramesCount;
+
+        maxTrisCount = std::max(maxTrisCount, roam.getTrisCount());
+        maxOperationsCount = std::max(maxOperationsCount, roam.getLastSplitsCount() + roam.getLastMergesCount());
+      }
+      }, 1);
+
+    const auto persistentTris = getSortedTris(roam.getShape());
+    const bool isSame = persistentTris == getSortedTris(*roam.createShape()) &&
+      (int)persistentTris.size() == roam.getTrisCount();
+
+    std::printf("Ocean split/merge along a circle (%d frames, %d tris and %d operations at most)\n",
+      FramesCount, MaxTrisCount, OperationsBudget);
+    std::printf("  ms/update  changed frames  max tris  max operations  buffer tris  same as rebuilt\n");
+    std::printf("  %9.3f %15d %9d %15d %12d %16s\n", ms / FramesCount, changedFramesCount, maxTrisCount,
+      maxOperationsCount, (int)roam.getShape().getInds().size() / 3, isSame ? "yes" : "NO");
+  }
+
+} // anonym NS
+
+
+void runRoamBenchmark()
+{
+  const auto heightField = createTestHeightField();
+
+  runCase("Surface (height field, depth 5..20)", [&](ThreadPool& i_pool) {
+    return std::make_unique<ParallelRoam>(heightField, SurfaceMaxDepth, getSurfacePredicate(), i_pool);
+    });
+
+  runCase("Ocean (200 m plane, depth 15..20)", [&](ThreadPool& i_pool) {
+    return std::make_unique<ParallelRoam>(OceanSize, OceanMaxDepth, getOceanPredicate(WorldCenter), i_pool);
+    });
+
+  runErrorPyramidCase(heightField);
+  runDynamicCase();
+}
@@ -0,0 +1,374 @@
+#include "stdafx.h"
+#include "SceneBenchmark.h"
+
+#include "BenchUtils.h"
+
+#include "BoundingBox.h"
+#include "BuoyancySystem.h"
+#include "GerstnerWaves.h"
+#include "ObjectBvh.h"
+#include "OceanLodController.h"
+#include "RenderQueue.h"
+#include "SceneSettings.h"
+#include "TerrainPager.h"
+#include "ThreadPool.h"
+#include "VisibilityCuller.h"
+#include "WaterHeightQuery.h"
+
+#include <LaggySdk/Math.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <thread>
+
+
+namespace
+{
+  constexpr int FramesCount = 600;
+  constexpr double FrameDt = 1.0 / 60;
+
+  // Camera path: circles around the middle of the terrain while rising and sinking,
+  // so the terrain pages, the ocean levels and the visible objects all change
+  const Sdk::Vector3F PathCenter = { 512, 0, 512 };
+  constexpr float PathRadius = 300;
+  constexpr float PathMinHeight = 2;
+  constexpr float PathMaxHeight = 60;
+  constexpr double PathTurnSeconds = 10;
+
+  // Buoys on a grid around the path center
+  constexpr int ObjectsSide = 32;
+  constexpr float ObjectsSpacing = 20;
+  constexpr float ObjectRadius = 1;
+  constexpr int ObjectModelsCount = 8;
+
+  // The rest of the settings are Game's, from SceneSettings.h
+  constexpr float Aspect = 16.0f / 9.0f;
+  constexpr int OverlayRefreshFrames = 15;
+
+
+  struct Stage
+  {
+    std::string name;
+    std::vector<double> samplesMs;
+
+    double getMeanMs() const
+    {
+      double sum = 0;
+      for (const double ms : samplesMs)
+        sum += ms;
+      return samplesMs.empty() ? 0 : sum / samplesMs.size();
+    }
+
+    double getMaxMs() const
+    {
+      return samplesMs.empty() ? 0 : *std::max_element(samplesMs.begin(), samplesMs.end());
+    }
+
+    // Nearest rank
+    double getPercentileMs(const double i_percentile) const
+    {
+      if (samplesMs.empty())
+        return 0;
+      auto sorted = samplesMs;
+      std::sort(sorted.begin(), sorted.end());
+      const int rank = std::max((int)std::ceil(i_percentile / 100 * sorted.size()), 1);
+      return sorted[rank - 1];
+    }
+  };
+
+  struct SetupStep
+  {
+    std::string name;
+    double ms = 0;
+    std::size_t peakMemoryBytes = 0;
+  };
+
+  struct Results
+  {
+    int threadsCount = 0;
+    std::vector<SetupStep> setupSteps;
+    std::vector<Stage> stages;
+    Stage frame{ "Frame" };
+    std::size_t peakMemoryBytes = 0;
+  };
+
+
+  Sdk::Vector3F getCameraPosition(const double i_time)
+  {
+    const double angle = 2 * Sdk::Pi * i_time / PathTurnSeconds;
+    const double height = PathMinHeight + (PathMaxHeight - PathMinHeight) * (0.5 + 0.5 * std::sin(angle * 3));
+    return {
+      PathCenter.x + PathRadius * (float)std::cos(angle),
+      (float)height,
+      PathCenter.z + PathRadius * (float)std::sin(angle) };
+  }
+
+  Sdk::Vector3F getCameraLookAt(const double i_time)
+  {
+    // A quarter turn ahead, over the water
+    const auto ahead = getCameraPosition(i_time + PathTurnSeconds / 4);
+    return { ahead.x, 0, ahead.z };
+  }
+
+  // The whole frame last
+  std::vector<const Stage*> getStages(const Results& i_results)
+  {
+    std::vector<const Stage*> stages;
+    for (const auto& stage : i_results.stages)
+      stages.push_back(&stage);
+    stages.push_back(&i_results.frame);
+    return stages;
+  }
+
+  double toMb(const std::size_t i_bytes)
+  {
+    return i_bytes / (1024.0 * 1024.0);
+  }
+
+
+  // The CPU side of Game, without the render device: what Game::update and Game::render
+  // compute before the draw calls
+  class Scene
+  {
+  public:
+    Scene(Results& io_results, const std::filesystem::path& i_folder)
+      : d_results(io_results)
+      , d_waves(createDefaultWaves())
+      , d_waterHeightQuery(OceanLodController::getLevelCellsCount(), OceanLodController::getLevelCellSize(WaterHeightQueryLevel))
+    {
+      setup("Height field", [&]() { d_heightField = createTestHeightField(); });
+      setup("Terrain pages", [&]() { TerrainPager::writePages(d_heightField, 1, i_folder / "Pages"); });
+      setup("Terrain pager", [&]() {
+        TerrainPagerSettings settings;
+        settings.pagesFolder = i_folder / "Pages";
+        settings.meshesFolder = i_folder / "Meshes";
+        d_terrainPager = std::make_unique<TerrainPager>(std::move(settings));
+        });
+      setup("Floating objects", [&]() { createObjects(); });
+      setup("Objects BVH", [&]() {
+        for (int i = 0; i < d_buoyancySystem.getBodiesCount(); ++i)
+          d_proxies.push_back(d_objectsBvh.insert(getObjectBounds(i), i));
+        d_objectsBvh.rebuild();
+        });
+    }
+
+    void runFrame(const double i_time)
+    {
+      const auto eye = getCameraPosition(i_time);
+      const auto lookAt = getCameraLookAt(i_time);
+
+      const double frameMs = measureMs([&]() {
+        stage(0, "Waves", [&]() {
+          d_waves.setGlobalTime(i_time);
+          d_waterHeightQuery.update(d_waves, eye);
+          // The game's only reader is the overlay, at 4 Hz. It's the query that bakes the grid
+          if (d_framesCount % OverlayRefreshFrames == 0)
+            d_waterHeightQuery.getHeight(eye.x, eye.z);
+          });
+        stage(1, "Buoyancy", [&]() { d_buoyancySystem.update(d_waves); });
+        // The game's clipmap ocean, the levels' objects need a render device so only their placements
+        stage(2, "Ocean LOD", [&]() { OceanLodController::getPlacements(eye, d_placements); });
+        stage(3, "Terrain pager", [&]() {
+          d_terrainPager->update(eye);
+          for (const auto& page : d_terrainPager->takeEvictedPages())
+            d_terrainShapes.erase(TerrainPager::getPageKey(page.x, page.z));
+          for (const auto& page : d_terrainPager->takeLoadedPages())
+            d_terrainShapes[TerrainPager::getPageKey(page.x, page.z)] = page.shape;
+          });
+        stage(4, "Objects BVH", [&]() {
+          for (int i = 0; i < (int)d_proxies.size(); ++i)
+            d_reinsertsCount += d_objectsBvh.update(d_proxies[i], getObjectBounds(i)) ? 1 : 0;
+          if (d_reinsertsCount >= ObjectsBvhRebuildFraction * d_proxies.size())
+          {
+            d_objectsBvh.rebuild();
+            d_reinsertsCount = 0;
+          }
+          d_objectsBvh.raycast(eye, (lookAt - eye).getNormalized(), PickingDistance);
+          });
+        stage(5, "Culling", [&]() {
+          d_culler.begin(createViewProjection(eye, lookAt, CameraFovY, Aspect, CameraNear, CameraFar), eye);
+          d_cullIds.clear();
+          for (int i = 0; i < d_buoyancySystem.getBodiesCount(); ++i)
+            d_cullIds.push_back(d_culler.add(getObjectBounds(i)));
+          d_oceanCullIds.clear();
+          for (int i = 0; i < (int)d_placements.size(); ++i)
+            d_oceanCullIds.push_back(d_culler.add(getOceanLevelBounds(i)));
+          d_culler.cull();
+          });
+        stage(6, "Render queue", [&]() {
+          d_renderQueue.clear();
+          for (int i = 0; i < (int)d_cullIds.size(); ++i)
+          {
+            if (d_culler.isVisible(d_cullIds[i]))
+              d_renderQueue.add(RenderPass::Opaque, RenderShader::Simple, i % ObjectModelsCount,
+                (d_buoyancySystem.getPosition(i) - eye).length(), i);
+          }
+          // A level and its visible trim, as the game draws them
+          const int oceanMaterialId = ObjectModelsCount;
+          for (int i = 0; i < (int)d_oceanCullIds.size(); ++i)
+          {
+            if (!d_culler.isVisible(d_oceanCullIds[i]))
+              continue;
+            const float depth = (d_placements[i].origin - eye).length();
+            d_renderQueue.add(RenderPass::Water, RenderShader::Ocean, oceanMaterialId, depth, (int)d_cullIds.size() + i);
+            if (d_placements[i].visibleTrim >= 0)
+              d_renderQueue.add(RenderPass::Water, RenderShader::Ocean, oceanMaterialId, depth, (int)d_cullIds.size() + i);
+          }
+          d_renderQueue.sort();
+          });
+        }, 1);
+
+      d_results.frame.samplesMs.push_back(frameMs);
+      ++d_framesCount;
+    }
+
+  private:
+    Results& d_results;
+    int d_framesCount = 0;
+
+    HeightField d_heightField{ 1, 1 };
+    std::unique_ptr<TerrainPager> d_terrainPager;
+    std::unordered_map<std::int64_t, std::shared_ptr<Dx::IShape3d>> d_terrainShapes;
+
+    GerstnerWaves d_waves;
+    WaterHeightQuery d_waterHeightQuery;
+    BuoyancySystem d_buoyancySystem;
+    std::vector<OceanLodController::LevelPlacement> d_placements;
+
+    ObjectBvh d_objectsBvh;
+    std::vector<int> d_proxies;
+    int d_reinsertsCount = 0;
+    VisibilityCuller d_culler;
+    std::vector<int> d_cullIds;
+    std::vector<int> d_oceanCullIds;
+    RenderQueue d_renderQueue;
+
+    template <typename F>
+    void setup(const std::string& i_name, F&& i_func)
+    {
+      const double ms = measureMs(i_func, 1);
+      d_results.setupSteps.push_back({ i_name, ms, getPeakMemoryBytes() });
+    }
+
+    template <typename F>
+    void stage(const int i_index, const char* i_name, F&& i_func)
+    {
+      if ((int)d_results.stages.size() <= i_index)
+        d_results.stages.push_back({ i_name });
+      d_results.stages[i_index].samplesMs.push_back(measureMs(i_func, 1));
+    }
+
+    void createObjects()
+    {
+      constexpr float Volume = 4.0f / 3.0f * (float)Sdk::Pi * ObjectRadius * ObjectRadius * ObjectRadius;
+      // Half as dense as the water, as the test objects in Game
+      constexpr float Mass = 0.5f * 1025 * Volume;
+
+      for (int z = 0; z < ObjectsSide; ++z)
+      {
+        for (int x = 0; x < ObjectsSide; ++x)
+        {
+          const Sdk::Vector3F position{
+            PathCenter.x + (x - ObjectsSide / 2) * ObjectsSpacing,
+            -(float)((x + z) % 5),
+            PathCenter.z + (z - ObjectsSide / 2) * ObjectsSpacing };
+          d_buoyancySystem.addBody(Mass, Volume, position, { { 0, 0, 0 } }, ObjectRadius);
+        }
+      }
+    }
+
+    // The whole level, its trims lie inside. Inflated by the waves, as in Game::cullObjects()
+    BoundingBox getOceanLevelBounds(const int i_level) const
+    {
+      const float size = OceanLodController::getLevelCellsCount() * OceanLodController::getLevelCellSize(i_level);
+      const float margin = d_waves.getMaxDisplacement();
+      const auto& origin = d_placements[i_level].origin;
+      return BoundingBox{ origin, origin + Sdk::Vector3F{ size, 0, size } }.getInflated({ margin, margin, margin });
+    }
+
+    BoundingBox getObjectBounds(const int i_body) const
+    {
+      const auto position = d_buoyancySystem.getPosition(i_body);
+      const Sdk::Vector3F extents{ ObjectRadius, ObjectRadius, ObjectRadius };
+      return { position - extents, position + extents };
+    }
+  };
+
+
+  bool writeJson(const Results& i_results, const std::string& i_path)
+  {
+    std::ofstream stream(i_path, std::ios::trunc);
+    if (!stream)
+      return false;
+
+    stream << std::fixed << std::setprecision(4);
+    stream << "{\n";
+    stream << "  \"benchmark\": \"scene\",\n";
+    stream << "  \"frames\": " << FramesCount << ",\n";
+    stream << "  \"threads\": " << i_results.threadsCount << ",\n";
+
+    stream << "  \"setup\": [";
+    for (int i = 0; i < (int)i_results.setupSteps.size(); ++i)
+    {
+      const auto& step = i_results.setupSteps[i];
+      stream << (i ? ",\n" : "\n") << "    { \"name\": \"" << step.name << "\", \"ms\": " << step.ms <<
+        ", \"peakMemoryMb\": " << toMb(step.peakMemoryBytes) << " }";
+    }
+    stream << "\n  ],\n";
+
+    stream << "  \"stages\": [";
+    const auto stages = getStages(i_results);
+    for (int i = 0; i < (int)stages.size(); ++i)
+    {
+      const auto& stage = *stages[i];
+      stream << (i ? ",\n" : "\n") << "    { \"name\": \"" << stage.name << "\", \"meanMs\": " << stage.getMeanMs() <<
+        ", \"p50Ms\": " << stage.getPercentileMs(50) << ", \"p95Ms\": " << stage.getPercentileMs(95) <<
+        ", \"p99Ms\": " << stage.getPercentileMs(99) << ", \"maxMs\": " << stage.getMaxMs() << " }";
+    }
+    stream << "\n  ],\n";
+
+    stream << "  \"peakMemoryMb\": " << toMb(i_results.peakMemoryBytes) << "\n";
+    stream << "}\n";
+    return (bool)stream;
+  }
+
+} // anonym NS
+
+
+void runSceneBenchmark(const std::string& i_jsonPath)
+{
+  const auto folder = std::filesystem::temp_directory_path() / "OceanBenchScene";
+  std::error_code error;
+  std::filesystem::remove_all(folder, error);
+
+  Results results;
+  results.threadsCount = std::max((int)std::thread::hardware_concurrency(), 1);
+
+  {
+    Scene scene(results, folder);
+    for (int frame = 0; frame < FramesCount; ++frame)
+      scene.runFrame(frame * FrameDt);
+    results.peakMemoryBytes = getPeakMemoryBytes();
+  }
+
+  std::filesystem::remove_all(folder, error);
+
+  std::printf("Scene replay (%d frames, %d objects, peak memory %.1f MB)\n",
+    FramesCount, ObjectsSide * ObjectsSide, toMb(results.peakMemoryBytes));
+  std::printf("  setup              ms  peak MB\n");
+  for (const auto& step : results.setupSteps)
+    std::printf("  %-16s %8.2f %8.1f\n", step.name.c_str(), step.ms, toMb(step.peakMemoryBytes));
+  std::printf("  stage         mean ms   p99 ms   max ms\n");
+  for (const auto* stage : getStages(results))
+    std::printf("  %-13s %8.3f %8.3f %8.3f\n", stage->name.c_str(), stage->getMeanMs(), stage->getPercentileMs(99), stage->getMaxMs());
+
+  if (!i_jsonPath.empty())
+  {
+    if (writeJson(results, i_jsonPath))
+      std::printf("  written to %s\n", i_jsonPath.c_str());
+    else
+      std::printf("  can't write %s\n", i_jsonPath.c_str());
+  }
+}
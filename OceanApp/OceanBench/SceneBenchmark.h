@@ -0,0 +1,8 @@
+#pragma once
+
+#include <string>
+
+
+// Replays a camera path over the CPU side of the scene. Writes the timings as JSON too,
+// unless i_jsonPath is empty
+void runSceneBenchmark(const std::string& i_jsonPath = "");
@@ -0,0 +1,127 @@
+#include "stdafx.h"
+#include "TerrainPagerBenchmark.h"
+
+#include "BenchUtils.h"
+
+#include "TerrainPager.h"
+
+#include <LaggyDx/IShape3d.h>
+
+#include <array>
+#include <set>
+#include <thread>
+
+
+namespace
+{
+  constexpr int FramesCount = 300;
+  constexpr float FlightSpeed = 3;
+
+  // Whether both pages have the same vertices on their shared border
+  bool areStitched(const Dx::IShape3d& i_left, const Dx::IShape3d& i_right)
+  {
+    std::set<std::pair<float, float>> leftBorder;
+    for (const auto& vertex : i_left.getVerts())
+    {
+      if (vertex.position.x == TerrainPager::PageSize)
+        leftBorder.insert({ vertex.position.z, vertex.position.y });
+    }
+
+    std::set<std::pair<float, float>> rightBorder;
+    for (const auto& vertex : i_right.getVerts())
+    {
+      if (vertex.position.x == 0)
+        rightBorder.insert({ vertex.position.z, vertex.position.y });
+    }
+
+    return leftBorder == rightBorder;
+  }
+
+  void runFlight(const std::string& i_name, const TerrainPagerSettings& i_settings)
+  {
+    TerrainPager pager(i_settings);
+    std::unordered_map<std::int64_t, std::shared_ptr<Dx::IShape3d>> shapes;
+
+    // Only the main thread's part is timed, the loading thread gets a millisecond a frame
+    int maxQueuedCount = 0;
+    double frameMs = 0;
+    // Of the last page loaded at every level of detail
+    std::array<int, TerrainPager::LodsCount> lodTris{};
+    for (int frame = 0; frame < FramesCount; ++frame)
+    {
+      frameMs += measureMs([&]() {
+        pager.update({ 64 + frame * FlightSpeed, 0, 512 });
+        for (const auto& page : pager.takeEvictedPages())
+          shapes.erase(TerrainPager::getPageKey(page.x, page.z));
+        for (const auto& page : pager.takeLoadedPages())
+        {
+          shapes[TerrainPager::getPageKey(page.x, page.z)] = page.shape;
+          lodTris[page.lod] = (int)page.shape->getInds().size() / 3;
+        }
+        }, 1);
+
+      maxQueuedCount = std::max(maxQueuedCount, pager.getQueuedPagesCount());
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    int seamsCount = 0;
+    int crackedSeamsCount = 0;
+    for (const auto& [key, shape] : shapes)
+    {
+      const int x = (int)(std::uint32_t)(key & 0xFFFFFFFF);
+      const int z = (int)(key >> 32);
+      const auto it = shapes.find(TerrainPager::getPageKey(x + 1, z));
+      if (it == shapes.end())
+        continue;
+
+      ++seamsCount;
+      if (!areStitched(*shape, *it->second))
+        ++crackedSeamsCount;
+    }
+
+    std::printf("  %-6s %8.3f %6d %9d %10d %8.2f %9d/%d  ",
+      i_name.c_str(), frameMs / FramesCount, pager.getLoadsCount(), pager.getEvictionsCount(), maxQueuedCount,
+      pager.getAveragePageMs(), seamsCount - crackedSeamsCount, seamsCount);
+    for (int lod = 0; lod < TerrainPager::LodsCount; ++lod)
+      std::printf(" %6d", lodTris[lod]);
+    std::printf("\n");
+  }
+
+} // anonym NS
+
+
+void runTerrainPagerBenchmark()
+{
+  const auto heightField = createTestHeightField();
+  const auto folder = std::filesystem::temp_directory_path() / "OceanBenchTerrain";
+
+  std::error_code error;
+  std::filesystem::remove_all(folder, error);
+
+  const double writeMs = measureMs([&]() {
+    TerrainPager::writePages(heightField, 1, folder / "Pages");
+    }, 1);
+
+  TerrainPagerSettings settings;
+  settings.pagesFolder = folder / "Pages";
+  settings.meshesFolder = folder / "Meshes";
+  settings.loadDistance = 200;
+  settings.maxResidentPagesCount = 24;
+
+  std::printf("Terrain pager (%d pages of %d m, written in %.1f ms, %d frames)\n",
+    (heightField.getWidth() / TerrainPager::PageSize) * (heightField.getHeight() / TerrainPager::PageSize),
+    TerrainPager::PageSize, writeMs, FramesCount);
+  std::printf("  meshes  frame ms  loads evictions max queued  page ms  stitched   tris per LOD\n");
+
+  // Cold tessellates every page and fills the meshes cache, warm loads from it
+  runFlight("cold", settings);
+  runFlight("warm", settings);
+
+  // Cold again, into a cache of its own, with more tessellation threads
+  auto threadedSettings = settings;
+  threadedSettings.meshesFolder = folder / "ThreadedMeshes";
+  threadedSettings.tessellationThreadsCount = 4;
+  runFlight("cold x4", threadedSettings);
+
+  std::filesystem::remove_all(folder, error);
+}
@@ -0,0 +1,72 @@
+#include "stdafx.h"
+#include "VertexFormatBenchmark.h"
+
+#include "BenchUtils.h"
+
+#include "CompactVertices.h"
+#include "ParallelRoam.h"
+#include "RoamPredicates.h"
+#include "ThreadPool.h"
+
+#include <LaggyDx/IShape3d.h>
+
+
+namespace
+{
+  const Sdk::Vector3F WorldCenter = { 100, 0, 100 };
+
+  void runCase(const std::string& i_name, const Dx::IShape3d& i_shape, const VertexFormat i_format)
+  {
+    CompactMesh mesh;
+    const double ms = measureMs([&]() { mesh = createCompactMesh(i_shape, i_format); });
+
+    // Largest differences after the round trip: position in meters, normal in degrees, uv
+    const auto& verts = i_shape.getVerts();
+    const auto decoded = decodeCompactMesh(mesh);
+    float positionError = 0;
+    float normalError = 0;
+    float uvError = 0;
+    for (int i = 0; i < (int)verts.size(); ++i)
+    {
+      const auto& original = verts[i];
+      const auto& restored = decoded[i];
+      positionError = std::max({ positionError,
+        std::abs(original.position.x - restored.position.x),
+        std::abs(original.position.y - restored.position.y),
+        std::abs(original.position.z - restored.position.z) });
+
+      const float cosine = std::clamp(
+        original.normal.x * restored.normal.x + original.normal.y * restored.normal.y + original.normal.z * restored.normal.z,
+        -1.0f, 1.0f);
+      normalError = std::max(normalError, std::acos(cosine) * 180.0f / 3.14159265f);
+
+      uvError = std::max({ uvError,
+        std::abs(original.texture.x - restored.texture.x), std::abs(original.texture.y - restored.texture.y) });
+    }
+
+    const std::size_t fullBytes = verts.size() * sizeof(Dx::VertexPosNormText);
+    std::printf("  %-22s %-10s %8d %8d %8d %6.1fx %7.2f %9.5f %8.3f %8.5f\n",
+      i_name.c_str(), mesh.format == VertexFormat::Full ? "full" : "ocean grid",
+      (int)verts.size(), (int)(fullBytes / 1024), (int)(mesh.getVertexBytes() / 1024),
+      (double)fullBytes / mesh.getVertexBytes(), ms, positionError, normalError, uvError);
+  }
+
+} // anonym NS
+
+
+void runVertexFormatBenchmark()
+{
+  const auto heightField = createTestHeightField();
+  ThreadPool pool(4);
+
+  std::printf("Compact vertex formats (%d bytes full, %d ocean grid)\n",
+    getVertexSize(VertexFormat::Full), getVertexSize(VertexFormat::OceanGrid));
+  std::printf("  mesh                   stored as     verts  full KB   now KB   ratio      ms  pos err m  norm deg   uv err\n");
+
+  const ParallelRoam ocean(OceanSize, OceanMaxDepth, getOceanPredicate(WorldCenter), pool);
+  runCase("Ocean", *ocean.createShape(), VertexFormat::OceanGrid);
+
+  // Not flat, so it has to fall back to the full format
+  const ParallelRoam surface(heightField, SurfaceMaxDepth, getSurfacePredicate(), pool);
+  runCase("Surface", *surface.createShape(), VertexFormat::OceanGrid);
+}
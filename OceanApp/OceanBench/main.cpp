@@ -0,0 +1,50 @@
+#include "stdafx.h"
+
+#include "BuoyancyBenchmark.h"
+#include "CullingBenchmark.h"
+#include "FftOceanBenchmark.h"
+#include "FrameTimeBenchmark.h"
+#include "GerstnerBenchmark.h"
+#include "GuiTextBenchmark.h"
+#include "HeightFieldBenchmark.h"
+#include "InstancingBenchmark.h"
+#include "MeshFileBenchmark.h"
+#include "MeshOptimizerBenchmark.h"
+#include "ObjectBvhBenchmark.h"
+#include "ProfilerBenchmark.h"
+#include "RenderQueueBenchmark.h"
+#include "RoamBenchmark.h"
+#include "SceneBenchmark.h"
+#include "TerrainPagerBenchmark.h"
+#include "VertexFormatBenchmark.h"
+
+
+int main(int argc, char** argv)
+{
+  // "-json <path>" runs only the scene replay and writes its results there, for the
+  // regression runs
+  if (argc == 3 && std::string(argv[1]) == "-json")
+  {
+    runSceneBenchmark(argv[2]);
+    return 0;
+  }
+
+  runRoamBenchmark();
+  runInstancingBenchmark();
+  runGerstnerBenchmark();
+  runBuoyancyBenchmark();
+  runFftOceanBenchmark();
+  runMeshFileBenchmark();
+  runMeshOptimizerBenchmark();
+  runTerrainPagerBenchmark();
+  runHeightFieldBenchmark();
+  runVertexFormatBenchmark();
+  runCullingBenchmark();
+  runObjectBvhBenchmark();
+  runRenderQueueBenchmark();
+  runProfilerBenchmark();
+  runFrameTimeBenchmark();
+  runGuiTextBenchmark();
+  runSceneBenchmark();
+  return 0;
+}
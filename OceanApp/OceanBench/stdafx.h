@@ -0,0 +1,4 @@
+#pragma once
+
+#include <LaggySdk/Common.h>
+#include <LaggySdk/Contracts.h>